@@ -928,6 +928,17 @@ FStat  UStatManager::GetStatTotalAsStat(const FName StatName,bool bUseRawForSelf
 }
 
 
+void UStatManager::GetNormalizedStats(TArrayView<const FName> StatNames, TArrayView<float> OutValues)
+{
+	for(int32 Index = 0; Index < StatNames.Num(); Index++)
+	{
+		const FStat Stat = GetStatTotalAsStat(StatNames[Index]);
+		const float Range = Stat.Maximum - Stat.Minimum;
+		OutValues[Index] = Range > 0.0f ? (Stat.CurrentValue - Stat.Minimum)/Range : 0.0f;
+	}
+}
+
+
 FStat UStatManager::GetRawStat(const FName StatName) const
 {
 	if(!StatDictionary.Contains(StatName))
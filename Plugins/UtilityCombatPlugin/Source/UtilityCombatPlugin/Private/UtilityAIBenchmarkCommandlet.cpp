@@ -0,0 +1,559 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAIBenchmarkCommandlet.h"
+#include "UtilityAIManagerComponent.h"
+#include "UtilityCombatTaskComponent.h"
+#include "UtilityTaskDefinition.h"
+#include "UtilityAICrowdSubsystem.h"
+#include "AIController.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Curves/CurveFloat.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/MemoryBase.h"
+
+/*
+Forwards everything to the real allocator, and counts the game thread's allocations while counting is on.
+Installed as GMalloc for the rounds only. Blocks it hands out are the inner allocator's, so they can be freed either side of that.
+*/
+class FUtilityAIBenchmarkCountingMalloc final : public FMalloc
+{
+public:
+
+	explicit FUtilityAIBenchmarkCountingMalloc(FMalloc* InInnerMalloc)
+		: InnerMalloc(InInnerMalloc)
+	{
+	}
+
+	/*
+	Only touched on the game thread, and only read after IsInGameThread(), so other threads never race it.
+	*/
+	bool bCounting = false;
+
+	int64 Allocations = 0;
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation();
+		return InnerMalloc->Malloc(Count, Alignment);
+	}
+
+	virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation();
+		return InnerMalloc->TryMalloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if(Count > 0)
+		{
+			CountAllocation();
+		}
+		return InnerMalloc->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if(Count > 0)
+		{
+			CountAllocation();
+		}
+		return InnerMalloc->TryRealloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		InnerMalloc->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+	{
+		return InnerMalloc->QuantizeSize(Count, Alignment);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return InnerMalloc->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual void Trim(bool bTrimThreadCaches) override
+	{
+		InnerMalloc->Trim(bTrimThreadCaches);
+	}
+
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		InnerMalloc->SetupTLSCachesOnCurrentThread();
+	}
+
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return InnerMalloc->IsInternallyThreadSafe();
+	}
+
+	virtual bool ValidateHeap() override
+	{
+		return InnerMalloc->ValidateHeap();
+	}
+
+	virtual void UpdateStats() override
+	{
+		InnerMalloc->UpdateStats();
+	}
+
+	virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+	{
+		InnerMalloc->GetAllocatorStats(OutStats);
+	}
+
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+	{
+		InnerMalloc->DumpAllocatorStats(Ar);
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return InnerMalloc->GetDescriptiveName();
+	}
+
+private:
+
+	void CountAllocation()
+	{
+		if(IsInGameThread() && bCounting)
+		{
+			Allocations++;
+		}
+	}
+
+	FMalloc* InnerMalloc = nullptr;
+};
+
+UUtilityAIBenchmarkCommandlet::UUtilityAIBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UUtilityAIBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 Agents = 100;
+	int32 Rounds = 100;
+	int32 Seed = 1234;
+	int32 CoverCount = 50;
+	float Area = 10000.0f;
+	int32 GeneratedTasks = 6;
+	int32 CurvesPerTask = 4;
+	int32 CrowdAgents = 0;
+	FString TaskClassList;
+	FString CoverModeName = TEXT("SWEEP");
+	FString OutPath = FPaths::ProjectSavedDir() / TEXT("UtilityAIBenchmark") / (TEXT("Benchmark_") + FDateTime::Now().ToString());
+
+	FParse::Value(*Params, TEXT("Agents="), Agents);
+	FParse::Value(*Params, TEXT("Rounds="), Rounds);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("Cover="), CoverCount);
+	FParse::Value(*Params, TEXT("Area="), Area);
+	FParse::Value(*Params, TEXT("GeneratedTasks="), GeneratedTasks);
+	FParse::Value(*Params, TEXT("CurvesPerTask="), CurvesPerTask);
+	FParse::Value(*Params, TEXT("CrowdAgents="), CrowdAgents);
+	FParse::Value(*Params, TEXT("Tasks="), TaskClassList, false);
+	FParse::Value(*Params, TEXT("CoverMode="), CoverModeName);
+	FParse::Value(*Params, TEXT("Out="), OutPath);
+
+	Agents = FMath::Max(Agents,1);
+	Rounds = FMath::Max(Rounds,1);
+	CrowdAgents = FMath::Max(CrowdAgents,0);
+
+	const int64 CoverMode = StaticEnum<ECoverSearchMode>()->GetValueByNameString(CoverModeName);
+	if(CoverMode == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAIBenchmark: Unknown -CoverMode=%s."), *CoverModeName);
+		return 1;
+	}
+
+	TArray<UClass*> TaskClasses;
+	TArray<FString> TaskClassPaths;
+	TaskClassList.ParseIntoArray(TaskClassPaths, TEXT(","));
+	for(const FString& TaskClassPath : TaskClassPaths)
+	{
+		UClass* TaskClass = LoadClass<UUtilityCombatTaskComponent>(nullptr, *TaskClassPath);
+		if(!TaskClass)
+		{
+			UE_LOG(LogTemp, Error, TEXT("UtilityAIBenchmark: %s isn't a UUtilityCombatTaskComponent class."), *TaskClassPath);
+			return 1;
+		}
+		TaskClasses.Add(TaskClass);
+	}
+
+	//1. A game world with no level in it. No rendering, so -nullrhi is fine.
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("UtilityAIBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	const FURL URL;
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	//2. Everything random comes from this, so runs with the same seed are the same.
+	FRandomStream RandomStream(Seed);
+
+	PlaceCover(World, CoverCount, Area, RandomStream);
+
+	//A few shared curves, like a real project would have.
+	TArray<UCurveFloat*> Curves;
+	for(int32 CurveIndex = 0; CurveIndex < 8; CurveIndex++)
+	{
+		UCurveFloat* Curve = NewObject<UCurveFloat>(GetTransientPackage());
+		Curve->FloatCurve.AddKey(0.0f, RandomStream.FRand());
+		Curve->FloatCurve.AddKey(RandomStream.FRandRange(0.2f,0.8f), RandomStream.FRand());
+		Curve->FloatCurve.AddKey(1.0f, RandomStream.FRand());
+		Curve->AddToRoot();
+		Curves.Add(Curve);
+	}
+
+	TArray<UUtilityAIManagerComponent*> Managers;
+	for(int32 AgentIndex = 0; AgentIndex < Agents; AgentIndex++)
+	{
+		if(UUtilityAIManagerComponent* Manager = SpawnAgent(World, TaskClasses, GeneratedTasks, CurvesPerTask, Curves, Area, RandomStream))
+		{
+			Manager->CoverSearchMode = static_cast<ECoverSearchMode>(CoverMode);
+			Managers.Add(Manager);
+		}
+	}
+
+	UUtilityAICrowdSubsystem* Crowd = World->GetSubsystem<UUtilityAICrowdSubsystem>();
+	UUtilityTaskArchetype* CrowdArchetype = nullptr;
+	if(CrowdAgents > 0 && Crowd)
+	{
+		CrowdArchetype = MakeCrowdArchetype(GeneratedTasks, CurvesPerTask, Curves, RandomStream);
+		for(int32 AgentIndex = 0; AgentIndex < CrowdAgents; AgentIndex++)
+		{
+			Crowd->AddAgent(CrowdArchetype, FVector(RandomStream.FRandRange(-Area,Area),RandomStream.FRandRange(-Area,Area),100.0f));
+		}
+	}
+
+	//The crowd is ticked and timed by hand below, so the world tick has to leave it alone.
+	IConsoleVariable* CrowdEnabled = IConsoleManager::Get().FindConsoleVariable(TEXT("UtilityAI.Crowd.Enabled"));
+	const int32 CrowdWasEnabled = CrowdEnabled ? CrowdEnabled->GetInt() : 1;
+
+	//3. Rounds. Move and refocus some agents, time every decision, then tick so async work and cooldowns move on.
+	//Every heap allocation a decision makes on the game thread is counted. Async traces and worker threads aren't.
+	FUtilityAIBenchmarkCountingMalloc CountingMalloc(GMalloc);
+	FMalloc* const RealMalloc = GMalloc;
+	GMalloc = &CountingMalloc;
+
+	TArray<double> LatencyMs;
+	LatencyMs.Reserve(Managers.Num()*Rounds);
+	TArray<double> CrowdTickMs;
+	CrowdTickMs.Reserve(Rounds);
+	int64 Traces = 0;
+	int64 ContainerResizes = 0;
+	double DecisionSeconds = 0.0;
+	const float DeltaSeconds = 1.0f/30.0f;
+
+	for(int32 Round = 0; Round < Rounds; Round++)
+	{
+		for(UUtilityAIManagerComponent* Manager : Managers)
+		{
+			AAIController* Controller = Manager->OwnerController;
+			APawn* Pawn = Controller ? Controller->GetPawn() : nullptr;
+			if(!Pawn)
+			{
+				continue;
+			}
+
+			if(RandomStream.FRand() < 0.1f)
+			{
+				Pawn->SetActorLocation(FVector(RandomStream.FRandRange(-Area,Area),RandomStream.FRandRange(-Area,Area),100.0f));
+			}
+
+			if(RandomStream.FRand() < 0.05f)
+			{
+				const UUtilityAIManagerComponent* Other = Managers[RandomStream.RandHelper(Managers.Num())];
+				APawn* OtherPawn = Other->OwnerController ? Other->OwnerController->GetPawn() : nullptr;
+				if(OtherPawn && OtherPawn != Pawn && RandomStream.FRand() < 0.7f)
+				{
+					Controller->SetFocus(OtherPawn);
+				}
+				else
+				{
+					Controller->ClearFocus(EAIFocusPriority::Gameplay);
+				}
+			}
+		}
+
+		for(UUtilityAIManagerComponent* Manager : Managers)
+		{
+			const int32 TracesBefore = Manager->TracesIssued;
+			const int32 ContainerResizesBefore = Manager->DecisionContainerResizes;
+
+			CountingMalloc.bCounting = true;
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Manager->DetermineBestTask();
+			const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+			CountingMalloc.bCounting = false;
+
+			DecisionSeconds += Seconds;
+			LatencyMs.Add(Seconds*1000.0);
+			Traces += Manager->TracesIssued - TracesBefore;
+			ContainerResizes += Manager->DecisionContainerResizes - ContainerResizesBefore;
+		}
+
+		if(CrowdArchetype && CrowdEnabled)
+		{
+			CrowdEnabled->Set(0, ECVF_SetByCode);
+			World->Tick(LEVELTICK_All, DeltaSeconds);
+			CrowdEnabled->Set(1, ECVF_SetByCode);
+
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Crowd->Tick(DeltaSeconds);
+			CrowdTickMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+		}
+		else
+		{
+			World->Tick(LEVELTICK_All, DeltaSeconds);
+		}
+	}
+
+	GMalloc = RealMalloc;
+
+	if(CrowdEnabled)
+	{
+		CrowdEnabled->Set(CrowdWasEnabled, ECVF_SetByCode);
+	}
+
+	//4. Report.
+	FUtilityAIBenchmarkResults Results;
+	Results.Agents = Managers.Num();
+	Results.Rounds = Rounds;
+	Results.Seed = Seed;
+	Results.CoverMode = CoverModeName;
+	Results.Decisions = LatencyMs.Num();
+	Results.DecisionSeconds = DecisionSeconds;
+
+	auto Percentile = [](const TArray<double>& SortedMs, double Fraction)
+	{
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction*SortedMs.Num()) - 1, 0, SortedMs.Num() - 1);
+		return SortedMs[Index];
+	};
+
+	if(LatencyMs.Num() > 0)
+	{
+		LatencyMs.Sort();
+
+		Results.DecisionsPerSecond = DecisionSeconds > 0.0 ? LatencyMs.Num()/DecisionSeconds : 0.0;
+		Results.P50Ms = Percentile(LatencyMs, 0.50);
+		Results.P95Ms = Percentile(LatencyMs, 0.95);
+		Results.P99Ms = Percentile(LatencyMs, 0.99);
+		Results.MeanMs = DecisionSeconds*1000.0/LatencyMs.Num();
+		Results.TracesPerDecision = static_cast<double>(Traces)/LatencyMs.Num();
+		Results.AllocationsPerDecision = static_cast<double>(CountingMalloc.Allocations)/LatencyMs.Num();
+		Results.ContainerResizesPerDecision = static_cast<double>(ContainerResizes)/LatencyMs.Num();
+	}
+
+	Results.CrowdAgents = Crowd ? Crowd->GetAgentCount() : 0;
+	if(CrowdTickMs.Num() > 0)
+	{
+		double CrowdTotalMs = 0.0;
+		for(const double TickMs : CrowdTickMs)
+		{
+			CrowdTotalMs += TickMs;
+		}
+
+		CrowdTickMs.Sort();
+		Results.CrowdTickP50Ms = Percentile(CrowdTickMs, 0.50);
+		Results.CrowdTickP95Ms = Percentile(CrowdTickMs, 0.95);
+		Results.CrowdTickP99Ms = Percentile(CrowdTickMs, 0.99);
+		Results.CrowdTickMeanMs = CrowdTotalMs/CrowdTickMs.Num();
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIBenchmark: %d agents, %d rounds, seed %d, %s cover."), Results.Agents, Rounds, Seed, *CoverModeName);
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIBenchmark: %.0f decisions/s, p50 %.4f ms, p95 %.4f ms, p99 %.4f ms, mean %.4f ms."),
+		Results.DecisionsPerSecond, Results.P50Ms, Results.P95Ms, Results.P99Ms, Results.MeanMs);
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIBenchmark: %.2f traces/decision, %.4f allocations/decision, %.4f container resizes/decision."),
+		Results.TracesPerDecision, Results.AllocationsPerDecision, Results.ContainerResizesPerDecision);
+	if(CrowdTickMs.Num() > 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("UtilityAIBenchmark: %d crowd agents, crowd tick p50 %.4f ms, p95 %.4f ms, p99 %.4f ms, mean %.4f ms."),
+			Results.CrowdAgents, Results.CrowdTickP50Ms, Results.CrowdTickP95Ms, Results.CrowdTickP99Ms, Results.CrowdTickMeanMs);
+	}
+
+	const bool bWritten = WriteResults(OutPath, Results);
+
+	for(UCurveFloat* Curve : Curves)
+	{
+		Curve->RemoveFromRoot();
+	}
+	if(CrowdArchetype)
+	{
+		CrowdArchetype->RemoveFromRoot();
+	}
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	return bWritten ? 0 : 1;
+}
+
+void UUtilityAIBenchmarkCommandlet::PlaceCover(UWorld* World, int32 CoverCount, float Area, FRandomStream& RandomStream) const
+{
+	UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if(!CubeMesh)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAIBenchmark: Couldn't load the engine cube, no cover is placed."));
+		return;
+	}
+
+	for(int32 CoverIndex = 0; CoverIndex < CoverCount; CoverIndex++)
+	{
+		const FVector Location(RandomStream.FRandRange(-Area,Area),RandomStream.FRandRange(-Area,Area),50.0f);
+		const FRotator Rotation(0.0f,RandomStream.FRandRange(0.0f,360.0f),0.0f);
+
+		AStaticMeshActor* Cover = World->SpawnActor<AStaticMeshActor>(Location, Rotation);
+		if(!Cover)
+		{
+			continue;
+		}
+
+		Cover->SetMobility(EComponentMobility::Movable);
+		Cover->GetStaticMeshComponent()->SetStaticMesh(CubeMesh);
+		Cover->SetActorScale3D(FVector(RandomStream.FRandRange(1.0f,4.0f),RandomStream.FRandRange(0.5f,1.0f),RandomStream.FRandRange(1.0f,2.0f)));
+		Cover->Tags.Add(FName("Cover"));
+	}
+}
+
+UUtilityAIManagerComponent* UUtilityAIBenchmarkCommandlet::SpawnAgent(UWorld* World, const TArray<UClass*>& TaskClasses, int32 GeneratedTasks, int32 CurvesPerTask,
+	const TArray<UCurveFloat*>& Curves, float Area, FRandomStream& RandomStream) const
+{
+	const FVector Location(RandomStream.FRandRange(-Area,Area),RandomStream.FRandRange(-Area,Area),100.0f);
+	const FRotator Rotation(0.0f,RandomStream.FRandRange(0.0f,360.0f),0.0f);
+
+	AAIController* Controller = World->SpawnActor<AAIController>();
+	APawn* Pawn = World->SpawnActor<APawn>(Location, Rotation);
+	if(!Controller || !Pawn)
+	{
+		return nullptr;
+	}
+
+	//APawn has no root of its own. Without a movement component the manager treats it as always on the ground.
+	//Spawning without a root drops the transform, so it is set again once the root exists.
+	if(!Pawn->GetRootComponent())
+	{
+		USceneComponent* Root = NewObject<USceneComponent>(Pawn);
+		Pawn->SetRootComponent(Root);
+		Root->RegisterComponent();
+		Pawn->SetActorLocationAndRotation(Location, Rotation);
+	}
+
+	//Tasks first, the manager finds them in Initialize().
+	const int32 NumTasks = TaskClasses.Num() > 0 ? TaskClasses.Num() : GeneratedTasks;
+	const int32 NumQueries = UtilityCurveInputQueryCount;
+	for(int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		UClass* TaskClass = TaskClasses.Num() > 0 ? TaskClasses[TaskIndex] : UUtilityCombatTaskComponent::StaticClass();
+		UUtilityCombatTaskComponent* Task = NewObject<UUtilityCombatTaskComponent>(Controller, TaskClass);
+
+		if(TaskClasses.Num() == 0)
+		{
+			Task->TaskName = FName(*FString::Printf(TEXT("BenchmarkTask%d"), TaskIndex));
+			Task->TaskLayer = TaskIndex % 2;
+			for(int32 CurveIndex = 0; CurveIndex < CurvesPerTask && Curves.Num() > 0; CurveIndex++)
+			{
+				FUtilityCurveCollection& Collection = Task->CurveCollectionArray.AddDefaulted_GetRef();
+				Collection.CurveInputQuery = static_cast<ECurveInputQuery>(RandomStream.RandRange(1, NumQueries - 1));
+				Collection.CurveFloat = Curves[RandomStream.RandHelper(Curves.Num())];
+				Collection.bMultiplyThisCurveOutputToRunningTotal = RandomStream.FRand() < 0.8f;
+			}
+		}
+
+		Task->RegisterComponent();
+	}
+
+	UUtilityAIManagerComponent* Manager = NewObject<UUtilityAIManagerComponent>(Controller);
+	Manager->RegisterComponent();
+	Manager->bUseDecisionScheduler = false; //The benchmark times every decision itself.
+
+	Controller->Possess(Pawn);
+	Manager->Initialize();
+	Manager->SetMovementComponentPointers();
+	return Manager;
+}
+
+UUtilityTaskArchetype* UUtilityAIBenchmarkCommandlet::MakeCrowdArchetype(int32 GeneratedTasks, int32 CurvesPerTask, const TArray<UCurveFloat*>& Curves,
+	FRandomStream& RandomStream) const
+{
+	UUtilityTaskArchetype* Archetype = NewObject<UUtilityTaskArchetype>(GetTransientPackage());
+	Archetype->Crowd.PromotionDistance = 0.0f; //Timed agents must stay in the crowd.
+	Archetype->AddToRoot();
+
+	const int32 NumQueries = UtilityCurveInputQueryCount;
+	for(int32 TaskIndex = 0; TaskIndex < GeneratedTasks; TaskIndex++)
+	{
+		UUtilityTaskDefinition* Task = NewObject<UUtilityTaskDefinition>(Archetype);
+		Task->TaskName = FName(*FString::Printf(TEXT("CrowdTask%d"), TaskIndex));
+		Task->TaskLayer = TaskIndex % 2;
+		for(int32 CurveIndex = 0; CurveIndex < CurvesPerTask && Curves.Num() > 0; CurveIndex++)
+		{
+			FUtilityCurveCollection& Collection = Task->CurveCollectionArray.AddDefaulted_GetRef();
+			Collection.CurveInputQuery = static_cast<ECurveInputQuery>(RandomStream.RandRange(1, NumQueries - 1));
+			Collection.CurveFloat = Curves[RandomStream.RandHelper(Curves.Num())];
+			Collection.bMultiplyThisCurveOutputToRunningTotal = RandomStream.FRand() < 0.8f;
+		}
+		Task->BakeCurves();
+		Archetype->Tasks.Add(Task);
+	}
+
+	return Archetype;
+}
+
+bool UUtilityAIBenchmarkCommandlet::WriteResults(const FString& OutPath, const FUtilityAIBenchmarkResults& Results) const
+{
+	const FString Csv = FString::Printf(
+		TEXT("agents,rounds,seed,cover_mode,decisions,decision_seconds,decisions_per_sec,p50_ms,p95_ms,p99_ms,mean_ms,traces_per_decision,allocations_per_decision,container_resizes_per_decision,")
+		TEXT("crowd_agents,crowd_tick_p50_ms,crowd_tick_p95_ms,crowd_tick_p99_ms,crowd_tick_mean_ms\n")
+		TEXT("%d,%d,%d,%s,%d,%.6f,%.2f,%.6f,%.6f,%.6f,%.6f,%.4f,%.6f,%.6f,%d,%.6f,%.6f,%.6f,%.6f\n"),
+		Results.Agents, Results.Rounds, Results.Seed, *Results.CoverMode, Results.Decisions, Results.DecisionSeconds, Results.DecisionsPerSecond,
+		Results.P50Ms, Results.P95Ms, Results.P99Ms, Results.MeanMs, Results.TracesPerDecision, Results.AllocationsPerDecision, Results.ContainerResizesPerDecision,
+		Results.CrowdAgents, Results.CrowdTickP50Ms, Results.CrowdTickP95Ms, Results.CrowdTickP99Ms, Results.CrowdTickMeanMs);
+
+	const FString Json = FString::Printf(
+		TEXT("{\n")
+		TEXT("\t\"agents\": %d,\n\t\"rounds\": %d,\n\t\"seed\": %d,\n\t\"cover_mode\": \"%s\",\n")
+		TEXT("\t\"decisions\": %d,\n\t\"decision_seconds\": %.6f,\n\t\"decisions_per_sec\": %.2f,\n")
+		TEXT("\t\"p50_ms\": %.6f,\n\t\"p95_ms\": %.6f,\n\t\"p99_ms\": %.6f,\n\t\"mean_ms\": %.6f,\n")
+		TEXT("\t\"traces_per_decision\": %.4f,\n\t\"allocations_per_decision\": %.6f,\n\t\"container_resizes_per_decision\": %.6f,\n")
+		TEXT("\t\"crowd_agents\": %d,\n\t\"crowd_tick_p50_ms\": %.6f,\n\t\"crowd_tick_p95_ms\": %.6f,\n\t\"crowd_tick_p99_ms\": %.6f,\n\t\"crowd_tick_mean_ms\": %.6f\n")
+		TEXT("}\n"),
+		Results.Agents, Results.Rounds, Results.Seed, *Results.CoverMode, Results.Decisions, Results.DecisionSeconds, Results.DecisionsPerSecond,
+		Results.P50Ms, Results.P95Ms, Results.P99Ms, Results.MeanMs, Results.TracesPerDecision, Results.AllocationsPerDecision, Results.ContainerResizesPerDecision,
+		Results.CrowdAgents, Results.CrowdTickP50Ms, Results.CrowdTickP95Ms, Results.CrowdTickP99Ms, Results.CrowdTickMeanMs);
+
+	const bool bCsvWritten = FFileHelper::SaveStringToFile(Csv, *(OutPath + TEXT(".csv")));
+	const bool bJsonWritten = FFileHelper::SaveStringToFile(Json, *(OutPath + TEXT(".json")));
+	if(!bCsvWritten || !bJsonWritten)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAIBenchmark: Couldn't write %s.csv/.json"), *OutPath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIBenchmark: Wrote %s.csv and %s.json"), *OutPath, *OutPath);
+	return true;
+}
@@ -0,0 +1,155 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAICoverBakeCommandlet.h"
+#include "UtilityAICoverBakeData.h"
+#include "UtilityAICoverSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "GameFramework/Actor.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+UUtilityAICoverBakeCommandlet::UUtilityAICoverBakeCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UUtilityAICoverBakeCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString MapPackageName;
+	if(!FParse::Value(*Params, TEXT("Map="), MapPackageName))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAICoverBake: -Map=/Game/Path/To/Map is required."));
+		return 1;
+	}
+
+	FString CoverTagString = TEXT("Cover");
+	FParse::Value(*Params, TEXT("Tag="), CoverTagString);
+	const FName CoverTag = FName(*CoverTagString);
+
+	float SlotSpacing = 100.0f;
+	FParse::Value(*Params, TEXT("Spacing="), SlotSpacing);
+
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if(!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAICoverBake: Couldn't load map %s."), *MapPackageName);
+		return 1;
+	}
+
+	if(World->IsPartitionedWorld())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAICoverBake: %s uses world partition. Only actors that are always loaded are baked."), *MapPackageName);
+	}
+
+	//Components have to be registered for their bounds.
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	const bool bInitializedWorld = !World->bIsWorldInitialized;
+	if(bInitializedWorld)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(false)
+			.RequiresHitProxies(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.SetTransactional(false));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	//Streamed levels too, they are baked along with the persistent level. Actors of a level that isn't loaded at runtime are skipped.
+	for(ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		if(StreamingLevel)
+		{
+			StreamingLevel->SetShouldBeLoaded(true);
+			StreamingLevel->SetShouldBeVisible(true);
+		}
+	}
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	const FString BakePackageName = UUtilityAICoverBakeData::GetBakePackageName(MapPackageName, CoverTag);
+	UPackage* BakePackage = CreatePackage(*BakePackageName);
+	UUtilityAICoverBakeData* BakeData = NewObject<UUtilityAICoverBakeData>(BakePackage, *FPackageName::GetShortName(BakePackageName), RF_Public | RF_Standalone);
+	BakeData->MapPackageName = MapPackageName;
+	BakeData->CoverTag = CoverTag;
+	BakeData->SlotSpacing = SlotSpacing;
+
+	TArray<FUtilityCoverSlot> ActorSlots;
+	for(ULevel* Level : World->GetLevels())
+	{
+		if(!Level)
+		{
+			continue;
+		}
+
+		for(AActor* Actor : Level->Actors)
+		{
+			if(!Actor || !Actor->ActorHasTag(CoverTag))
+			{
+				continue;
+			}
+
+			ActorSlots.Reset();
+			UUtilityAICoverSubsystem::GenerateCoverSlots(Actor, SlotSpacing, ActorSlots);
+			if(ActorSlots.Num() == 0)
+			{
+				continue;
+			}
+
+			const int32 CoverActorIndex = BakeData->CoverActors.Add(Actor);
+			BakeData->CoverActorLocations.Add(Actor->GetActorLocation());
+
+			for(const FUtilityCoverSlot& Slot : ActorSlots)
+			{
+				FUtilityBakedCoverSlot& BakedSlot = BakeData->Slots.AddDefaulted_GetRef();
+				BakedSlot.Location = FVector3f(Slot.Location);
+				BakedSlot.Normal = FVector3f(Slot.Normal);
+				BakedSlot.CoverActorIndex = CoverActorIndex;
+				BakedSlot.Height = Slot.Height;
+			}
+		}
+	}
+
+	const int32 BakedSlots = BakeData->Slots.Num();
+	const int32 BakedActors = BakeData->CoverActors.Num();
+
+	const FString Filename = FPackageName::LongPackageNameToFilename(BakePackageName, FPackageName::GetAssetPackageExtension());
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	const bool bSaved = UPackage::SavePackage(BakePackage, BakeData, *Filename, SaveArgs);
+
+	//Unload the map again, so a batch of bakes in one process doesn't keep every map it touched.
+	World->ClearWorldComponents();
+	if(bInitializedWorld)
+	{
+		World->CleanupWorld();
+	}
+	World->RemoveFromRoot();
+	BakeData->ClearFlags(RF_Standalone);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	if(!bSaved)
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAICoverBake: Couldn't save %s."), *Filename);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UtilityAICoverBake: Baked %d slots on %d actors with tag %s to %s."),
+		BakedSlots, BakedActors, *CoverTag.ToString(), *BakePackageName);
+	return 0;
+#else
+	UE_LOG(LogTemp, Error, TEXT("UtilityAICoverBake only runs in the editor."));
+	return 1;
+#endif
+}
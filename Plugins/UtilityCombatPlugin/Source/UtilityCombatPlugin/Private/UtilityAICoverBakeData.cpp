@@ -0,0 +1,45 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAICoverBakeData.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/PackageName.h"
+#include "Serialization/CustomVersion.h"
+
+const FGuid FUtilityAICoverBakeVersion::GUID(0x6A1C0B5E, 0x4D7F4E21, 0x9B3A8C52, 0x1F06D7E4);
+
+static FCustomVersionRegistration GRegisterUtilityAICoverBakeVersion(FUtilityAICoverBakeVersion::GUID, FUtilityAICoverBakeVersion::LatestVersion, TEXT("UtilityAICoverBakeVersion"));
+
+static FString GUtilityAICoverBakePath = TEXT("/Game/UtilityAI/CoverBakes");
+static FAutoConsoleVariableRef CVarUtilityAICoverBakePath(
+	TEXT("UtilityAI.Cover.BakePath"),
+	GUtilityAICoverBakePath,
+	TEXT("Folder the UtilityAICoverBake commandlet writes to, and UUtilityAICoverSubsystem loads baked cover from."),
+	ECVF_Default);
+
+void UUtilityAICoverBakeData::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FUtilityAICoverBakeVersion::GUID);
+
+	Super::Serialize(Ar);
+
+	//One read for every slot, instead of one tagged property per field.
+	//Every version so far has the same slot layout, so old slots can still be read past. They just aren't used.
+	Slots.BulkSerialize(Ar);
+
+	if(Ar.IsLoading())
+	{
+		LoadedVersion = Ar.CustomVer(FUtilityAICoverBakeVersion::GUID);
+		if(IsOutdated())
+		{
+			Slots.Empty();
+		}
+	}
+}
+
+FString UUtilityAICoverBakeData::GetBakePackageName(const FString& MapPackageName, FName CoverTag)
+{
+	const FString MapName = FPackageName::GetShortName(UWorld::RemovePIEPrefix(MapPackageName));
+	return FString::Printf(TEXT("%s/%s_%s"), *GUtilityAICoverBakePath, *MapName, *CoverTag.ToString());
+}
@@ -0,0 +1,804 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAICoverSubsystem.h"
+#include "UtilityAICoverBakeData.h"
+#include "UtilityAIDecisionSubsystem.h"
+#include "UtilityAIManagerComponent.h"
+#include "UtilityAIStats.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "EngineUtils.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+static float GUtilityAICoverSlotSpacing = 100.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverSlotSpacing(
+	TEXT("UtilityAI.Cover.SlotSpacing"),
+	GUtilityAICoverSlotSpacing,
+	TEXT("Distance between cover slots along the bounds of a cover actor. Takes effect on the next RebuildCoverIndex()."),
+	ECVF_Default);
+
+static float GUtilityAICoverStaleDistance = 10.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverStaleDistance(
+	TEXT("UtilityAI.Cover.StaleDistance"),
+	GUtilityAICoverStaleDistance,
+	TEXT("A baked cover actor that moved farther than this since the bake is reported as stale."),
+	ECVF_Default);
+
+static float GUtilityAICoverCellSize = 1000.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverCellSize(
+	TEXT("UtilityAI.Cover.CellSize"),
+	GUtilityAICoverCellSize,
+	TEXT("Size of a cover spatial hash cell. About a third of CoverPointSearchDistance is a good start. Takes effect on the next RebuildCoverIndex()."),
+	ECVF_Default);
+
+static float GUtilityAICoverClaimRadius = 150.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverClaimRadius(
+	TEXT("UtilityAI.Cover.ClaimRadius"),
+	GUtilityAICoverClaimRadius,
+	TEXT("Cover within this distance of another agent's claim is skipped by cover searches."),
+	ECVF_Default);
+
+static float GUtilityAICoverVisibilityCellSize = 200.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverVisibilityCellSize(
+	TEXT("UtilityAI.Cover.VisibilityCellSize"),
+	GUtilityAICoverVisibilityCellSize,
+	TEXT("Cover and focus locations are snapped to cells this big for the cover visibility cache. Bigger shares more, but is less exact."),
+	ECVF_Default);
+
+static float GUtilityAICoverVisibilityMaxAge = 1.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverVisibilityMaxAge(
+	TEXT("UtilityAI.Cover.VisibilityMaxAge"),
+	GUtilityAICoverVisibilityMaxAge,
+	TEXT("Seconds a cached cover visibility result is used before it is traced again."),
+	ECVF_Default);
+
+static float GUtilityAICoverVisibilityStandOff = 60.0f;
+static FAutoConsoleVariableRef CVarUtilityAICoverVisibilityStandOff(
+	TEXT("UtilityAI.Cover.VisibilityStandOff"),
+	GUtilityAICoverVisibilityStandOff,
+	TEXT("How far behind the cover location, away from the focus, an agent hiding there is assumed to stand."),
+	ECVF_Default);
+
+/*
+Visibility trace hits closer than this to the hiding spot don't hide it.
+*/
+static const float UtilityCoverVisibilityHitTolerance = 5.0f;
+
+static void UtilityAICompareCoverSearchModes(const TArray<FString>& Args, UWorld* World)
+{
+	const UEnum* ModeEnum = StaticEnum<ECoverSearchMode>();
+	const int64 ModeA = Args.Num() > 0 ? ModeEnum->GetValueByNameString(Args[0]) : static_cast<int64>(ECoverSearchMode::SWEEP);
+	const int64 ModeB = Args.Num() > 1 ? ModeEnum->GetValueByNameString(Args[1]) : static_cast<int64>(ECoverSearchMode::ADAPTIVE_SWEEP);
+	if(ModeA == INDEX_NONE || ModeB == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI.Cover.Compare: Unknown ECoverSearchMode."));
+		return;
+	}
+
+	if(const UUtilityAICoverSubsystem* CoverSubsystem = World ? World->GetSubsystem<UUtilityAICoverSubsystem>() : nullptr)
+	{
+		CoverSubsystem->CompareCoverSearchModes(static_cast<ECoverSearchMode>(ModeA),static_cast<ECoverSearchMode>(ModeB));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdUtilityAICompareCoverSearchModes(
+	TEXT("UtilityAI.Cover.Compare"),
+	TEXT("UtilityAI.Cover.Compare [ModeA=SWEEP] [ModeB=ADAPTIVE_SWEEP]. Runs both cover searches for every agent and logs traces per search and cover quality."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&UtilityAICompareCoverSearchModes));
+
+void FUtilityCoverSpatialHash::Reset(float InCellSize)
+{
+	Slots.Reset();
+	Cells.Reset();
+	FreeSlots.Reset();
+	CoverActors.Reset();
+	CellSize = FMath::Max(InCellSize,1.0f);
+}
+
+void FUtilityCoverSpatialHash::AddSlot(const FUtilityCoverSlot& Slot)
+{
+	int32 SlotIndex = INDEX_NONE;
+	if(FreeSlots.Num() > 0)
+	{
+		SlotIndex = FreeSlots.Pop(false);
+		Slots[SlotIndex] = Slot;
+	}
+	else
+	{
+		SlotIndex = Slots.Add(Slot);
+	}
+	Cells.FindOrAdd(GetCell(Slot.Location)).Add(SlotIndex);
+
+	if(!Slot.CoverActor.IsExplicitlyNull())
+	{
+		CoverActors.Add(Slot.CoverActor);
+	}
+}
+
+int32 FUtilityCoverSpatialHash::RemoveSlots(TFunctionRef<bool(const FUtilityCoverSlot&)> ShouldRemove)
+{
+	int32 RemovedSlots = 0;
+	for(int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+	{
+		FUtilityCoverSlot& Slot = Slots[SlotIndex];
+		if(Slot.CoverActor.IsExplicitlyNull() || !ShouldRemove(Slot))
+		{
+			continue; //Free slots have no actor, so they are never removed twice.
+		}
+
+		if(TArray<int32>* CellSlots = Cells.Find(GetCell(Slot.Location)))
+		{
+			CellSlots->RemoveSingleSwap(SlotIndex,false);
+		}
+		CoverActors.Remove(Slot.CoverActor);
+
+		Slot = FUtilityCoverSlot();
+		FreeSlots.Add(SlotIndex);
+		RemovedSlots++;
+	}
+	return RemovedSlots;
+}
+
+void FUtilityCoverSpatialHash::QueryRadius(const FVector& Center, float Radius, TArray<int32>& OutSlotIndices) const
+{
+	const FIntPoint MinCell = GetCell(Center - FVector(Radius,Radius,0.0f));
+	const FIntPoint MaxCell = GetCell(Center + FVector(Radius,Radius,0.0f));
+	const float RadiusSquared = Radius*Radius;
+
+	for(int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++)
+	{
+		for(int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++)
+		{
+			const TArray<int32>* CellSlots = Cells.Find(FIntPoint(CellX,CellY));
+			if(!CellSlots)
+			{
+				continue;
+			}
+
+			for(const int32 SlotIndex : *CellSlots)
+			{
+				const FUtilityCoverSlot& Slot = Slots[SlotIndex];
+				if(FVector::DistSquared(Slot.Location,Center) <= RadiusSquared && Slot.CoverActor.IsValid())
+				{
+					OutSlotIndices.Add(SlotIndex);
+				}
+			}
+		}
+	}
+}
+
+FIntPoint FUtilityCoverSpatialHash::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X/CellSize),FMath::FloorToInt(Location.Y/CellSize));
+}
+
+
+void UUtilityAICoverSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if(UWorld* World = GetWorld())
+	{
+		ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UUtilityAICoverSubsystem::OnActorSpawned));
+	}
+
+	//Actors of streamed in levels are loaded, not spawned.
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UUtilityAICoverSubsystem::OnLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UUtilityAICoverSubsystem::OnLevelRemovedFromWorld);
+}
+
+void UUtilityAICoverSubsystem::Deinitialize()
+{
+	if(UWorld* World = GetWorld())
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	}
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	CoverIndices.Empty();
+	PendingCoverBakes.Empty();
+	CoverClaimCells.Empty();
+	ClaimLocations.Empty();
+	VisibilityCache.Empty();
+	PendingVisibilityTraces.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UUtilityAICoverSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UUtilityAICoverSubsystem::QueryCoverSlots(FName CoverTag, const FVector& Center, float Radius, TArray<int32>& OutSlotIndices)
+{
+	FUtilityCoverSpatialHash* CoverIndex = CoverIndices.Find(CoverTag);
+	if(!CoverIndex)
+	{
+		if(PendingCoverBakes.Contains(CoverTag) || RequestCoverBake(CoverTag))
+		{
+			return; //No cover until the bake is in.
+		}
+		CoverIndex = &BuildCoverIndex(CoverTag);
+	}
+
+	CoverIndex->QueryRadius(Center,Radius,OutSlotIndices);
+}
+
+const FUtilityCoverSlot& UUtilityAICoverSubsystem::GetCoverSlot(FName CoverTag, int32 SlotIndex) const
+{
+	static const FUtilityCoverSlot EmptySlot;
+
+	const FUtilityCoverSpatialHash* CoverIndex = CoverIndices.Find(CoverTag);
+	if(!CoverIndex || !CoverIndex->Slots.IsValidIndex(SlotIndex))
+	{
+		return EmptySlot;
+	}
+	return CoverIndex->Slots[SlotIndex];
+}
+
+FUtilityCoverSpatialHash& UUtilityAICoverSubsystem::BuildCoverIndex(FName CoverTag)
+{
+	FUtilityCoverSpatialHash& CoverIndex = CoverIndices.FindOrAdd(CoverTag);
+	CoverIndex.Reset(GUtilityAICoverCellSize);
+
+	UWorld* World = GetWorld();
+	if(!World)
+	{
+		return CoverIndex;
+	}
+
+	TArray<FUtilityCoverSlot> ActorSlots;
+	for(TActorIterator<AActor> It(World); It; ++It)
+	{
+		if(!It->ActorHasTag(CoverTag))
+		{
+			continue;
+		}
+
+		ActorSlots.Reset();
+		GenerateCoverSlots(*It,GUtilityAICoverSlotSpacing,ActorSlots);
+		for(const FUtilityCoverSlot& Slot : ActorSlots)
+		{
+			CoverIndex.AddSlot(Slot);
+		}
+		WatchCoverActor(*It);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UtilityAI cover index for tag %s has %d slots."), *CoverTag.ToString(), CoverIndex.Slots.Num());
+	return CoverIndex;
+}
+
+bool UUtilityAICoverSubsystem::RequestCoverBake(FName CoverTag)
+{
+	UWorld* World = GetWorld();
+	if(!World || CoverIndices.Contains(CoverTag) || PendingCoverBakes.Contains(CoverTag))
+	{
+		return false;
+	}
+
+	const FString BakePackageName = UUtilityAICoverBakeData::GetBakePackageName(World->GetOutermost()->GetName(),CoverTag);
+	if(!FPackageName::DoesPackageExist(BakePackageName))
+	{
+		return false;
+	}
+
+	PendingCoverBakes.Add(CoverTag);
+	LoadPackageAsync(BakePackageName,FLoadPackageAsyncDelegate::CreateUObject(this,&UUtilityAICoverSubsystem::OnCoverBakeLoaded,CoverTag));
+	return true;
+}
+
+void UUtilityAICoverSubsystem::OnCoverBakeLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result, FName CoverTag)
+{
+	if(!PendingCoverBakes.Remove(CoverTag) || CoverIndices.Contains(CoverTag))
+	{
+		return; //Deinitialized, or built from the world meanwhile.
+	}
+
+	const FString BakePackageName = PackageName.ToString();
+	const UUtilityAICoverBakeData* BakeData = LoadedPackage && Result == EAsyncLoadingResult::Succeeded
+		? FindObject<UUtilityAICoverBakeData>(LoadedPackage,*FPackageName::GetShortName(BakePackageName)) : nullptr;
+
+	FUtilityCoverSpatialHash& CoverIndex = CoverIndices.FindOrAdd(CoverTag);
+	CoverIndex.Reset(GUtilityAICoverCellSize);
+
+	if(!BakeData || !ApplyCoverBake(*BakeData,CoverIndex))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s couldn't be used, generating cover for tag %s instead."), *BakePackageName, *CoverTag.ToString());
+		BuildCoverIndex(CoverTag);
+		return;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("UtilityAI cover index for tag %s loaded %d baked slots from %s."), *CoverTag.ToString(), CoverIndex.Slots.Num(), *BakePackageName);
+}
+
+bool UUtilityAICoverSubsystem::ApplyCoverBake(const UUtilityAICoverBakeData& BakeData, FUtilityCoverSpatialHash& CoverIndex)
+{
+	if(BakeData.IsOutdated())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s is from an older version. Rerun the UtilityAICoverBake commandlet."), *BakeData.GetName());
+		return false;
+	}
+
+	UWorld* World = GetWorld();
+
+	//Resolve each actor once, not once per slot.
+	TArray<AActor*> BakedActors;
+	BakedActors.Reserve(BakeData.CoverActors.Num());
+	for(const TSoftObjectPtr<AActor>& CoverActor : BakeData.CoverActors)
+	{
+		FSoftObjectPath ActorPath = CoverActor.ToSoftObjectPath();
+#if WITH_EDITOR
+		if(World->IsPlayInEditor())
+		{
+			ActorPath.FixupForPIE(World->GetOutermost()->GetPIEInstanceID());
+		}
+#endif
+		AActor* BakedActor = Cast<AActor>(ActorPath.ResolveObject());
+		BakedActors.Add(BakedActor);
+		WatchCoverActor(BakedActor);
+	}
+
+	CoverIndex.Slots.Reserve(BakeData.Slots.Num());
+	for(const FUtilityBakedCoverSlot& BakedSlot : BakeData.Slots)
+	{
+		AActor* BakedActor = BakedActors.IsValidIndex(BakedSlot.CoverActorIndex) ? BakedActors[BakedSlot.CoverActorIndex] : nullptr;
+		if(!BakedActor)
+		{
+			continue;
+		}
+
+		FUtilityCoverSlot Slot;
+		Slot.Location = FVector(BakedSlot.Location);
+		Slot.Normal = FVector(BakedSlot.Normal);
+		Slot.CoverActor = BakedActor;
+		Slot.Height = BakedSlot.Height;
+		CoverIndex.AddSlot(Slot);
+	}
+
+	WarnIfCoverBakeStale(BakeData,BakedActors);
+	return true;
+}
+
+void UUtilityAICoverSubsystem::WarnIfCoverBakeStale(const UUtilityAICoverBakeData& BakeData, const TArray<AActor*>& BakedActors) const
+{
+	const float StaleDistanceSquared = FMath::Square(GUtilityAICoverStaleDistance);
+	int32 StaleActors = 0;
+
+	for(int32 ActorIndex = 0; ActorIndex < BakedActors.Num(); ActorIndex++)
+	{
+		const AActor* CoverActor = BakedActors[ActorIndex];
+		if(!CoverActor)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s: %s is gone, or its level isn't loaded."), *BakeData.GetName(), *BakeData.CoverActors[ActorIndex].ToString());
+			StaleActors++;
+		}
+		else if(BakeData.CoverActorLocations.IsValidIndex(ActorIndex) && FVector::DistSquared(CoverActor->GetActorLocation(),BakeData.CoverActorLocations[ActorIndex]) > StaleDistanceSquared)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s: %s moved since the bake."), *BakeData.GetName(), *CoverActor->GetName());
+			StaleActors++;
+		}
+	}
+
+	//Cover that was added to the map after the bake.
+	const TSet<AActor*> BakedActorSet(BakedActors);
+	for(TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		if(It->ActorHasTag(BakeData.CoverTag) && !BakedActorSet.Contains(*It))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s: %s isn't in the bake."), *BakeData.GetName(), *It->GetName());
+			StaleActors++;
+		}
+	}
+
+	if(StaleActors > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI cover bake %s is stale (%d actors). Rerun the UtilityAICoverBake commandlet."), *BakeData.GetName(), StaleActors);
+	}
+}
+
+void UUtilityAICoverSubsystem::AddCoverActor(AActor* CoverActor)
+{
+	if(!CoverActor)
+	{
+		return;
+	}
+
+	TArray<FUtilityCoverSlot> ActorSlots;
+	for(TPair<FName, FUtilityCoverSpatialHash>& Pair : CoverIndices)
+	{
+		if(!CoverActor->ActorHasTag(Pair.Key) || Pair.Value.CoverActors.Contains(CoverActor))
+		{
+			continue;
+		}
+
+		if(ActorSlots.Num() == 0)
+		{
+			GenerateCoverSlots(CoverActor,GUtilityAICoverSlotSpacing,ActorSlots);
+		}
+		for(const FUtilityCoverSlot& Slot : ActorSlots)
+		{
+			Pair.Value.AddSlot(Slot);
+		}
+	}
+
+	if(ActorSlots.Num() > 0)
+	{
+		WatchCoverActor(CoverActor);
+	}
+}
+
+void UUtilityAICoverSubsystem::RemoveCoverActor(const AActor* CoverActor)
+{
+	if(!CoverActor)
+	{
+		return;
+	}
+
+	for(TPair<FName, FUtilityCoverSpatialHash>& Pair : CoverIndices)
+	{
+		//Compares the weak pointer without resolving it, so this works while the actor is being destroyed.
+		Pair.Value.RemoveSlots([CoverActor](const FUtilityCoverSlot& Slot)
+		{
+			return Slot.CoverActor == CoverActor;
+		});
+	}
+}
+
+void UUtilityAICoverSubsystem::OnActorSpawned(AActor* SpawnedActor)
+{
+	AddCoverActor(SpawnedActor);
+}
+
+void UUtilityAICoverSubsystem::WatchCoverActor(AActor* CoverActor)
+{
+	if(CoverActor)
+	{
+		CoverActor->OnDestroyed.AddUniqueDynamic(this, &UUtilityAICoverSubsystem::OnCoverActorDestroyed);
+	}
+}
+
+void UUtilityAICoverSubsystem::OnCoverActorDestroyed(AActor* DestroyedActor)
+{
+	RemoveCoverActor(DestroyedActor);
+}
+
+void UUtilityAICoverSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if(!Level || World != GetWorld() || CoverIndices.Num() == 0)
+	{
+		return; //Indices built later gather the level's actors themselves.
+	}
+
+	for(AActor* Actor : Level->Actors)
+	{
+		AddCoverActor(Actor);
+	}
+}
+
+void UUtilityAICoverSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	//A null level is the whole world going away, Deinitialize() handles that.
+	if(!Level || World != GetWorld())
+	{
+		return;
+	}
+
+	for(TPair<FName, FUtilityCoverSpatialHash>& Pair : CoverIndices)
+	{
+		Pair.Value.RemoveSlots([Level](const FUtilityCoverSlot& Slot)
+		{
+			const AActor* CoverActor = Slot.CoverActor.Get();
+			return Slot.CoverActor.IsStale() || (CoverActor && CoverActor->GetLevel() == Level);
+		});
+	}
+}
+
+void UUtilityAICoverSubsystem::RebuildCoverIndex()
+{
+	TArray<FName> CoverTags;
+	CoverIndices.GetKeys(CoverTags);
+	for(const FName& CoverTag : CoverTags)
+	{
+		BuildCoverIndex(CoverTag);
+	}
+}
+
+int32 UUtilityAICoverSubsystem::GetCoverSlotCount() const
+{
+	int32 SlotCount = 0;
+	for(const TPair<FName, FUtilityCoverSpatialHash>& Pair : CoverIndices)
+	{
+		SlotCount += Pair.Value.GetSlotCount();
+	}
+	return SlotCount;
+}
+
+void UUtilityAICoverSubsystem::GenerateCoverSlots(AActor* CoverActor, float SlotSpacing, TArray<FUtilityCoverSlot>& OutSlots)
+{
+	if(!CoverActor)
+	{
+		return;
+	}
+
+	//Local space, so rotated cover gets slots along its real sides, not its world axis aligned box.
+	const FBox LocalBounds = CoverActor->CalculateComponentsBoundingBoxInLocalSpace();
+	if(!LocalBounds.IsValid)
+	{
+		return;
+	}
+
+	const FTransform& ActorTransform = CoverActor->GetActorTransform();
+	const FVector Min = LocalBounds.Min;
+	const FVector Max = LocalBounds.Max;
+	const float MidZ = (Min.Z + Max.Z)*0.5f;
+	const float Height = ActorTransform.TransformVector(FVector(0.0f,0.0f,Max.Z - Min.Z)).Size();
+	SlotSpacing = FMath::Max(SlotSpacing,1.0f);
+
+	//The four sides of the bounds, going around. Each is Start -> End, with its outward normal.
+	const FVector Corners[4] = {FVector(Min.X,Min.Y,MidZ), FVector(Max.X,Min.Y,MidZ), FVector(Max.X,Max.Y,MidZ), FVector(Min.X,Max.Y,MidZ)};
+	const FVector Normals[4] = {FVector(0.0f,-1.0f,0.0f), FVector(1.0f,0.0f,0.0f), FVector(0.0f,1.0f,0.0f), FVector(-1.0f,0.0f,0.0f)};
+
+	for(int32 Side = 0; Side < 4; Side++)
+	{
+		const FVector Start = Corners[Side];
+		const FVector End = Corners[(Side + 1) % 4];
+		const float SideLength = ActorTransform.TransformVector(End - Start).Size();
+		const int32 SlotCount = FMath::Max(FMath::FloorToInt(SideLength/SlotSpacing),1);
+
+		for(int32 SlotIndex = 0; SlotIndex < SlotCount; SlotIndex++)
+		{
+			const float Alpha = (SlotIndex + 0.5f)/SlotCount;
+
+			FUtilityCoverSlot Slot;
+			Slot.Location = ActorTransform.TransformPosition(FMath::Lerp(Start,End,Alpha));
+			Slot.Normal = ActorTransform.TransformVectorNoScale(Normals[Side]);
+			Slot.CoverActor = CoverActor;
+			Slot.Height = Height;
+			OutSlots.Add(Slot);
+		}
+	}
+}
+
+bool UUtilityAICoverSubsystem::ClaimCover(const UObject* Claimant, const FVector& Location)
+{
+	ReleaseCover(Claimant);
+
+	if(!Claimant || IsCoverClaimedByOther(Location,Claimant))
+	{
+		return false;
+	}
+
+	FUtilityCoverClaim Claim;
+	Claim.Location = Location;
+	Claim.Cell = GetClaimCell(Location);
+	Claim.Claimant = Claimant;
+	CoverClaimCells.FindOrAdd(Claim.Cell).Add(Claim);
+	ClaimLocations.Add(Claimant,Claim);
+	return true;
+}
+
+void UUtilityAICoverSubsystem::ReleaseCover(const UObject* Claimant)
+{
+	FUtilityCoverClaim ReleasedClaim;
+	if(!ClaimLocations.RemoveAndCopyValue(Claimant,ReleasedClaim))
+	{
+		return;
+	}
+
+	const FIntPoint ClaimCell = ReleasedClaim.Cell;
+	if(TArray<FUtilityCoverClaim, TInlineAllocator<2>>* CellClaims = CoverClaimCells.Find(ClaimCell))
+	{
+		CellClaims->RemoveAllSwap([Claimant](const FUtilityCoverClaim& Claim) { return Claim.Claimant.Get() == Claimant || !Claim.Claimant.IsValid(); });
+		if(CellClaims->Num() == 0)
+		{
+			CoverClaimCells.Remove(ClaimCell);
+		}
+	}
+}
+
+bool UUtilityAICoverSubsystem::IsCoverClaimedByOther(const FVector& Location, const UObject* Claimant) const
+{
+	if(CoverClaimCells.Num() == 0)
+	{
+		return false;
+	}
+
+	const FIntPoint Center = GetClaimCell(Location);
+	const float ClaimRadiusSquared = FMath::Square(GUtilityAICoverClaimRadius);
+
+	for(int32 CellX = Center.X - 1; CellX <= Center.X + 1; CellX++)
+	{
+		for(int32 CellY = Center.Y - 1; CellY <= Center.Y + 1; CellY++)
+		{
+			const TArray<FUtilityCoverClaim, TInlineAllocator<2>>* CellClaims = CoverClaimCells.Find(FIntPoint(CellX,CellY));
+			if(!CellClaims)
+			{
+				continue;
+			}
+
+			for(const FUtilityCoverClaim& Claim : *CellClaims)
+			{
+				//Claims of agents that were destroyed without releasing don't count.
+				const UObject* ClaimOwner = Claim.Claimant.Get();
+				if(ClaimOwner && ClaimOwner != Claimant && FVector::DistSquared(Claim.Location,Location) <= ClaimRadiusSquared)
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+FIntPoint UUtilityAICoverSubsystem::GetClaimCell(const FVector& Location) const
+{
+	const float CellSize = FMath::Max(GUtilityAICoverClaimRadius,1.0f);
+	return FIntPoint(FMath::FloorToInt(Location.X/CellSize),FMath::FloorToInt(Location.Y/CellSize));
+}
+
+EUtilityCoverVisibility UUtilityAICoverSubsystem::QueryCoverVisibility(const FVector& CoverLocation, const FVector& FocusLocation)
+{
+	UWorld* World = GetWorld();
+	const double WorldTime = World->GetTimeSeconds();
+
+	FUtilityCoverVisibilityKey Key;
+	Key.CoverCell = GetVisibilityCell(CoverLocation);
+	Key.FocusCell = GetVisibilityCell(FocusLocation);
+
+	FUtilityCoverVisibilityEntry& Entry = VisibilityCache.FindOrAdd(Key);
+	if(Entry.bPending || (Entry.TraceTime >= 0.0 && WorldTime - Entry.TraceTime <= GUtilityAICoverVisibilityMaxAge))
+	{
+		return Entry.Visibility;
+	}
+
+	//Missing or expired. Trace from the focus to where an agent would stand behind the cover, and keep the old answer meanwhile.
+	if(!VisibilityTraceDelegate.IsBound())
+	{
+		VisibilityTraceDelegate.BindUObject(this, &UUtilityAICoverSubsystem::OnVisibilityTraceDone);
+	}
+
+	const FVector AwayFromFocus = FVector(CoverLocation.X - FocusLocation.X,CoverLocation.Y - FocusLocation.Y,0.0f).GetSafeNormal();
+	const FVector HidingLocation = CoverLocation + AwayFromFocus*GUtilityAICoverVisibilityStandOff;
+
+	//Only level geometry hides someone. Pawns block the visibility channel, and would count any agent between the two as cover.
+	//The answer is shared by every agent in the cells, so ignoring the agents asking wouldn't be enough.
+	FCollisionObjectQueryParams ObjectQueryParams;
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_WorldStatic);
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_WorldDynamic);
+
+	const FTraceHandle TraceHandle = World->AsyncLineTraceByObjectType(EAsyncTraceType::Single,FocusLocation,HidingLocation,ObjectQueryParams,
+		FCollisionQueryParams::DefaultQueryParam,&VisibilityTraceDelegate);
+	INC_DWORD_STAT(STAT_UtilityAI_TracesIssued);
+
+	Entry.TraceTime = WorldTime;
+	Entry.bPending = true;
+	PendingVisibilityTraces.Add(TraceHandle._Handle,Key);
+
+	if(WorldTime - LastVisibilityPruneTime > GUtilityAICoverVisibilityMaxAge*4.0f)
+	{
+		PruneVisibilityCache(WorldTime);
+	}
+
+	return VisibilityCache.FindRef(Key).Visibility;
+}
+
+void UUtilityAICoverSubsystem::OnVisibilityTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	FUtilityCoverVisibilityKey Key;
+	if(!PendingVisibilityTraces.RemoveAndCopyValue(TraceHandle._Handle,Key))
+	{
+		return;
+	}
+
+	if(FUtilityCoverVisibilityEntry* Entry = VisibilityCache.Find(Key))
+	{
+		//Anything on the line before the hiding spot means it can't be seen. A hit at the spot itself is the floor or a wall it touches.
+		const float TraceLength = FVector::Dist(TraceDatum.Start,TraceDatum.End);
+		const bool bBlocked = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit
+			&& TraceDatum.OutHits[0].Distance < TraceLength - UtilityCoverVisibilityHitTolerance;
+		Entry->Visibility = bBlocked ? EUtilityCoverVisibility::HIDDEN : EUtilityCoverVisibility::VISIBLE;
+		Entry->bPending = false;
+	}
+}
+
+void UUtilityAICoverSubsystem::PruneVisibilityCache(double WorldTime)
+{
+	LastVisibilityPruneTime = WorldTime;
+
+	const double PruneAge = GUtilityAICoverVisibilityMaxAge*4.0;
+	for(auto It = VisibilityCache.CreateIterator(); It; ++It)
+	{
+		if(!It.Value().bPending && WorldTime - It.Value().TraceTime > PruneAge)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+FIntVector UUtilityAICoverSubsystem::GetVisibilityCell(const FVector& Location) const
+{
+	const float CellSize = FMath::Max(GUtilityAICoverVisibilityCellSize,1.0f);
+	return FIntVector(FMath::FloorToInt(Location.X/CellSize),FMath::FloorToInt(Location.Y/CellSize),FMath::FloorToInt(Location.Z/CellSize));
+}
+
+void UUtilityAICoverSubsystem::CompareCoverSearchModes(ECoverSearchMode ModeA, ECoverSearchMode ModeB) const
+{
+	const UUtilityAIDecisionSubsystem* DecisionSubsystem = GetWorld()->GetSubsystem<UUtilityAIDecisionSubsystem>();
+	if(!DecisionSubsystem)
+	{
+		return;
+	}
+
+	if(ModeA == ECoverSearchMode::ASYNC_SWEEP || ModeB == ECoverSearchMode::ASYNC_SWEEP)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI.Cover.Compare: ASYNC_SWEEP doesn't finish in one call, compare SWEEP instead."));
+		return;
+	}
+
+	TArray<UUtilityAIManagerComponent*> Managers;
+	DecisionSubsystem->GetRegisteredManagers(Managers);
+
+	int32 Searches = 0;
+	int64 TracesA = 0;
+	int64 TracesB = 0;
+	double SecondsA = 0.0;
+	double SecondsB = 0.0;
+	int32 FoundA = 0;
+	int32 FoundB = 0;
+	int32 FoundBoth = 0;
+	int32 SameCoverActor = 0;
+	double DistanceToCoverA = 0.0;
+	double DistanceToCoverB = 0.0;
+	double DistanceBetweenCover = 0.0;
+
+	for(UUtilityAIManagerComponent* Manager : Managers)
+	{
+		if(!Manager || !Manager->CanSearchForCover())
+		{
+			continue;
+		}
+
+		const FUtilityCoverSearchResult ResultA = Manager->RunCoverSearchForComparison(ModeA);
+		const FUtilityCoverSearchResult ResultB = Manager->RunCoverSearchForComparison(ModeB);
+
+		Searches++;
+		TracesA += ResultA.Traces;
+		TracesB += ResultB.Traces;
+		SecondsA += ResultA.Seconds;
+		SecondsB += ResultB.Seconds;
+		FoundA += ResultA.bFoundCover ? 1 : 0;
+		FoundB += ResultB.bFoundCover ? 1 : 0;
+
+		if(ResultA.bFoundCover && ResultB.bFoundCover)
+		{
+			FoundBoth++;
+			SameCoverActor += ResultA.Hit.GetActor() == ResultB.Hit.GetActor() ? 1 : 0;
+			DistanceToCoverA += ResultA.DistanceToCover;
+			DistanceToCoverB += ResultB.DistanceToCover;
+			DistanceBetweenCover += FVector::Dist(ResultA.Hit.Location,ResultB.Hit.Location);
+		}
+	}
+
+	if(Searches == 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("UtilityAI.Cover.Compare: No agent can search for cover right now."));
+		return;
+	}
+
+	const UEnum* ModeEnum = StaticEnum<ECoverSearchMode>();
+	const FString NameA = ModeEnum->GetNameStringByValue(static_cast<int64>(ModeA));
+	const FString NameB = ModeEnum->GetNameStringByValue(static_cast<int64>(ModeB));
+	const int32 BothDivisor = FMath::Max(FoundBoth,1);
+
+	UE_LOG(LogTemp, Log, TEXT("UtilityAI.Cover.Compare over %d agents: %s vs %s"), Searches, *NameA, *NameB);
+	UE_LOG(LogTemp, Log, TEXT("  Traces per search: %.1f vs %.1f"), static_cast<double>(TracesA)/Searches, static_cast<double>(TracesB)/Searches);
+	UE_LOG(LogTemp, Log, TEXT("  Time per search: %.3f ms vs %.3f ms"), SecondsA*1000.0/Searches, SecondsB*1000.0/Searches);
+	UE_LOG(LogTemp, Log, TEXT("  Found cover: %d vs %d"), FoundA, FoundB);
+	UE_LOG(LogTemp, Log, TEXT("  When both found cover (%d): same actor %.0f%%, DistanceToCover %.0f vs %.0f, %.0f apart"),
+		FoundBoth, 100.0*SameCoverActor/BothDivisor, DistanceToCoverA/BothDivisor, DistanceToCoverB/BothDivisor, DistanceBetweenCover/BothDivisor);
+}
@@ -0,0 +1,711 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAICrowdSubsystem.h"
+#include "UtilityAIDecisionSubsystem.h"
+#include "UtilityAIManagerComponent.h"
+#include "UtilityAIStats.h"
+#include "AIController.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/ParallelFor.h"
+#include "Algo/StableSort.h"
+
+static int32 GUtilityAICrowdEnabled = 1;
+static FAutoConsoleVariableRef CVarUtilityAICrowdEnabled(
+	TEXT("UtilityAI.Crowd.Enabled"),
+	GUtilityAICrowdEnabled,
+	TEXT("0 = crowd agents stop deciding and are never promoted. Their tasks keep running."),
+	ECVF_Default);
+
+static int32 GUtilityAICrowdParallelBatchSize = 64;
+static FAutoConsoleVariableRef CVarUtilityAICrowdParallelBatchSize(
+	TEXT("UtilityAI.Crowd.ParallelBatchSize"),
+	GUtilityAICrowdParallelBatchSize,
+	TEXT("Crowd agents scored by one ParallelFor task. Fewer deciding agents than this are scored on the game thread."),
+	ECVF_Default);
+
+/*
+Moves the Stride elements of LastSlot into Slot, and drops the last slot.
+*/
+template<typename ElementType>
+static void RemoveCrowdSlot(TArray<ElementType>& Array, const int32 Stride, const int32 Slot, const int32 LastSlot)
+{
+	if(Stride <= 0)
+	{
+		return;
+	}
+
+	if(Slot != LastSlot)
+	{
+		for(int32 Offset = 0; Offset < Stride; Offset++)
+		{
+			Array[Slot * Stride + Offset] = Array[LastSlot * Stride + Offset];
+		}
+	}
+	Array.SetNum(LastSlot * Stride, false);
+}
+
+void UUtilityAICrowdSubsystem::Deinitialize()
+{
+	Groups.Empty();
+	GroupArchetypes.Empty();
+	PendingTaskEvents.Empty();
+	PendingPromotions.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UUtilityAICrowdSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UUtilityAICrowdSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UUtilityAICrowdSubsystem, STATGROUP_Tickables);
+}
+
+int32 UUtilityAICrowdSubsystem::FindOrAddGroup(UUtilityTaskArchetype* Archetype)
+{
+	const int32 ExistingIndex = GroupArchetypes.IndexOfByKey(Archetype);
+	if(ExistingIndex != INDEX_NONE)
+	{
+		return ExistingIndex;
+	}
+
+	FUtilityCrowdGroup& Group = Groups.AddDefaulted_GetRef();
+	GroupArchetypes.Add(Archetype);
+	Group.Archetype = Archetype;
+
+	FUtilityConsiderationTable& Table = Group.ConsiderationTable;
+	for(const UUtilityTaskDefinition* Definition : Archetype->Tasks)
+	{
+		if(!Definition)
+		{
+			continue;
+		}
+
+		Group.Tasks.Add(Definition);
+		Group.TaskLayerIndices.Add(Group.Layers.AddUnique(Definition->TaskLayer));
+
+		const TArray<FUtilityCurveCollection>& Curves = Definition->CurveCollectionArray;
+		TArray<int32, TInlineAllocator<16>> CurveOrder = {};
+		bool bEveryCurveMultiplies = true;
+		for(int32 CurveIndex = 0; CurveIndex < Curves.Num(); CurveIndex++)
+		{
+			CurveOrder.Add(CurveIndex);
+			bEveryCurveMultiplies &= Curves[CurveIndex].bMultiplyThisCurveOutputToRunningTotal;
+		}
+
+		//Same order as UUtilityAIManagerComponent::CompileConsiderationTable(), so early exit rules tasks out as soon as it can.
+		if(bEveryCurveMultiplies)
+		{
+			TArray<float, TInlineAllocator<16>> OrderKeys = {};
+			for(const FUtilityCurveCollection& CurveCollection : Curves)
+			{
+				OrderKeys.Add(FUtilityConsiderationTable::GetEvaluationOrderKey(CurveCollection));
+			}
+
+			Algo::StableSort(CurveOrder,[&OrderKeys](int32 A, int32 B)
+			{
+				return OrderKeys[A] < OrderKeys[B];
+			});
+		}
+
+		Table.TaskFirstConsideration.Add(Table.NumConsiderations);
+		for(const int32 CurveIndex : CurveOrder)
+		{
+			Table.AddConsideration(Curves[CurveIndex],CurveIndex);
+		}
+		Table.TaskConsiderationCount.Add(CurveOrder.Num());
+	}
+
+	Table.Finalize();
+
+	return Groups.Num() - 1;
+}
+
+bool UUtilityAICrowdSubsystem::FindAgent(const FUtilityCrowdAgentHandle& Agent, FUtilityCrowdGroup*& OutGroup, int32& OutSlot)
+{
+	const FUtilityCrowdGroup* ConstGroup = nullptr;
+	const bool bFound = static_cast<const UUtilityAICrowdSubsystem*>(this)->FindAgent(Agent,ConstGroup,OutSlot);
+	OutGroup = const_cast<FUtilityCrowdGroup*>(ConstGroup);
+	return bFound;
+}
+
+bool UUtilityAICrowdSubsystem::FindAgent(const FUtilityCrowdAgentHandle& Agent, const FUtilityCrowdGroup*& OutGroup, int32& OutSlot) const
+{
+	if(!Agent.IsValid() || !Groups.IsValidIndex(Agent.Group))
+	{
+		return false;
+	}
+
+	const FUtilityCrowdGroup& Group = Groups[Agent.Group];
+	const int32* Slot = Group.SlotOfId.Find(Agent.Id);
+	if(!Slot)
+	{
+		return false;
+	}
+
+	OutGroup = &Group;
+	OutSlot = *Slot;
+	return true;
+}
+
+FUtilityCrowdAgentHandle UUtilityAICrowdSubsystem::AddAgent(UUtilityTaskArchetype* Archetype, FVector Location, APawn* Pawn)
+{
+	if(!Archetype)
+	{
+		return FUtilityCrowdAgentHandle();
+	}
+
+	const int32 GroupIndex = FindOrAddGroup(Archetype);
+	FUtilityCrowdGroup& Group = Groups[GroupIndex];
+	const int32 NumTasks = Group.Tasks.Num();
+	const int32 NumLayers = Group.Layers.Num();
+
+	const int32 Slot = Group.Agents.AddDefaulted();
+	FUtilityCrowdAgent& CrowdAgent = Group.Agents[Slot];
+	CrowdAgent.Location = Pawn ? Pawn->GetActorLocation() : Location;
+	CrowdAgent.Pawn = Pawn;
+
+	Group.StatValues.AddZeroed(Group.GetNumStats());
+
+	const int32 FirstState = Group.TaskStates.AddDefaulted(NumTasks);
+	for(int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		Group.TaskStates[FirstState + TaskIndex].CurrentCooldown = Group.Tasks[TaskIndex]->Cooldown;
+	}
+	Group.TaskScores.AddZeroed(NumTasks);
+
+	for(int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
+	{
+		Group.CurrentTaskIndices.Add(INDEX_NONE);
+		Group.BestTaskIndices.Add(INDEX_NONE);
+	}
+
+	FUtilityCrowdAgentHandle Handle;
+	Handle.Group = GroupIndex;
+	Handle.Id = NextAgentId++;
+
+	Group.IdOfSlot.Add(Handle.Id);
+	Group.SlotOfId.Add(Handle.Id,Slot);
+
+	return Handle;
+}
+
+void UUtilityAICrowdSubsystem::RemoveAgent(FUtilityCrowdAgentHandle Agent)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(!FindAgent(Agent,Group,Slot))
+	{
+		return;
+	}
+
+	const int32 LastSlot = Group->Agents.Num() - 1;
+	const int32 NumTasks = Group->Tasks.Num();
+	const int32 NumLayers = Group->Layers.Num();
+
+	RemoveCrowdSlot(Group->Agents,1,Slot,LastSlot);
+	RemoveCrowdSlot(Group->StatValues,Group->GetNumStats(),Slot,LastSlot);
+	RemoveCrowdSlot(Group->TaskStates,NumTasks,Slot,LastSlot);
+	RemoveCrowdSlot(Group->TaskScores,NumTasks,Slot,LastSlot);
+	RemoveCrowdSlot(Group->CurrentTaskIndices,NumLayers,Slot,LastSlot);
+	RemoveCrowdSlot(Group->BestTaskIndices,NumLayers,Slot,LastSlot);
+	RemoveCrowdSlot(Group->IdOfSlot,1,Slot,LastSlot);
+
+	Group->SlotOfId.Remove(Agent.Id);
+	if(Slot != LastSlot)
+	{
+		Group->SlotOfId.Add(Group->IdOfSlot[Slot],Slot);
+	}
+}
+
+bool UUtilityAICrowdSubsystem::IsAgentValid(FUtilityCrowdAgentHandle Agent) const
+{
+	const FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	return FindAgent(Agent,Group,Slot);
+}
+
+void UUtilityAICrowdSubsystem::SetAgentLocation(FUtilityCrowdAgentHandle Agent, FVector Location)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(FindAgent(Agent,Group,Slot))
+	{
+		Group->Agents[Slot].Location = Location;
+	}
+}
+
+void UUtilityAICrowdSubsystem::SetAgentFocus(FUtilityCrowdAgentHandle Agent, AActor* Focus)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(FindAgent(Agent,Group,Slot))
+	{
+		Group->Agents[Slot].Focus = Focus;
+	}
+}
+
+void UUtilityAICrowdSubsystem::SetAgentPointOfInterest(FUtilityCrowdAgentHandle Agent, bool bIsSet, FVector PointOfInterest)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(FindAgent(Agent,Group,Slot))
+	{
+		Group->Agents[Slot].bCurrentPointOfInterestSet = bIsSet;
+		Group->Agents[Slot].CurrentPointOfInterest = PointOfInterest;
+	}
+}
+
+void UUtilityAICrowdSubsystem::SetAgentStat(FUtilityCrowdAgentHandle Agent, FName StatName, float Value)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(!FindAgent(Agent,Group,Slot))
+	{
+		return;
+	}
+
+	const int32 StatIndex = Group->ConsiderationTable.StatNames.IndexOfByKey(StatName);
+	if(StatIndex != INDEX_NONE)
+	{
+		Group->StatValues[Slot * Group->GetNumStats() + StatIndex] = Value;
+	}
+}
+
+void UUtilityAICrowdSubsystem::FinishAgentTask(FUtilityCrowdAgentHandle Agent, FName TaskName)
+{
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(!FindAgent(Agent,Group,Slot))
+	{
+		return;
+	}
+
+	const int32 NumTasks = Group->Tasks.Num();
+	for(int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		if(Group->Tasks[TaskIndex]->TaskName == TaskName)
+		{
+			Group->TaskStates[Slot * NumTasks + TaskIndex].bIsTaskActive = false;
+			return;
+		}
+	}
+}
+
+FName UUtilityAICrowdSubsystem::GetAgentTask(FUtilityCrowdAgentHandle Agent, int32 TaskLayer) const
+{
+	const FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	const int32 LayerIndex = FindAgent(Agent,Group,Slot) ? Group->Layers.IndexOfByKey(TaskLayer) : INDEX_NONE;
+	if(LayerIndex == INDEX_NONE)
+	{
+		return NAME_None;
+	}
+
+	const int32 TaskIndex = Group->CurrentTaskIndices[Slot * Group->Layers.Num() + LayerIndex];
+	if(TaskIndex == INDEX_NONE || !Group->TaskStates[Slot * Group->Tasks.Num() + TaskIndex].bIsTaskActive)
+	{
+		return NAME_None;
+	}
+	return Group->Tasks[TaskIndex]->TaskName;
+}
+
+int32 UUtilityAICrowdSubsystem::GetAgentCount() const
+{
+	int32 Count = 0;
+	for(const FUtilityCrowdGroup& Group : Groups)
+	{
+		Count += Group.Agents.Num();
+	}
+	return Count;
+}
+
+void UUtilityAICrowdSubsystem::Tick(float DeltaTime)
+{
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_CrowdTick, CrowdTick);
+
+	UWorld* World = GetWorld();
+	if(!World || !GUtilityAICrowdEnabled)
+	{
+		return;
+	}
+
+	const double WorldTime = World->GetTimeSeconds();
+
+	PlayerPawnLocations.Reset();
+	if(UUtilityAIDecisionSubsystem* DecisionSubsystem = World->GetSubsystem<UUtilityAIDecisionSubsystem>())
+	{
+		PlayerPawnLocations.Append(DecisionSubsystem->GetPlayerPawnLocations());
+	}
+
+	const int32 BatchSize = FMath::Max(GUtilityAICrowdParallelBatchSize,1);
+	int32 Decisions = 0;
+
+	for(int32 GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+	{
+		FUtilityCrowdGroup& Group = Groups[GroupIndex];
+		GatherDecidingAgents(Group,DeltaTime);
+
+		const int32 NumDeciding = Group.DecidingSlots.Num();
+		if(NumDeciding == 0)
+		{
+			continue;
+		}
+
+		//Each agent only writes to its own slot, and the table is only read.
+		const int32 NumBatches = FMath::DivideAndRoundUp(NumDeciding,BatchSize);
+		ParallelFor(NumBatches,[this,&Group,BatchSize,NumDeciding,WorldTime](int32 BatchIndex)
+		{
+			const int32 End = FMath::Min((BatchIndex + 1) * BatchSize,NumDeciding);
+			for(int32 DecidingIndex = BatchIndex * BatchSize; DecidingIndex < End; DecidingIndex++)
+			{
+				ScoreAgent(Group,DecidingIndex,WorldTime);
+			}
+		}, NumBatches <= 1);
+
+		for(int32 DecidingIndex = 0; DecidingIndex < NumDeciding; DecidingIndex++)
+		{
+			const int32 Slot = Group.DecidingSlots[DecidingIndex];
+			ApplyBestTasks(Group,GroupIndex,Slot,WorldTime);
+
+			if(Group.PromoteFlags[DecidingIndex])
+			{
+				FUtilityCrowdAgentHandle Handle;
+				Handle.Group = GroupIndex;
+				Handle.Id = Group.IdOfSlot[Slot];
+				PendingPromotions.Add(Handle);
+			}
+		}
+
+		Decisions += NumDeciding;
+	}
+
+	//Groups may be added or agents removed from here on.
+	for(const FUtilityCrowdPendingTaskEvent& TaskEvent : PendingTaskEvents)
+	{
+		if(TaskEvent.bEnter)
+		{
+			OnCrowdTaskEnter.Broadcast(TaskEvent.Agent,TaskEvent.TaskName);
+		}
+		else
+		{
+			OnCrowdTaskExit.Broadcast(TaskEvent.Agent,TaskEvent.TaskName);
+		}
+	}
+	PendingTaskEvents.Reset();
+
+	const int32 Promotions = PendingPromotions.Num();
+	for(const FUtilityCrowdAgentHandle& Handle : PendingPromotions)
+	{
+		PromoteAgent(Handle);
+	}
+	PendingPromotions.Reset();
+
+	const int32 AgentCount = GetAgentCount();
+
+	SET_DWORD_STAT(STAT_UtilityAI_CrowdAgents, AgentCount);
+	SET_DWORD_STAT(STAT_UtilityAI_CrowdDecisions, Decisions);
+	SET_DWORD_STAT(STAT_UtilityAI_CrowdPromotions, Promotions);
+
+	CSV_CUSTOM_STAT(UtilityAI, CrowdAgents, AgentCount, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, CrowdDecisions, Decisions, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, CrowdPromotions, Promotions, ECsvCustomStatOp::Set);
+}
+
+void UUtilityAICrowdSubsystem::GatherDecidingAgents(FUtilityCrowdGroup& Group, float DeltaTime)
+{
+	Group.DecidingSlots.Reset();
+	Group.PromoteFlags.Reset();
+
+	const int32 NumAgents = Group.Agents.Num();
+	if(NumAgents == 0 || Group.Tasks.Num() == 0)
+	{
+		return;
+	}
+
+	//Spread every agent's decision over the interval, carrying the fractions so none is skipped.
+	int32 NumDue = NumAgents;
+	const float DecisionInterval = Group.Archetype->Crowd.DecisionInterval;
+	if(DecisionInterval > 0.0f)
+	{
+		const float Due = NumAgents * DeltaTime / DecisionInterval + Group.DecisionCarry;
+		NumDue = FMath::Min(FMath::FloorToInt(Due),NumAgents);
+		Group.DecisionCarry = NumDue < NumAgents ? Due - NumDue : 0.0f;
+	}
+
+	if(Group.Cursor >= NumAgents)
+	{
+		Group.Cursor = 0;
+	}
+
+	UUtilityAIDecisionSubsystem* DecisionSubsystem = GetWorld()->GetSubsystem<UUtilityAIDecisionSubsystem>();
+
+	for(int32 DueIndex = 0; DueIndex < NumDue; DueIndex++)
+	{
+		const int32 Slot = Group.Cursor;
+		Group.Cursor = (Group.Cursor + 1) % NumAgents;
+
+		FUtilityCrowdAgent& CrowdAgent = Group.Agents[Slot];
+		if(const APawn* Pawn = CrowdAgent.Pawn.Get())
+		{
+			CrowdAgent.Location = Pawn->GetActorLocation();
+		}
+
+		AActor* Focus = CrowdAgent.Focus.Get();
+		CrowdAgent.bHasFocus = Focus != nullptr;
+		if(Focus && DecisionSubsystem)
+		{
+			bool bGathered = false;
+			CrowdAgent.FocusFacts = DecisionSubsystem->GetFocusFacts(Focus,bGathered);
+		}
+		else if(Focus)
+		{
+			UUtilityAIDecisionSubsystem::GatherFocusFacts(Focus,CrowdAgent.FocusFacts);
+		}
+
+		Group.DecidingSlots.Add(Slot);
+	}
+
+	Group.PromoteFlags.SetNumZeroed(Group.DecidingSlots.Num());
+}
+
+void UUtilityAICrowdSubsystem::CaptureAgentInputs(const FUtilityCrowdAgent& Agent, const FUtilityCrowdSettings& Settings, FUtilityDecisionSnapshot& OutSnapshot)
+{
+	OutSnapshot.bHasFocus = Agent.bHasFocus;
+	OutSnapshot.bIsFocusMeleeAttacking = Agent.bHasFocus && Agent.FocusFacts.bIsMeleeAttacking;
+	OutSnapshot.bIsFocusRangeAttacking = Agent.bHasFocus && Agent.FocusFacts.bIsRangeAttacking;
+	OutSnapshot.bIsFocusAnyAttacking = OutSnapshot.bIsFocusMeleeAttacking || OutSnapshot.bIsFocusRangeAttacking;
+	OutSnapshot.DistanceToFocus = Agent.bHasFocus ? FVector::Dist(Agent.Location,Agent.FocusFacts.Location) : -1.0f;
+
+	OutSnapshot.bCurrentPointOfInterestSet = Agent.bCurrentPointOfInterestSet;
+	OutSnapshot.DistanceToCurrentPointOfInterest = Agent.bCurrentPointOfInterestSet ? FVector::Dist(Agent.Location,Agent.CurrentPointOfInterest) : -1.0f;
+
+	OutSnapshot.MeleeRange = Settings.MeleeRange;
+	OutSnapshot.MeleeRangeFallout = Settings.MeleeRangeFallout;
+	OutSnapshot.ComfortableDistance = Settings.ComfortableDistance;
+	OutSnapshot.MaxDistanceToCurrentPointOfInterest = Settings.MaxDistanceToCurrentPointOfInterest;
+
+	OutSnapshot.ComputeQueryValues();
+}
+
+void UUtilityAICrowdSubsystem::ScoreAgent(FUtilityCrowdGroup& Group, int32 DecidingIndex, double WorldTime) const
+{
+	const int32 Slot = Group.DecidingSlots[DecidingIndex];
+	const FUtilityCrowdAgent& CrowdAgent = Group.Agents[Slot];
+	const FUtilityCrowdSettings& Settings = Group.Archetype->Crowd;
+	const FUtilityConsiderationTable& Table = Group.ConsiderationTable;
+	const int32 NumTasks = Group.Tasks.Num();
+	const int32 NumLayers = Group.Layers.Num();
+	const int32 NumStats = Group.GetNumStats();
+
+	FUtilityDecisionSnapshot Snapshot;
+	CaptureAgentInputs(CrowdAgent,Settings,Snapshot);
+
+	const float* StatValues = NumStats > 0 ? &Group.StatValues[Slot * NumStats] : nullptr;
+	const FUtilityTaskRuntimeState* TaskStates = &Group.TaskStates[Slot * NumTasks];
+	float* TaskScores = &Group.TaskScores[Slot * NumTasks];
+	const int32* CurrentTaskIndices = &Group.CurrentTaskIndices[Slot * NumLayers];
+	int32* BestTaskIndices = &Group.BestTaskIndices[Slot * NumLayers];
+
+	TUtilityLayerArray<float> BestLayerScores = {};
+	BestLayerScores.Init(0.0f,NumLayers);
+	for(int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
+	{
+		BestTaskIndices[LayerIndex] = INDEX_NONE;
+	}
+
+	for(int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		if(!TaskStates[TaskIndex].IsReadyAt(*Group.Tasks[TaskIndex],WorldTime))
+		{
+			TaskScores[TaskIndex] = 0.0f;
+			continue;
+		}
+
+		const int32 LayerIndex = Group.TaskLayerIndices[TaskIndex];
+
+		//Same bound as UUtilityAIManagerComponent::ScoreTasksWithEarlyExit(). The current task only has to stay above the threshold.
+		const bool bExitEarly = Table.TaskExitEarlyFlags[TaskIndex] != 0;
+		const float Bound = CurrentTaskIndices[LayerIndex] == TaskIndex
+			? Settings.TaskThreshold
+			: FMath::Max(Settings.TaskThreshold,BestLayerScores[LayerIndex]);
+
+		float Score = 1.0f;
+		const int32 FirstConsideration = Table.TaskFirstConsideration[TaskIndex];
+		const int32 EndConsideration = FirstConsideration + Table.TaskConsiderationCount[TaskIndex];
+		for(int32 Index = FirstConsideration; Index < EndConsideration; Index++)
+		{
+			const int32 StatIndex = Table.StatIndices[Index];
+			const float Input = StatIndex != INDEX_NONE ? StatValues[StatIndex] : Snapshot.GetQueryValue(Table.InputQueries[Index]);
+			const float Output = Table.EvaluateConsiderationAt(Index,Input);
+			Score = Table.MultiplyFlags[Index] ? Score * Output : Score + Output;
+
+			if(bExitEarly && Score < Bound)
+			{
+				break;
+			}
+		}
+
+		TaskScores[TaskIndex] = Score;
+		if(Score >= Settings.TaskThreshold && (BestTaskIndices[LayerIndex] == INDEX_NONE || Score > BestLayerScores[LayerIndex]))
+		{
+			BestTaskIndices[LayerIndex] = TaskIndex;
+			BestLayerScores[LayerIndex] = Score;
+		}
+	}
+
+	const float PromotionDistance = Settings.PromotionDistance;
+	if(PromotionDistance > 0.0f)
+	{
+		for(const FVector& PlayerPawnLocation : PlayerPawnLocations)
+		{
+			if(FVector::DistSquared(CrowdAgent.Location,PlayerPawnLocation) < PromotionDistance * PromotionDistance)
+			{
+				Group.PromoteFlags[DecidingIndex] = 1;
+				break;
+			}
+		}
+	}
+}
+
+void UUtilityAICrowdSubsystem::ApplyBestTasks(FUtilityCrowdGroup& Group, int32 GroupIndex, int32 Slot, double WorldTime)
+{
+	const int32 NumTasks = Group.Tasks.Num();
+	const int32 NumLayers = Group.Layers.Num();
+	const float TaskThreshold = Group.Archetype->Crowd.TaskThreshold;
+
+	FUtilityTaskRuntimeState* TaskStates = &Group.TaskStates[Slot * NumTasks];
+	const float* TaskScores = &Group.TaskScores[Slot * NumTasks];
+	int32* CurrentTaskIndices = &Group.CurrentTaskIndices[Slot * NumLayers];
+	const int32* BestTaskIndices = &Group.BestTaskIndices[Slot * NumLayers];
+
+	FUtilityCrowdPendingTaskEvent TaskEvent;
+	TaskEvent.Agent.Group = GroupIndex;
+	TaskEvent.Agent.Id = Group.IdOfSlot[Slot];
+
+	for(int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
+	{
+		const int32 CurrentTask = CurrentTaskIndices[LayerIndex];
+		const int32 BestTask = BestTaskIndices[LayerIndex];
+
+		bool bLayerFree = CurrentTask == INDEX_NONE;
+		if(!bLayerFree && BestTask != INDEX_NONE)
+		{
+			//Done, fell below the threshold, or interrupted by a different task.
+			const bool bDone = !TaskStates[CurrentTask].bIsTaskActive || TaskScores[CurrentTask] < TaskThreshold;
+			if(bDone || (BestTask != CurrentTask && Group.Tasks[CurrentTask]->CanBeInterruptedBy(Group.Tasks[BestTask])))
+			{
+				TaskStates[CurrentTask].Exit();
+				TaskEvent.TaskName = Group.Tasks[CurrentTask]->TaskName;
+				TaskEvent.bEnter = false;
+				PendingTaskEvents.Add(TaskEvent);
+				bLayerFree = true;
+			}
+		}
+
+		if(bLayerFree && BestTask != INDEX_NONE)
+		{
+			TaskStates[BestTask].Enter(*Group.Tasks[BestTask],WorldTime);
+			CurrentTaskIndices[LayerIndex] = BestTask;
+			TaskEvent.TaskName = Group.Tasks[BestTask]->TaskName;
+			TaskEvent.bEnter = true;
+			PendingTaskEvents.Add(TaskEvent);
+		}
+	}
+}
+
+AAIController* UUtilityAICrowdSubsystem::PromoteAgent(FUtilityCrowdAgentHandle Agent)
+{
+	UWorld* World = GetWorld();
+	FUtilityCrowdGroup* Group = nullptr;
+	int32 Slot = INDEX_NONE;
+	if(!World || !FindAgent(Agent,Group,Slot))
+	{
+		return nullptr;
+	}
+
+	//Spawning runs Blueprint that can add agents and move Groups, so copy what the promotion needs first.
+	UUtilityTaskArchetype* Archetype = Group->Archetype;
+	const FUtilityCrowdSettings Settings = Archetype->Crowd;
+	const FUtilityCrowdAgent CrowdAgent = Group->Agents[Slot];
+	const TArray<const UUtilityTaskDefinition*> Tasks = Group->Tasks;
+	const int32 NumTasks = Tasks.Num();
+	TArray<FUtilityTaskRuntimeState> TaskStates = {};
+	TaskStates.Append(&Group->TaskStates[Slot * NumTasks],NumTasks);
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	APawn* Pawn = CrowdAgent.Pawn.Get();
+	if(!Pawn && Settings.PawnClass)
+	{
+		Pawn = World->SpawnActor<APawn>(Settings.PawnClass,CrowdAgent.Location,FRotator::ZeroRotator,SpawnParameters);
+	}
+
+	if(!Pawn)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI.Crowd: Can't promote an agent of %s, it has no pawn and the archetype has no PawnClass."), *GetNameSafe(Archetype));
+		return nullptr;
+	}
+
+	AAIController* Controller = Cast<AAIController>(Pawn->GetController());
+	if(!Controller)
+	{
+		UClass* ControllerClass = Settings.ControllerClass ? Settings.ControllerClass.Get() : AAIController::StaticClass();
+		Controller = World->SpawnActor<AAIController>(ControllerClass,Pawn->GetActorLocation(),Pawn->GetActorRotation(),SpawnParameters);
+	}
+
+	if(!Controller)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UtilityAI.Crowd: Can't promote an agent of %s, its controller didn't spawn."), *GetNameSafe(Archetype));
+		return nullptr;
+	}
+
+	UUtilityAIManagerComponent* Manager = Controller->FindComponentByClass<UUtilityAIManagerComponent>();
+	if(!Manager)
+	{
+		Manager = NewObject<UUtilityAIManagerComponent>(Controller);
+		Manager->RegisterComponent();
+
+		//Nothing else calls DetermineBestTask() on a manager added here, so the decision subsystem has to.
+		Manager->bUseDecisionScheduler = true;
+	}
+
+	Manager->TaskArchetype = Archetype;
+	Manager->bCurrentPointOfInterestSet = CrowdAgent.bCurrentPointOfInterestSet;
+	Manager->CurrentPointOfInterest = CrowdAgent.CurrentPointOfInterest;
+
+	if(Controller->GetPawn() != Pawn)
+	{
+		Controller->Possess(Pawn);
+	}
+	if(AActor* Focus = CrowdAgent.Focus.Get())
+	{
+		Controller->SetFocus(Focus);
+	}
+
+	Manager->SetMovementComponentPointers();
+	Manager->Initialize();
+
+	//Keep the cooldowns and running tasks.
+	for(int32 DefinitionIndex = 0; DefinitionIndex < Manager->TaskDefinitions.Num(); DefinitionIndex++)
+	{
+		const int32 CrowdTaskIndex = Tasks.IndexOfByKey(Manager->TaskDefinitions[DefinitionIndex]);
+		if(CrowdTaskIndex != INDEX_NONE)
+		{
+			Manager->TaskStates[DefinitionIndex] = TaskStates[CrowdTaskIndex];
+		}
+	}
+	Manager->InitializeLayerBookkeeping();
+
+	RemoveAgent(Agent);
+	OnAgentPromoted.Broadcast(Agent,Controller);
+
+	return Controller;
+}
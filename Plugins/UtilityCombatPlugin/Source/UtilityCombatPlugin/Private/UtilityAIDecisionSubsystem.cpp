@@ -0,0 +1,483 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAIDecisionSubsystem.h"
+#include "UtilityAIManagerComponent.h"
+#include "UtilityCombatTaskComponent.h"
+#include "UtilityAIStats.h"
+#include "UtilityAIManagerToPawnInterface.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Async/ParallelFor.h"
+
+static float GUtilityAIDecisionBudgetMs = 2.0f;
+static FAutoConsoleVariableRef CVarUtilityAIDecisionBudgetMs(
+	TEXT("UtilityAI.Scheduler.BudgetMs"),
+	GUtilityAIDecisionBudgetMs,
+	TEXT("Milliseconds per frame the decision scheduler may spend running DetermineBestTask() for scheduled managers."),
+	ECVF_Default);
+
+static int32 GUtilityAIMinDecisionsPerFrame = 1;
+static FAutoConsoleVariableRef CVarUtilityAIMinDecisionsPerFrame(
+	TEXT("UtilityAI.Scheduler.MinDecisionsPerFrame"),
+	GUtilityAIMinDecisionsPerFrame,
+	TEXT("Decisions that always run each frame, even if the budget is already used up. Guarantees the queue drains."),
+	ECVF_Default);
+
+static int32 GUtilityAIDecisionBatchSize = 32;
+static FAutoConsoleVariableRef CVarUtilityAIDecisionBatchSize(
+	TEXT("UtilityAI.Scheduler.BatchSize"),
+	GUtilityAIDecisionBatchSize,
+	TEXT("How many decisions are snapshot, scored and applied together. The budget is checked between batches."),
+	ECVF_Default);
+
+static int32 GUtilityAIParallelScoring = 1;
+static FAutoConsoleVariableRef CVarUtilityAIParallelScoring(
+	TEXT("UtilityAI.Scheduler.ParallelScoring"),
+	GUtilityAIParallelScoring,
+	TEXT("1 = score the managers of a batch on worker threads with ParallelFor. 0 = score them on the game thread."),
+	ECVF_Default);
+
+static float GUtilityAIFocusPriorityBoost = 0.25f;
+static FAutoConsoleVariableRef CVarUtilityAIFocusPriorityBoost(
+	TEXT("UtilityAI.Scheduler.FocusPriorityBoost"),
+	GUtilityAIFocusPriorityBoost,
+	TEXT("Extra priority, in seconds of waiting, given to managers that have a ControllerFocus."),
+	ECVF_Default);
+
+static void UtilityAIDumpTopAgents(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10;
+	const float Seconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+
+	if(UUtilityAIDecisionSubsystem* DecisionSubsystem = World ? World->GetSubsystem<UUtilityAIDecisionSubsystem>() : nullptr)
+	{
+		DecisionSubsystem->DumpTopAgents(FMath::Max(Count,1),FMath::Max(Seconds,1.0f));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdUtilityAIDumpTopAgents(
+	TEXT("UtilityAI.DumpTopAgents"),
+	TEXT("UtilityAI.DumpTopAgents [Count=10] [Seconds=10]. Logs the most expensive utility AI agents and tasks over the last Seconds."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&UtilityAIDumpTopAgents));
+
+
+void UUtilityAIDecisionSubsystem::Deinitialize()
+{
+	RegisteredManagers.Empty();
+	DueQueue.Empty();
+	FocusFacts.Empty();
+	DecisionBatch.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UUtilityAIDecisionSubsystem::DoesSupportWorldType(EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UUtilityAIDecisionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UUtilityAIDecisionSubsystem, STATGROUP_Tickables);
+}
+
+void UUtilityAIDecisionSubsystem::RegisterManager(UUtilityAIManagerComponent* Manager)
+{
+	if(!Manager)
+	{
+		return;
+	}
+
+	for(const FUtilityScheduledManager& Entry : RegisteredManagers)
+	{
+		if(Entry.Manager.Get() == Manager)
+		{
+			return; //Already registered, Initialize() was called again on repossession.
+		}
+	}
+
+	FUtilityScheduledManager NewEntry;
+	NewEntry.Manager = Manager;
+
+	//Stagger the first decision so a wave of spawns doesn't all decide in the same frame.
+	const UWorld* World = GetWorld();
+	const double WorldTime = World ? World->GetTimeSeconds() : 0.0;
+	NewEntry.NextDecisionTime = WorldTime + FMath::FRand()*FMath::Max(Manager->GetNextDecisionDelay(),0.0f);
+
+	RegisteredManagers.Add(NewEntry);
+}
+
+void UUtilityAIDecisionSubsystem::UnregisterManager(UUtilityAIManagerComponent* Manager)
+{
+	for(int32 Index = 0; Index < RegisteredManagers.Num(); Index++)
+	{
+		if(RegisteredManagers[Index].Manager.Get() != Manager)
+		{
+			continue;
+		}
+
+		if(bIsRunningDecisions)
+		{
+			RegisteredManagers[Index].Manager = nullptr; //Removed at the start of the next tick
+		}
+		else
+		{
+			RegisteredManagers.RemoveAtSwap(Index);
+		}
+		return;
+	}
+}
+
+void UUtilityAIDecisionSubsystem::GetRegisteredManagers(TArray<UUtilityAIManagerComponent*>& OutManagers) const
+{
+	OutManagers.Reset(RegisteredManagers.Num());
+	for(const FUtilityScheduledManager& Entry : RegisteredManagers)
+	{
+		if(UUtilityAIManagerComponent* Manager = Entry.Manager.Get())
+		{
+			OutManagers.Add(Manager);
+		}
+	}
+}
+
+int32 UUtilityAIDecisionSubsystem::GetScheduledManagerCount() const
+{
+	int32 Count = 0;
+	for(const FUtilityScheduledManager& Entry : RegisteredManagers)
+	{
+		const UUtilityAIManagerComponent* Manager = Entry.Manager.Get();
+		if(Manager && Manager->bUseDecisionScheduler)
+		{
+			Count++;
+		}
+	}
+	return Count;
+}
+
+void UUtilityAIDecisionSubsystem::DumpTopAgents(int32 Count, float Seconds) const
+{
+	struct FCostEntry
+	{
+		const UUtilityAIManagerComponent* Manager = nullptr;
+		int32 TaskIndex = INDEX_NONE;
+		float CostSeconds = 0.0f;
+		int32 Traces = 0;
+		int32 BlueprintCalls = 0;
+	};
+
+	const UWorld* World = GetWorld();
+	const double WorldTime = World ? World->GetTimeSeconds() : 0.0;
+
+	TArray<FCostEntry> Agents;
+	TArray<FCostEntry> Tasks;
+
+	for(const FUtilityScheduledManager& Entry : RegisteredManagers)
+	{
+		const UUtilityAIManagerComponent* Manager = Entry.Manager.Get();
+		if(!Manager)
+		{
+			continue;
+		}
+
+		FCostEntry Agent;
+		Agent.Manager = Manager;
+		Manager->CostHistory.Sum(WorldTime,Seconds,Agent.CostSeconds,Agent.Traces,Agent.BlueprintCalls);
+		Agents.Add(Agent);
+
+		for(int32 TaskIndex = 0; TaskIndex < Manager->TaskCostHistories.Num(); TaskIndex++)
+		{
+			FCostEntry Task;
+			Task.Manager = Manager;
+			Task.TaskIndex = TaskIndex;
+			Manager->TaskCostHistories[TaskIndex].Sum(WorldTime,Seconds,Task.CostSeconds,Task.Traces,Task.BlueprintCalls);
+			if(Task.CostSeconds > 0.0f || Task.BlueprintCalls > 0)
+			{
+				Tasks.Add(Task);
+			}
+		}
+	}
+
+	const auto ByCost = [](const FCostEntry& A, const FCostEntry& B){ return A.CostSeconds > B.CostSeconds; };
+	Agents.Sort(ByCost);
+	Tasks.Sort(ByCost);
+
+	UE_LOG(LogTemp,Display,TEXT("UtilityAI: top %d of %d agents over the last %.0f seconds"),FMath::Min(Count,Agents.Num()),Agents.Num(),Seconds);
+	for(int32 Index = 0; Index < Agents.Num() && Index < Count; Index++)
+	{
+		const FCostEntry& Agent = Agents[Index];
+		const AActor* Owner = Agent.Manager->GetOwner();
+		UE_LOG(LogTemp,Display,TEXT("  %2d. %-40s %8.3f ms  %6d traces  %6d BP calls  LOD %d"),
+			Index + 1,Owner ? *Owner->GetName() : TEXT("None"),Agent.CostSeconds*1000.0f,Agent.Traces,Agent.BlueprintCalls,Agent.Manager->CurrentDecisionLOD);
+	}
+
+	UE_LOG(LogTemp,Display,TEXT("UtilityAI: top %d of %d tasks over the last %.0f seconds (Blueprint scoring, EnterTask and ExitTask)"),FMath::Min(Count,Tasks.Num()),Tasks.Num(),Seconds);
+	for(int32 Index = 0; Index < Tasks.Num() && Index < Count; Index++)
+	{
+		const FCostEntry& Task = Tasks[Index];
+		const FName TaskName = Task.TaskIndex < Task.Manager->GetNumTasks() ? Task.Manager->GetTaskName(Task.TaskIndex) : NAME_None;
+		const AActor* Owner = Task.Manager->GetOwner();
+		UE_LOG(LogTemp,Display,TEXT("  %2d. %-30s on %-30s %8.3f ms  %6d BP calls"),
+			Index + 1,*TaskName.ToString(),Owner ? *Owner->GetName() : TEXT("None"),Task.CostSeconds*1000.0f,Task.BlueprintCalls);
+	}
+}
+
+const TArray<FVector>& UUtilityAIDecisionSubsystem::GetPlayerPawnLocations()
+{
+	if(PlayerPawnLocationsFrame == GFrameCounter && GFrameCounter != 0)
+	{
+		return PlayerPawnLocations;
+	}
+
+	PlayerPawnLocationsFrame = GFrameCounter;
+	PlayerPawnLocations.Reset();
+
+	if(UWorld* World = GetWorld())
+	{
+		for(FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+		{
+			const APlayerController* PlayerController = Iterator->Get();
+			const APawn* PlayerPawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+			if(PlayerPawn)
+			{
+				PlayerPawnLocations.Add(PlayerPawn->GetActorLocation());
+			}
+		}
+	}
+
+	return PlayerPawnLocations;
+}
+
+const FUtilityFocusFacts& UUtilityAIDecisionSubsystem::GetFocusFacts(AActor* Focus, bool& bOutGathered)
+{
+	static const FUtilityFocusFacts NoFocusFacts;
+
+	bOutGathered = false;
+	if(!Focus)
+	{
+		return NoFocusFacts;
+	}
+
+	FUtilityFocusFacts& Facts = FocusFacts.FindOrAdd(Focus);
+	if(Facts.Frame == GFrameCounter && GFrameCounter != 0)
+	{
+		return Facts;
+	}
+
+	bOutGathered = true;
+	GatherFocusFacts(Focus,Facts);
+	return Facts;
+}
+
+void UUtilityAIDecisionSubsystem::InvalidateFocusFacts(AActor* Focus)
+{
+	if(FUtilityFocusFacts* Facts = FocusFacts.Find(Focus))
+	{
+		Facts->Frame = 0;
+	}
+}
+
+void UUtilityAIDecisionSubsystem::GatherFocusFacts(AActor* Focus, FUtilityFocusFacts& OutFacts)
+{
+	OutFacts.Frame = GFrameCounter;
+	if(!Focus)
+	{
+		OutFacts = FUtilityFocusFacts();
+		return;
+	}
+
+	OutFacts.Location = Focus->GetActorLocation();
+	OutFacts.Velocity = Focus->GetVelocity();
+	OutFacts.bImplementsInterface = Focus->GetClass()->ImplementsInterface(UUtilityAIManagerToPawnInterface::StaticClass());
+
+	if(OutFacts.bImplementsInterface)
+	{
+		OutFacts.bIsMeleeAttacking = IUtilityAIManagerToPawnInterface::Execute_IsFocusMeleeAttack(Focus);
+		OutFacts.bIsRangeAttacking = IUtilityAIManagerToPawnInterface::Execute_IsFocusRangeAttack(Focus);
+	}
+	else
+	{
+		OutFacts.bIsMeleeAttacking = false;
+		OutFacts.bIsRangeAttacking = false;
+	}
+}
+
+float UUtilityAIDecisionSubsystem::GetDecisionPriority(const FUtilityScheduledManager& Entry, const UUtilityAIManagerComponent* Manager, double WorldTime) const
+{
+	//How long we have been overdue. Deferred managers keep getting older, which makes this round-robin.
+	float Priority = static_cast<float>(WorldTime - Entry.NextDecisionTime);
+
+	if(Manager->ControllerFocus)
+	{
+		Priority += GUtilityAIFocusPriorityBoost;
+	}
+
+	return Priority;
+}
+
+void UUtilityAIDecisionSubsystem::RunDecisionBatch()
+{
+	//Same as calling DetermineBestTask() on each manager, but the pure math in the middle runs on worker threads.
+
+	//1. Snapshot. Game thread, this is where all the UObject reads happen.
+	for(UUtilityAIManagerComponent* Manager : DecisionBatch)
+	{
+		Manager->AnteScoreCalculations();
+		Manager->CaptureDecisionSnapshot();
+	}
+
+	//2. Score. Each manager only touches itself and its own tasks.
+	if(GUtilityAIParallelScoring && DecisionBatch.Num() > 1)
+	{
+		ParallelFor(DecisionBatch.Num(),[this](int32 Index)
+		{
+			DecisionBatch[Index]->ScoreTasksFromSnapshot();
+		});
+	}
+	else
+	{
+		for(UUtilityAIManagerComponent* Manager : DecisionBatch)
+		{
+			Manager->ScoreTasksFromSnapshot();
+		}
+	}
+
+	//3. Apply. Game thread, EnterTask()/ExitTask() and the delegates can run Blueprint.
+	for(UUtilityAIManagerComponent* Manager : DecisionBatch)
+	{
+		if(IsValid(Manager))
+		{
+			Manager->ApplyBestTasks();
+		}
+	}
+}
+
+void UUtilityAIDecisionSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_UtilityAI_SchedulerTick);
+
+	UWorld* World = GetWorld();
+	if(!World)
+	{
+		return;
+	}
+
+	const double WorldTime = World->GetTimeSeconds();
+
+	//Clean up managers that were destroyed or unregistered during the last tick.
+	RegisteredManagers.RemoveAllSwap([](const FUtilityScheduledManager& Entry){ return !Entry.Manager.IsValid(); }, false);
+	for(auto It = FocusFacts.CreateIterator(); It; ++It)
+	{
+		if(!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	//1. Find every scheduled manager that is due.
+	//2. Sort them by priority.
+	//3. Run decisions until the budget is used up. Everyone else waits for next frame.
+
+	DueQueue.Reset();
+	int32 EventDecisions = 0;
+	for(int32 Index = 0; Index < RegisteredManagers.Num(); Index++)
+	{
+		const FUtilityScheduledManager& Entry = RegisteredManagers[Index];
+		const UUtilityAIManagerComponent* Manager = Entry.Manager.Get();
+
+		if(!Manager->bUseDecisionScheduler)
+		{
+			continue;
+		}
+
+		//Event driven managers are due early when something happened. NextDecisionTime is only their heartbeat.
+		const bool bHasEvent = Manager->bUseEventDrivenDecisions && Manager->HasDecisionEvent(WorldTime);
+		if(!bHasEvent && WorldTime < Entry.NextDecisionTime)
+		{
+			continue;
+		}
+
+		FUtilityDueManager Due;
+		Due.RegisteredIndex = Index;
+		Due.Priority = GetDecisionPriority(Entry,Manager,WorldTime);
+		if(bHasEvent)
+		{
+			Due.Priority = FMath::Max(Due.Priority,0.0f); //As urgent as a manager that just came due
+			EventDecisions++;
+		}
+		DueQueue.Add(Due);
+	}
+
+	DueQueue.Sort([](const FUtilityDueManager& A, const FUtilityDueManager& B)
+	{
+		return A.Priority > B.Priority;
+	});
+
+	const double BudgetSeconds = FMath::Max(GUtilityAIDecisionBudgetMs,0.0f)/1000.0;
+	const double StartTime = FPlatformTime::Seconds();
+	int32 DecisionsRun = 0;
+	int32 QueuePosition = 0;
+	const int32 BatchSize = FMath::Max(GUtilityAIDecisionBatchSize,1);
+
+	bIsRunningDecisions = true;
+
+	while(QueuePosition < DueQueue.Num())
+	{
+		if(DecisionsRun >= GUtilityAIMinDecisionsPerFrame && FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+		{
+			break;
+		}
+
+		DecisionBatch.Reset();
+		while(QueuePosition < DueQueue.Num() && DecisionBatch.Num() < BatchSize)
+		{
+			//Index, not a reference. Blueprint called during a decision can spawn and register new managers.
+			const int32 RegisteredIndex = DueQueue[QueuePosition].RegisteredIndex;
+			QueuePosition++;
+
+			UUtilityAIManagerComponent* Manager = RegisteredManagers[RegisteredIndex].Manager.Get();
+			if(!Manager)
+			{
+				continue; //Unregistered by an earlier decision this frame
+			}
+
+			//LOD from the last decision. This decision may change it, which takes effect on the one after.
+			RegisteredManagers[RegisteredIndex].NextDecisionTime = WorldTime + FMath::Max(Manager->GetNextDecisionDelay(),0.0f);
+			RegisteredManagers[RegisteredIndex].FramesDeferred = 0;
+			DecisionBatch.Add(Manager);
+		}
+
+		RunDecisionBatch();
+		DecisionsRun += DecisionBatch.Num();
+	}
+
+	bIsRunningDecisions = false;
+
+	const double TimeUsedMs = (FPlatformTime::Seconds() - StartTime)*1000.0;
+
+	for(int32 Index = QueuePosition; Index < DueQueue.Num(); Index++)
+	{
+		RegisteredManagers[DueQueue[Index].RegisteredIndex].FramesDeferred++;
+	}
+
+	LastQueueDepth = DueQueue.Num();
+	LastDeferredCount = DueQueue.Num() - QueuePosition;
+
+	SET_FLOAT_STAT(STAT_UtilityAI_DecisionBudgetMs, GUtilityAIDecisionBudgetMs);
+	SET_FLOAT_STAT(STAT_UtilityAI_DecisionTimeUsedMs, TimeUsedMs);
+	SET_DWORD_STAT(STAT_UtilityAI_RegisteredManagers, RegisteredManagers.Num());
+	SET_DWORD_STAT(STAT_UtilityAI_QueueDepth, LastQueueDepth);
+	SET_DWORD_STAT(STAT_UtilityAI_DecisionsRun, DecisionsRun);
+	SET_DWORD_STAT(STAT_UtilityAI_DecisionsDeferred, LastDeferredCount);
+	SET_DWORD_STAT(STAT_UtilityAI_EventDecisions, EventDecisions);
+
+	CSV_CUSTOM_STAT(UtilityAI, DecisionBudgetMs, GUtilityAIDecisionBudgetMs, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, DecisionTimeUsedMs, static_cast<float>(TimeUsedMs), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, QueueDepth, LastQueueDepth, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, DecisionsRun, DecisionsRun, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, DecisionsDeferred, LastDeferredCount, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(UtilityAI, EventDecisions, EventDecisions, ECsvCustomStatOp::Set);
+}
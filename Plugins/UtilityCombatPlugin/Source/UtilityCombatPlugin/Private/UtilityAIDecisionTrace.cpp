@@ -0,0 +1,267 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAIDecisionTrace.h"
+#include "UtilityAIManagerComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "Serialization/NameAsStringProxyArchive.h"
+#include "UObject/UObjectIterator.h"
+
+static void UtilityAIStartDecisionTraces(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 Capacity = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+
+	int32 Started = 0;
+	for(TObjectIterator<UUtilityAIManagerComponent> It; It; ++It)
+	{
+		if(It->GetWorld() == World && !It->IsTemplate())
+		{
+			It->StartDecisionTrace(Capacity);
+			Started++;
+		}
+	}
+	UE_LOG(LogTemp, Display, TEXT("UtilityAI.Trace.Start: Recording %d agents."), Started);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdUtilityAIStartDecisionTraces(
+	TEXT("UtilityAI.Trace.Start"),
+	TEXT("UtilityAI.Trace.Start [Capacity]. Every utility AI agent starts recording its last Capacity decisions. Default is each manager's DecisionTraceCapacity."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&UtilityAIStartDecisionTraces));
+
+static void UtilityAIStopDecisionTraces(const TArray<FString>& Args, UWorld* World)
+{
+	for(TObjectIterator<UUtilityAIManagerComponent> It; It; ++It)
+	{
+		if(It->GetWorld() == World && !It->IsTemplate())
+		{
+			It->StopDecisionTrace();
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdUtilityAIStopDecisionTraces(
+	TEXT("UtilityAI.Trace.Stop"),
+	TEXT("UtilityAI.Trace.Stop. Every utility AI agent stops recording and frees its trace."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&UtilityAIStopDecisionTraces));
+
+static void UtilityAIDumpDecisionTraces(const TArray<FString>& Args, UWorld* World)
+{
+	const FString Directory = Args.Num() > 0 ? Args[0] : FPaths::ProjectSavedDir() / TEXT("UtilityAITraces") / FDateTime::Now().ToString();
+
+	int32 Dumped = 0;
+	for(TObjectIterator<UUtilityAIManagerComponent> It; It; ++It)
+	{
+		if(It->GetWorld() != World || It->IsTemplate() || !It->bRecordDecisionTrace)
+		{
+			continue;
+		}
+
+		const AActor* Owner = It->GetOwner();
+		const FString Filename = Directory / FString::Printf(TEXT("%s.uadt"), Owner ? *Owner->GetName() : *It->GetName());
+		if(It->DumpDecisionTrace(Filename))
+		{
+			Dumped++;
+		}
+	}
+	UE_LOG(LogTemp, Display, TEXT("UtilityAI.Trace.Dump: Wrote %d traces to %s. View them with -run=UtilityAIDecisionTraceView -File=<trace>."), Dumped, *Directory);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdUtilityAIDumpDecisionTraces(
+	TEXT("UtilityAI.Trace.Dump"),
+	TEXT("UtilityAI.Trace.Dump [Directory]. Writes the trace of every recording utility AI agent to Directory/<Controller>.uadt. Default is Saved/UtilityAITraces/<time>."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&UtilityAIDumpDecisionTraces));
+
+
+int32 FUtilityDecisionTraceLayout::GetRecordSize() const
+{
+	return sizeof(double) + sizeof(uint64)
+		+ NumConsiderations*2*sizeof(float)
+		+ TaskNames.Num()*sizeof(float)
+		+ Layers.Num()*2*sizeof(int16);
+}
+
+void FUtilityDecisionTraceLayout::Serialize(FArchive& Ar)
+{
+	Ar << AgentName;
+	Ar << TaskNames;
+	Ar << TaskLayerIndices;
+	Ar << TaskFirstConsideration;
+	Ar << TaskConsiderationCount;
+	Ar << InputQueries;
+	Ar << StatIndices;
+	Ar << StatNames;
+	Ar << Layers;
+	Ar << NumConsiderations;
+}
+
+bool FUtilityDecisionTraceRecorder::Start(const FUtilityDecisionTraceLayout& InLayout, int32 InCapacity)
+{
+	if(InLayout.TaskNames.Num() > MAX_int16)
+	{
+		Stop();
+		return false;
+	}
+
+	Layout = InLayout;
+	Capacity = FMath::Max(InCapacity,1);
+	Head = 0;
+	NumRecords = 0;
+	Buffer.SetNumUninitialized(Capacity*Layout.GetRecordSize());
+	return true;
+}
+
+void FUtilityDecisionTraceRecorder::Stop()
+{
+	Buffer.Empty();
+	Capacity = 0;
+	Head = 0;
+	NumRecords = 0;
+}
+
+void FUtilityDecisionTraceRecorder::Record(double WorldTime, uint64 Frame, const float* Inputs, const float* Outputs, const float* TaskScores, const int32* BestTaskIndices, const int32* CurrentTaskIndices)
+{
+	if(Capacity <= 0)
+	{
+		return;
+	}
+
+	uint8* Write = Buffer.GetData() + Head*Layout.GetRecordSize();
+
+	FMemory::Memcpy(Write, &WorldTime, sizeof(double));
+	Write += sizeof(double);
+	FMemory::Memcpy(Write, &Frame, sizeof(uint64));
+	Write += sizeof(uint64);
+
+	const int32 ConsiderationBytes = Layout.NumConsiderations*sizeof(float);
+	FMemory::Memcpy(Write, Inputs, ConsiderationBytes);
+	Write += ConsiderationBytes;
+	FMemory::Memcpy(Write, Outputs, ConsiderationBytes);
+	Write += ConsiderationBytes;
+
+	const int32 ScoreBytes = Layout.TaskNames.Num()*sizeof(float);
+	FMemory::Memcpy(Write, TaskScores, ScoreBytes);
+	Write += ScoreBytes;
+
+	//Task indices fit in 16 bits, Start() refuses layouts with more tasks.
+	for(int32 LayerIndex = 0; LayerIndex < Layout.Layers.Num(); LayerIndex++)
+	{
+		const int16 BestTaskIndex = static_cast<int16>(BestTaskIndices[LayerIndex]);
+		FMemory::Memcpy(Write, &BestTaskIndex, sizeof(int16));
+		Write += sizeof(int16);
+	}
+	for(int32 LayerIndex = 0; LayerIndex < Layout.Layers.Num(); LayerIndex++)
+	{
+		const int16 CurrentTaskIndex = static_cast<int16>(CurrentTaskIndices[LayerIndex]);
+		FMemory::Memcpy(Write, &CurrentTaskIndex, sizeof(int16));
+		Write += sizeof(int16);
+	}
+
+	Head = (Head + 1) % Capacity;
+	NumRecords = FMath::Min(NumRecords + 1, Capacity);
+}
+
+bool FUtilityDecisionTraceRecorder::SaveToFile(const FString& Filename) const
+{
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileWriter(*Filename));
+	if(!Ar)
+	{
+		return false;
+	}
+
+	uint32 Magic = FUtilityDecisionTraceFile::Magic;
+	uint32 Version = FUtilityDecisionTraceFile::Version;
+	*Ar << Magic;
+	*Ar << Version;
+
+	//A plain file archive can't write FNames on its own.
+	FNameAsStringProxyArchive NameAr(*Ar);
+	FUtilityDecisionTraceLayout LayoutCopy = Layout;
+	LayoutCopy.Serialize(NameAr);
+
+	int32 RecordCount = NumRecords;
+	*Ar << RecordCount;
+
+	//Oldest first. Once the buffer has wrapped, the oldest is the one Head is about to overwrite.
+	const int32 RecordSize = Layout.GetRecordSize();
+	const int32 Oldest = NumRecords < Capacity ? 0 : Head;
+	for(int32 Index = 0; Index < NumRecords; Index++)
+	{
+		const int32 RecordIndex = (Oldest + Index) % Capacity;
+		Ar->Serialize(const_cast<uint8*>(Buffer.GetData()) + RecordIndex*RecordSize, RecordSize);
+	}
+
+	return Ar->Close();
+}
+
+bool FUtilityDecisionTraceFile::LoadFromFile(const FString& Filename)
+{
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileReader(*Filename));
+	if(!Ar)
+	{
+		return false;
+	}
+
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	*Ar << FileMagic;
+	*Ar << FileVersion;
+	if(FileMagic != Magic || FileVersion != Version)
+	{
+		return false;
+	}
+
+	FNameAsStringProxyArchive NameAr(*Ar);
+	Layout.Serialize(NameAr);
+	*Ar << NumRecords;
+
+	const int64 RecordBytes = static_cast<int64>(NumRecords)*Layout.GetRecordSize();
+	if(Ar->IsError() || NumRecords < 0 || RecordBytes > Ar->TotalSize() - Ar->Tell())
+	{
+		return false;
+	}
+
+	Records.SetNumUninitialized(RecordBytes);
+	Ar->Serialize(Records.GetData(), RecordBytes);
+	return !Ar->IsError();
+}
+
+double FUtilityDecisionTraceFile::GetWorldTime(int32 RecordIndex) const
+{
+	return ReadValue<double>(RecordIndex, 0);
+}
+
+uint64 FUtilityDecisionTraceFile::GetFrame(int32 RecordIndex) const
+{
+	return ReadValue<uint64>(RecordIndex, sizeof(double));
+}
+
+float FUtilityDecisionTraceFile::GetInput(int32 RecordIndex, int32 ConsiderationIndex) const
+{
+	return ReadValue<float>(RecordIndex, sizeof(double) + sizeof(uint64) + ConsiderationIndex*sizeof(float));
+}
+
+float FUtilityDecisionTraceFile::GetOutput(int32 RecordIndex, int32 ConsiderationIndex) const
+{
+	return ReadValue<float>(RecordIndex, sizeof(double) + sizeof(uint64) + (Layout.NumConsiderations + ConsiderationIndex)*sizeof(float));
+}
+
+float FUtilityDecisionTraceFile::GetTaskScore(int32 RecordIndex, int32 TaskIndex) const
+{
+	return ReadValue<float>(RecordIndex, sizeof(double) + sizeof(uint64) + (Layout.NumConsiderations*2 + TaskIndex)*sizeof(float));
+}
+
+int32 FUtilityDecisionTraceFile::GetBestTaskIndex(int32 RecordIndex, int32 LayerIndex) const
+{
+	const int32 LayersOffset = sizeof(double) + sizeof(uint64) + (Layout.NumConsiderations*2 + Layout.TaskNames.Num())*sizeof(float);
+	return ReadValue<int16>(RecordIndex, LayersOffset + LayerIndex*sizeof(int16));
+}
+
+int32 FUtilityDecisionTraceFile::GetCurrentTaskIndex(int32 RecordIndex, int32 LayerIndex) const
+{
+	const int32 LayersOffset = sizeof(double) + sizeof(uint64) + (Layout.NumConsiderations*2 + Layout.TaskNames.Num())*sizeof(float);
+	return ReadValue<int16>(RecordIndex, LayersOffset + (Layout.Layers.Num() + LayerIndex)*sizeof(int16));
+}
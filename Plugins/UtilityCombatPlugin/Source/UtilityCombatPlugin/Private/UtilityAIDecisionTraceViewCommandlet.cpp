@@ -0,0 +1,126 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityAIDecisionTraceViewCommandlet.h"
+#include "UtilityAIDecisionTrace.h"
+#include "UtilityCombatDataStructures.h"
+#include "Misc/FileHelper.h"
+
+UUtilityAIDecisionTraceViewCommandlet::UUtilityAIDecisionTraceViewCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UUtilityAIDecisionTraceViewCommandlet::Main(const FString& Params)
+{
+	FString Filename;
+	if(!FParse::Value(*Params, TEXT("File="), Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAIDecisionTraceView: -File=Path/To/Trace.uadt is required."));
+		return 1;
+	}
+
+	FUtilityDecisionTraceFile Trace;
+	if(!Trace.LoadFromFile(Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAIDecisionTraceView: %s isn't a decision trace, or is from another version."), *Filename);
+		return 1;
+	}
+
+	int32 Last = 20;
+	FParse::Value(*Params, TEXT("Last="), Last);
+
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIDecisionTraceView: %s, %d decisions, %d tasks, %d considerations, %d layers."),
+		*Trace.Layout.AgentName, Trace.NumRecords, Trace.Layout.TaskNames.Num(), Trace.Layout.NumConsiderations, Trace.Layout.Layers.Num());
+
+	for(int32 RecordIndex = FMath::Max(Trace.NumRecords - Last,0); RecordIndex < Trace.NumRecords; RecordIndex++)
+	{
+		PrintRecord(Trace, RecordIndex);
+	}
+
+	FString CsvPath;
+	if(FParse::Value(*Params, TEXT("Csv="), CsvPath) && !WriteCsv(Trace, CsvPath))
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+void UUtilityAIDecisionTraceViewCommandlet::PrintRecord(const FUtilityDecisionTraceFile& Trace, int32 RecordIndex) const
+{
+	const FUtilityDecisionTraceLayout& Layout = Trace.Layout;
+
+	FString Picked;
+	for(int32 LayerIndex = 0; LayerIndex < Layout.Layers.Num(); LayerIndex++)
+	{
+		Picked += FString::Printf(TEXT(" [Layer %d: best %s, running %s]"), Layout.Layers[LayerIndex],
+			*GetTaskName(Trace, Trace.GetBestTaskIndex(RecordIndex, LayerIndex)),
+			*GetTaskName(Trace, Trace.GetCurrentTaskIndex(RecordIndex, LayerIndex)));
+	}
+	UE_LOG(LogTemp, Display, TEXT("#%d Time %.3f Frame %llu%s"), RecordIndex, Trace.GetWorldTime(RecordIndex), Trace.GetFrame(RecordIndex), *Picked);
+
+	for(int32 TaskIndex = 0; TaskIndex < Layout.TaskNames.Num(); TaskIndex++)
+	{
+		FString Considerations;
+		const int32 First = Layout.TaskFirstConsideration[TaskIndex];
+		for(int32 Index = First; Index < First + Layout.TaskConsiderationCount[TaskIndex]; Index++)
+		{
+			Considerations += FString::Printf(TEXT(" %s %.3f->%.3f"), *GetInputName(Trace, Index), Trace.GetInput(RecordIndex, Index), Trace.GetOutput(RecordIndex, Index));
+		}
+		UE_LOG(LogTemp, Display, TEXT("    %-24s %.3f |%s"), *GetTaskName(Trace, TaskIndex), Trace.GetTaskScore(RecordIndex, TaskIndex), *Considerations);
+	}
+}
+
+bool UUtilityAIDecisionTraceViewCommandlet::WriteCsv(const FUtilityDecisionTraceFile& Trace, const FString& CsvPath) const
+{
+	const FUtilityDecisionTraceLayout& Layout = Trace.Layout;
+
+	FString Csv = TEXT("record,world_time,frame,task,layer,task_score,is_best,is_running,consideration,input_query,input,output\n");
+	for(int32 RecordIndex = 0; RecordIndex < Trace.NumRecords; RecordIndex++)
+	{
+		for(int32 TaskIndex = 0; TaskIndex < Layout.TaskNames.Num(); TaskIndex++)
+		{
+			const int32 LayerIndex = Layout.TaskLayerIndices[TaskIndex];
+			const bool bIsBest = LayerIndex != INDEX_NONE && Trace.GetBestTaskIndex(RecordIndex, LayerIndex) == TaskIndex;
+			const bool bIsRunning = LayerIndex != INDEX_NONE && Trace.GetCurrentTaskIndex(RecordIndex, LayerIndex) == TaskIndex;
+			const FString TaskColumns = FString::Printf(TEXT("%d,%.6f,%llu,%s,%d,%.6f,%d,%d"),
+				RecordIndex, Trace.GetWorldTime(RecordIndex), Trace.GetFrame(RecordIndex), *GetTaskName(Trace, TaskIndex),
+				LayerIndex != INDEX_NONE ? Layout.Layers[LayerIndex] : INDEX_NONE, Trace.GetTaskScore(RecordIndex, TaskIndex), bIsBest ? 1 : 0, bIsRunning ? 1 : 0);
+
+			const int32 First = Layout.TaskFirstConsideration[TaskIndex];
+			for(int32 Index = First; Index < First + Layout.TaskConsiderationCount[TaskIndex]; Index++)
+			{
+				Csv += FString::Printf(TEXT("%s,%d,%s,%.6f,%.6f\n"), *TaskColumns, Index - First, *GetInputName(Trace, Index), Trace.GetInput(RecordIndex, Index), Trace.GetOutput(RecordIndex, Index));
+			}
+		}
+	}
+
+	if(!FFileHelper::SaveStringToFile(Csv, *CsvPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("UtilityAIDecisionTraceView: Couldn't write %s."), *CsvPath);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("UtilityAIDecisionTraceView: Wrote %s."), *CsvPath);
+	return true;
+}
+
+FString UUtilityAIDecisionTraceViewCommandlet::GetTaskName(const FUtilityDecisionTraceFile& Trace, int32 TaskIndex) const
+{
+	return Trace.Layout.TaskNames.IsValidIndex(TaskIndex) ? Trace.Layout.TaskNames[TaskIndex].ToString() : TEXT("None");
+}
+
+FString UUtilityAIDecisionTraceViewCommandlet::GetInputName(const FUtilityDecisionTraceFile& Trace, int32 ConsiderationIndex) const
+{
+	const FUtilityDecisionTraceLayout& Layout = Trace.Layout;
+	const int32 StatIndex = Layout.StatIndices[ConsiderationIndex];
+	if(Layout.StatNames.IsValidIndex(StatIndex))
+	{
+		return Layout.StatNames[StatIndex].ToString();
+	}
+	return StaticEnum<ECurveInputQuery>()->GetNameStringByValue(Layout.InputQueries[ConsiderationIndex]);
+}
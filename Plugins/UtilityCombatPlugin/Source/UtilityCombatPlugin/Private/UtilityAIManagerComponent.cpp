@@ -5,12 +5,34 @@
 #include "AIController.h"
 #include "GenericPlatform/GenericPlatformMath.h"
 #include "UtilityCombatTaskComponent.h"
+#include "UtilityNativeTaskComponent.h"
+#include "UtilityTaskDefinition.h"
 #include "Math/UnrealMathUtility.h"
 #include "GameFramework/Pawn.h"
 #include "Runtime/Engine/Public/DrawDebugHelpers.h"
 #include "GameFramework/PawnMovementComponent.h"	
 #include "GameFramework/CharacterMovementComponent.h"
 #include "UtilityAIManagerToPawnInterface.h"
+#include "StatManager.h"
+#include "UtilityAIDecisionSubsystem.h"
+#include "UtilityAICoverSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "UtilityAIStats.h"
+#include "Algo/StableSort.h"
+
+static int32 GUtilityAISIMDScoring = 1;
+static FAutoConsoleVariableRef CVarUtilityAISIMDScoring(
+	TEXT("UtilityAI.Scoring.SIMD"),
+	GUtilityAISIMDScoring,
+	TEXT("1 = evaluate task curves 4 at a time with SIMD. 0 = one at a time."),
+	ECVF_Default);
+
+static int32 GUtilityAITaskCostHistory = 0;
+static FAutoConsoleVariableRef CVarUtilityAITaskCostHistory(
+	TEXT("UtilityAI.Profiling.TaskCostHistory"),
+	GUtilityAITaskCostHistory,
+	TEXT("1 = managers also keep a cost history per task, for the task list of UtilityAI.DumpTopAgents. 0 = per agent only."),
+	ECVF_Default);
 
 // Sets default values for this component's properties
 UUtilityAIManagerComponent::UUtilityAIManagerComponent()
@@ -19,7 +41,9 @@ UUtilityAIManagerComponent::UUtilityAIManagerComponent()
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = false;
 
-
+	DecisionLODTiers.Add(FUtilityDecisionLODTier(3000.0f,0.25f,true,0.0f));
+	DecisionLODTiers.Add(FUtilityDecisionLODTier(8000.0f,1.0f,true,45.0f));
+	DecisionLODTiers.Add(FUtilityDecisionLODTier(20000.0f,3.0f,false,0.0f));
 
 
 	// ...
@@ -35,6 +59,41 @@ void UUtilityAIManagerComponent::BeginPlay()
 	
 }
 
+void UUtilityAIManagerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if(UWorld* World = GetWorld())
+	{
+		if(UUtilityAIDecisionSubsystem* DecisionSubsystem = World->GetSubsystem<UUtilityAIDecisionSubsystem>())
+		{
+			DecisionSubsystem->UnregisterManager(this);
+		}
+	}
+	ReleaseCover();
+	UnbindDecisionEvents();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+#if WITH_EDITOR
+void UUtilityAIManagerComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	//Ticked in the details panel while playing. Decisions don't start the trace themselves.
+	if(PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(UUtilityAIManagerComponent,bRecordDecisionTrace) && HasBegunPlay())
+	{
+		if(bRecordDecisionTrace)
+		{
+			StartDecisionTrace();
+		}
+		else
+		{
+			StopDecisionTrace();
+		}
+	}
+}
+#endif
+
 
 // Called every frame
 void UUtilityAIManagerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -57,22 +116,177 @@ void UUtilityAIManagerComponent::Initialize()
 
 	}
 
-	for( UUtilityCombatTaskComponent* UCTC : TaskArray)
+	//Task definitions take the task indices after the components, see GetTaskDefinition().
+	TArray<UUtilityTaskDefinition*> Definitions = {};
+	if(TaskArchetype)
+	{
+		for(UUtilityTaskDefinition* Definition : TaskArchetype->Tasks)
+		{
+			if(Definition)
+			{
+				Definitions.Add(Definition);
+			}
+		}
+	}
+
+	//Repossession keeps the cooldowns and running tasks, as it does for task components.
+	if(Definitions != TaskDefinitions)
+	{
+		TaskDefinitions = MoveTemp(Definitions);
+		TaskStates.Reset();
+		TaskStates.SetNum(TaskDefinitions.Num());
+		for(int32 DefinitionIndex = 0; DefinitionIndex < TaskDefinitions.Num(); DefinitionIndex++)
+		{
+			TaskStates[DefinitionIndex].CurrentCooldown = TaskDefinitions[DefinitionIndex]->Cooldown;
+		}
+	}
+
+	TaskScoredOnGameThread.Reset();
+	NativeScoreTasks.Reset();
+	TaskLayerIndices.Reset();
+
+	for(int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
 	{
+		UUtilityCombatTaskComponent* UCTC = GetTaskComponent(TaskIndex);
 		if(UCTC)
 		{
-			PossibleLayers.AddUnique(UCTC->TaskLayer);
+			UCTC->CacheBlueprintOverrides();
+		}
+		TaskScoredOnGameThread.Add(UCTC && UCTC->bCalculateTaskScoreOverridden);
+
+		const UUtilityNativeTaskComponent* NativeTask = Cast<UUtilityNativeTaskComponent>(UCTC);
+		NativeScoreTasks.Add(NativeTask && NativeTask->bOverridesNativeScore ? NativeTask : nullptr);
+
+		if(UCTC)
+		{
+			TaskLayerIndices.Add(PossibleLayers.AddUnique(UCTC->TaskLayer));
 			UCTC->OwnerController = OwnerController;
+			UCTC->CurrentManagerComponent = this;
+		}
+		else if(const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex))
+		{
+			TaskLayerIndices.Add(PossibleLayers.AddUnique(Definition->TaskLayer));
+		}
+		else
+		{
+			TaskLayerIndices.Add(INDEX_NONE);
 		}
 	
 	}
+
+	InitializeLayerBookkeeping();
+	ResolveStatProvider();
+	BindDecisionEvents();
+
+	TaskDecisionCosts.Init(0.0,GetNumTasks());
+	TaskDecisionBlueprintCalls.Init(0,GetNumTasks());
+	TaskCostHistories.Empty(); //Sized by RecordDecisionCost() if UtilityAI.Profiling.TaskCostHistory is on.
+
+	TaskScores.Init(0.0f,GetNumTasks());
+	CompileConsiderationTable();
+	InvalidateScoreCache();
+
+	//The layout of the trace records changed.
+	if(bRecordDecisionTrace)
+	{
+		StartDecisionTrace(DecisionTrace.Capacity);
+	}
 	
+	if(UWorld* World = GetWorld())
+	{
+		if(UUtilityAIDecisionSubsystem* DecisionSubsystem = World->GetSubsystem<UUtilityAIDecisionSubsystem>())
+		{
+			DecisionSubsystem->RegisterManager(this);
+		}
+
+		CoverSubsystem = World->GetSubsystem<UUtilityAICoverSubsystem>();
+		if(CoverSubsystem && CoverSearchMode == ECoverSearchMode::SPATIAL_INDEX)
+		{
+			CoverSubsystem->RequestCoverBake(ValidCoverPointTag);
+		}
+	}
 	
 
 }
 
+void UUtilityAIManagerComponent::CompileConsiderationTable()
+{
+	ConsiderationTable.Reset();
+
+	for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		const TArray<FUtilityCurveCollection>* Curves = GetTaskCurves(TaskIndex);
+
+		ConsiderationTable.TaskFirstConsideration.Add(ConsiderationTable.NumConsiderations);
+		int32 ConsiderationCount = 0;
+
+		if(Curves && TaskScoredOnGameThread[TaskIndex])
+		{
+			//Blueprint scores these itself, but its curves may still ask for stats through the snapshot.
+			for(const FUtilityCurveCollection& CurveCollection : *Curves)
+			{
+				if(CurveCollection.CurveInputQuery == ECurveInputQuery::STAT_BY_FNAME)
+				{
+					ConsiderationTable.StatNames.AddUnique(CurveCollection.StatName);
+				}
+			}
+		}
+		else if(Curves)
+		{
+			TArray<int32, TInlineAllocator<16>> CurveOrder = {};
+			bool bEveryCurveMultiplies = true;
+			for(int32 CurveIndex = 0; CurveIndex < Curves->Num(); CurveIndex++)
+			{
+				CurveOrder.Add(CurveIndex);
+				bEveryCurveMultiplies &= (*Curves)[CurveIndex].bMultiplyThisCurveOutputToRunningTotal;
+			}
+
+			//Multiplying is order independent, so the curves most likely to rule the task out go first for early exit.
+			//Adding isn't, so those tasks keep the order they were authored in.
+			if(bUseEarlyExitScoring && bEveryCurveMultiplies)
+			{
+				TArray<float, TInlineAllocator<16>> OrderKeys = {};
+				for(const FUtilityCurveCollection& CurveCollection : *Curves)
+				{
+					OrderKeys.Add(FUtilityConsiderationTable::GetEvaluationOrderKey(CurveCollection));
+				}
+
+				Algo::StableSort(CurveOrder,[&OrderKeys](int32 A, int32 B)
+				{
+					return OrderKeys[A] < OrderKeys[B];
+				});
+			}
+
+			for(const int32 CurveIndex : CurveOrder)
+			{
+				ConsiderationTable.AddConsideration((*Curves)[CurveIndex],CurveIndex);
+				ConsiderationCount++;
+			}
+		}
+
+		ConsiderationTable.TaskConsiderationCount.Add(ConsiderationCount);
+	}
+
+	ConsiderationTable.Finalize();
+
+	//ScoreNativeTask() can raise a score, so the bound early exit relies on doesn't hold.
+	for (int32 TaskIndex = 0; TaskIndex < NativeScoreTasks.Num(); TaskIndex++)
+	{
+		if(NativeScoreTasks[TaskIndex])
+		{
+			ConsiderationTable.TaskExitEarlyFlags[TaskIndex] = 0;
+		}
+	}
+
+	DecisionSnapshot.StatNames = ConsiderationTable.StatNames;
+	DecisionSnapshot.StatValues.SetNumZeroed(ConsiderationTable.StatNames.Num());
+}
+
 void UUtilityAIManagerComponent::AnteScoreCalculations()
 {
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_AnteScoreCalculations, AnteScoreCalculations);
+	FUtilityScopedCostTimer CostTimer(DecisionCostSeconds);
+
 	//Reset cover point variables
 	
 	
@@ -92,10 +306,13 @@ void UUtilityAIManagerComponent::AnteScoreCalculations()
 		
 		
 	}
+
+	UpdateDecisionLOD();
+	GatherFocusFacts();
 	
 	if(ControllerFocus && OwnerController)
 	{
-		FVector FocusLocation = ControllerFocus->GetActorLocation();
+		FVector FocusLocation = FocusFacts.Location;
 		DistanceToFocus = (OwnerLocation-FocusLocation).Size();
 
 
@@ -129,7 +346,7 @@ void UUtilityAIManagerComponent::AnteScoreCalculations()
 		bIsCrouched = CharMC->IsCrouching();
 	}
 
-	if(bCanFindCover)
+	if(CanFindCoverNow())
 	{
 		FindClosestCoverPoint();
 
@@ -166,33 +383,17 @@ void UUtilityAIManagerComponent::AnteScoreCalculations()
 	if(ControlledPawn && bImplementsInterface)
 	{	
 		bMeleeWeaponArmed = IUtilityAIManagerToPawnInterface::Execute_IsInMelee(ControlledPawn);
+		DecisionBlueprintCalls++;
 	}
 
-	bool bFocusImplementsInterface = false;
-	if(ControllerFocus)
+	if(ControllerFocus && bShowDebugWarnings && !FocusFacts.bImplementsInterface)
 	{
-		bFocusImplementsInterface = ControllerFocus->GetClass()->ImplementsInterface(UUtilityAIManagerToPawnInterface::StaticClass());
-		
-		if(bShowDebugWarnings && !bFocusImplementsInterface)
-		{
-			UE_LOG(LogTemp,Warning,TEXT("%s doesn't implement IUtilityAIManagerToPawnInterface interface "),*(ControllerFocus->GetFName().ToString() ) )
-		}
-		
+		UE_LOG(LogTemp,Warning,TEXT("%s doesn't implement IUtilityAIManagerToPawnInterface interface "),*(ControllerFocus->GetFName().ToString() ) )
 	}
 
-
-
-	
-	if(ControllerFocus && bFocusImplementsInterface)
-	{
-		bIsFocusMeleeAttacking = IUtilityAIManagerToPawnInterface::Execute_IsFocusMeleeAttack(ControllerFocus);
-		bIsFocusRangeAttacking = IUtilityAIManagerToPawnInterface::Execute_IsFocusRangeAttack(ControllerFocus);
-	}
-	else
-	{
-		bIsFocusMeleeAttacking = false;
-		bIsFocusRangeAttacking = false;
-	}
+	//Shared with every manager that has the same focus, see GatherFocusFacts().
+	bIsFocusMeleeAttacking = ControllerFocus && FocusFacts.bIsMeleeAttacking;
+	bIsFocusRangeAttacking = ControllerFocus && FocusFacts.bIsRangeAttacking;
 
 	if(bIsFocusMeleeAttacking || bIsFocusRangeAttacking)
 	{
@@ -207,175 +408,1115 @@ void UUtilityAIManagerComponent::AnteScoreCalculations()
 }
 
 
+void UUtilityAIManagerComponent::GatherFocusFacts()
+{
+	if(!ControllerFocus)
+	{
+		FocusFacts = FUtilityFocusFacts();
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	UUtilityAIDecisionSubsystem* DecisionSubsystem = World ? World->GetSubsystem<UUtilityAIDecisionSubsystem>() : nullptr;
+	if(!DecisionSubsystem)
+	{
+		UUtilityAIDecisionSubsystem::GatherFocusFacts(ControllerFocus,FocusFacts);
+		DecisionBlueprintCalls += FocusFacts.bImplementsInterface ? 2 : 0;
+		return;
+	}
+
+	bool bGathered = false;
+	FocusFacts = DecisionSubsystem->GetFocusFacts(ControllerFocus,bGathered);
+	if(bGathered && FocusFacts.bImplementsInterface)
+	{
+		DecisionBlueprintCalls += 2; //Only the first manager this frame pays for them.
+	}
+}
+
+void UUtilityAIManagerComponent::InitializeLayerBookkeeping()
+{
+	//Repossession keeps the tasks that are already running.
+	const int32 NumLayers = PossibleLayers.Num();
+	CurrentTaskIndices.Init(INDEX_NONE,NumLayers);
+	for(int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
+	{
+		if(UUtilityCombatTaskComponent* CurrentTask = CurrentTasks.FindRef(PossibleLayers[LayerIndex]))
+		{
+			CurrentTaskIndices[LayerIndex] = TaskArray.IndexOfByKey(CurrentTask);
+		}
+	}
+	for(int32 DefinitionIndex = 0; DefinitionIndex < TaskDefinitions.Num(); DefinitionIndex++)
+	{
+		if(TaskStates[DefinitionIndex].bIsTaskActive)
+		{
+			const int32 TaskIndex = TaskArray.Num() + DefinitionIndex;
+			CurrentTaskIndices[TaskLayerIndices[TaskIndex]] = TaskIndex;
+		}
+	}
+
+	BestTaskIndices.Init(INDEX_NONE,NumLayers);
+	BestLayerScores.Init(0.0f,NumLayers);
+	LayersToFill.Init(0,NumLayers);
+	CurrentTasks.Reserve(NumLayers);
+
+	//Size the scratch of ScoreNativeTasks() up front too.
+	TaskDirty.Init(false,GetNumTasks());
+
+	LastDecisionMemorySize = 0;
+}
+
 void UUtilityAIManagerComponent::ChangeToBestTasks(TMap<int32,UUtilityCombatTaskComponent*>& BestTasks )
 {
-	
-	TMap<int32,UUtilityCombatTaskComponent*> NewCurrentTasks = {};
-	NewCurrentTasks = CurrentTasks;
+	for(int32 LayerIndex = 0; LayerIndex < PossibleLayers.Num(); LayerIndex++)
+	{
+		//A missing or nullptr task means no best task on the layer. Task definitions can't be passed in here.
+		UUtilityCombatTaskComponent* BestTask = BestTasks.FindRef(PossibleLayers[LayerIndex]);
+		BestTaskIndices[LayerIndex] = BestTask ? TaskArray.IndexOfByKey(BestTask) : INDEX_NONE;
+	}
+
+	ApplyBestTasks();
+}
+
+void UUtilityAIManagerComponent::ApplyBestTasks()
+{
+	{
+		FUtilityScopedCostTimer CostTimer(DecisionCostSeconds);
+		ChangeTasksOnLayers();
+	}
+
+	CountDecisionContainerResizes();
+	RecordDecisionCost();
 
+	//Whatever asked for this decision got it.
+	bDecisionRequested = false;
+
+	//Kept up to date even when not event driven, so bUseEventDrivenDecisions can be switched on at runtime.
+	UpdateNextCooldownExpiry();
+
+	if(bRecordDecisionTrace)
+	{
+		RecordDecisionTrace();
+	}
+
+	if(bWriteDebugValuesEveryDecision)
+	{
+		WriteDebugValues();
+	}
+}
 
-	TArray<int32> EndOrInterruptTaskLayers = {};
+void UUtilityAIManagerComponent::ChangeTasksOnLayers()
+{
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_ChangeToBestTasks, ChangeToBestTasks);
 
 	/*
 	1. Determine if the Current task is can be interrupted or end 
 	2. Remember what layers we were able to end.
 	3. Remember tasks that we couldn't end
 	4. Begin all the tasks we can
-	5. Change CurrentTasks to NewCurrentTasks
+	5. Write the layers that changed back into CurrentTasks
 	*/
-	
-	
-	
 
-	for (int32 TaskLayer : PossibleLayers)
+	const int32 NumLayers = PossibleLayers.Num();
+
+	for (int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
 	{	
-		if(!CurrentTasks.Contains(TaskLayer))
+		LayersToFill[LayerIndex] = 0;
+
+		const int32 CurrentTaskIndex = CurrentTaskIndices[LayerIndex];
+		if(CurrentTaskIndex == INDEX_NONE)
 		{
-			EndOrInterruptTaskLayers.Add(TaskLayer);
+			LayersToFill[LayerIndex] = 1;
 			continue;
 		}
 		
-		if(BestTasks.Contains(TaskLayer))
+		const int32 BestTaskIndex = BestTaskIndices[LayerIndex];
+		if(BestTaskIndex == INDEX_NONE)
 		{
-			UUtilityCombatTaskComponent* CurrentTask = CurrentTasks[TaskLayer];
-			UUtilityCombatTaskComponent* BestTask = BestTasks[TaskLayer];
-
-			if(!CurrentTask)
+			//Finished with nothing to replace it. Exit it and free the layer, or HasDecisionEvent() would see it finish every frame.
+			if(HasTask(CurrentTaskIndex) && !IsTaskActive(CurrentTaskIndex))
+			{
+				ExitTaskAt(CurrentTaskIndex);
+				CurrentTaskIndices[LayerIndex] = INDEX_NONE;
+				CurrentTasks.Remove(PossibleLayers[LayerIndex]);
+			}
+		}
+		else
+		{
+			if(!HasTask(CurrentTaskIndex))
 			{
-				EndOrInterruptTaskLayers.Add(TaskLayer);
+				LayersToFill[LayerIndex] = 1;
 				continue;
 			}
 
 			//Clean up tasks that are done, or Interrupt and End tasks that we can end.
 
-			if(!CurrentTask->bIsTaskActive || (bAutoEndTasksIfTaskFallsBelowThreshold && CurrentTask->CalculateTaskScore(this) < TaskThreshold) && (!bOnlyAutoEndInterruptableTaskFallsBelowThreshold || CurrentTask->CanTaskBeInterrupted(BestTask) ) )
+			//Use the score from this decision instead of scoring the task again.
+			const float CurrentTaskScore = TaskScores[CurrentTaskIndex];
+
+			if(!IsTaskActive(CurrentTaskIndex) || (bAutoEndTasksIfTaskFallsBelowThreshold && CurrentTaskScore < TaskThreshold) && (!bOnlyAutoEndInterruptableTaskFallsBelowThreshold || CanTaskBeInterrupted(CurrentTaskIndex,BestTaskIndex) ) )
 			{
-				EndOrInterruptTaskLayers.Add(TaskLayer);
-				CurrentTask->ExitTask(); //Ensure clean up
-				OnAnyTaskExit.Broadcast(CurrentTask->TaskName);
+				LayersToFill[LayerIndex] = 1;
+				ExitTaskAt(CurrentTaskIndex); //Ensure clean up
 			}
-			else if(CurrentTask->CanTaskBeInterrupted(BestTask) && BestTask && CurrentTask->TaskName != BestTask->TaskName) 
+			else if(CanTaskBeInterrupted(CurrentTaskIndex,BestTaskIndex) && HasTask(BestTaskIndex) && GetTaskName(CurrentTaskIndex) != GetTaskName(BestTaskIndex)) 
 			{
 				//If the best task is already in progress, we don't stop it.
-				//CurrentTask->bIsTaskActive = false;
-				EndOrInterruptTaskLayers.Add(TaskLayer);
-				CurrentTask->ExitTask(); 
-				OnAnyTaskExit.Broadcast(CurrentTask->TaskName);
+				LayersToFill[LayerIndex] = 1;
+				ExitTaskAt(CurrentTaskIndex);
 			}
-			else // Task cannot be interrupted. Don't end it, and remember it for next time.
-			{
-				NewCurrentTasks.Add(TaskLayer,CurrentTask);
-			}
-			
-			
-
-
+			// else Task cannot be interrupted. Don't end it, and remember it for next time.
 		}
 	
 	}
 
 	
 	//Replace the current tasks with the best tasks
-	for (int32 TaskLayer : EndOrInterruptTaskLayers)
+	for (int32 LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
 	{	
-		
-
-		if(!BestTasks.Contains(TaskLayer))
+		const int32 BestTaskIndex = BestTaskIndices[LayerIndex];
+		if(!LayersToFill[LayerIndex] || BestTaskIndex == INDEX_NONE)
 		{
 			continue;
 		}
-		UUtilityCombatTaskComponent* BestTask = BestTasks[TaskLayer];
-		if(!BestTask)
+
+		if(!HasTask(BestTaskIndex))
 		{
 			continue;
 		}
 
+		EnterTaskAt(BestTaskIndex);
+		CurrentTaskIndices[LayerIndex] = BestTaskIndex;
 
-		BestTask->EnterTask();
-		NewCurrentTasks.Add(TaskLayer,BestTask);
-		OnAnyTaskEnter.Broadcast(BestTask->TaskName);
+		//Only touched when a layer changes. Reserved in Initialize().
+		if(UUtilityCombatTaskComponent* BestTask = GetTaskComponent(BestTaskIndex))
+		{
+			CurrentTasks.Add(PossibleLayers[LayerIndex],BestTask);
+		}
+		else
+		{
+			CurrentTasks.Remove(PossibleLayers[LayerIndex]);
+		}
 	}
+}
 
-	CurrentTasks = NewCurrentTasks;
-	
+FName UUtilityAIManagerComponent::GetTaskName(int32 TaskIndex) const
+{
+	if(const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
+	{
+		return Task->TaskName;
+	}
+	const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex);
+	return Definition ? Definition->TaskName : NAME_None;
 }
 
+bool UUtilityAIManagerComponent::IsTaskActive(int32 TaskIndex) const
+{
+	if(const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
+	{
+		return Task->bIsTaskActive;
+	}
+	const FUtilityTaskRuntimeState* State = GetTaskState(TaskIndex);
+	return State && State->bIsTaskActive;
+}
 
-void UUtilityAIManagerComponent::DetermineBestTask()
+bool UUtilityAIManagerComponent::IsTaskReadyAt(int32 TaskIndex, const double WorldTime) const
 {
-	AnteScoreCalculations();
-	TMap<int32,UUtilityCombatTaskComponent*> BT = ScoreTasks();
-	ChangeToBestTasks(BT);
+	if(const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
+	{
+		return Task->IsTaskReadyAt(WorldTime);
+	}
+	const FUtilityTaskRuntimeState* State = GetTaskState(TaskIndex);
+	return State && State->IsReadyAt(*GetTaskDefinition(TaskIndex),WorldTime);
 }
 
-void UUtilityAIManagerComponent::FindClosestCoverPoint()
+bool UUtilityAIManagerComponent::CanTaskBeInterrupted(int32 TaskIndex, int32 InterruptingTaskIndex) const
 {
+	const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex);
+	const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex);
+	if(!Task && !Definition)
+	{
+		return false;
+	}
 
-	
-	bIsCoverHitResultValid = false;
-	
-	//1. Draw a series of line traces FROM some point away from the pawn TO the pawn
-	//This stores all the hit results.
-	//2. Determine the closest FHitResult.
-	//3. Set variables accordingly.
-	
+	switch(Task ? Task->InterruptType : Definition->InterruptType)
+	{
+		case EUtilityInterruptionType::NEVER:
+			return false;
+		case EUtilityInterruptionType::ALWAYS:
+			return true;
+		case EUtilityInterruptionType::PRIORITY:
+			if(InterruptingTaskIndex != INDEX_NONE && HasTask(InterruptingTaskIndex))
+			{
+				const UUtilityCombatTaskComponent* InterruptingTask = GetTaskComponent(InterruptingTaskIndex);
+				const int32 InterruptingPriority = InterruptingTask ? InterruptingTask->InterruptionPriorityNumber : GetTaskDefinition(InterruptingTaskIndex)->InterruptionPriorityNumber;
+				return InterruptingPriority > (Task ? Task->InterruptionPriorityNumber : Definition->InterruptionPriorityNumber);
+			}
+			break;
+	}
 
+	return false;
+}
 
-	if(!OwnerController)
+bool UUtilityAIManagerComponent::DoesTaskClaimCover(int32 TaskIndex) const
+{
+	if(const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
 	{
-		return;
+		return Task->bClaimsCover;
 	}
-	
-	if(!ControlledPawn)
+	const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex);
+	return Definition && Definition->bClaimsCover;
+}
+
+const TArray<FUtilityCurveCollection>* UUtilityAIManagerComponent::GetTaskCurves(int32 TaskIndex) const
+{
+	if(const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
 	{
-		return;
+		return &Task->CurveCollectionArray;
 	}
-	if(LineTraceDegrees <= 0.0f || LineTraceDegrees >= 360.0f )
+	const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex);
+	return Definition ? &Definition->CurveCollectionArray : nullptr;
+}
+
+void UUtilityAIManagerComponent::EnterTaskAt(int32 TaskIndex)
+{
+	if(UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
 	{
-		LineTraceDegrees = 10.0f;
+		{
+			FUtilityScopedCostTimer TaskCostTimer(TaskDecisionCosts[TaskIndex]);
+			Task->CallEnterTask();
+		}
+		if(Task->bEnterTaskOverridden)
+		{
+			TaskDecisionBlueprintCalls[TaskIndex]++;
+			DecisionBlueprintCalls++;
+		}
 	}
-	if(CoverPointSearchDistance <= 0.0f)
+	else if(const UUtilityTaskDefinition* Definition = GetTaskDefinition(TaskIndex))
 	{
-		return;
+		GetTaskState(TaskIndex)->Enter(*Definition,GetWorld()->GetTimeSeconds());
 	}
 
-	
+	if(DoesTaskClaimCover(TaskIndex))
+	{
+		ClaimCover(); //If someone beat us to it, the next search skips it.
+	}
+	OnAnyTaskEnter.Broadcast(GetTaskName(TaskIndex));
+}
 
-	if(PawnMovementComp)
+void UUtilityAIManagerComponent::ExitTaskAt(int32 TaskIndex)
+{
+	if(UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex))
 	{
-		if(PawnMovementComp->IsFalling() || !PawnMovementComp->IsMovingOnGround())
 		{
-			return; //Can't find cover if falling
+			FUtilityScopedCostTimer TaskCostTimer(TaskDecisionCosts[TaskIndex]);
+			Task->CallExitTask();
+		}
+		if(Task->bExitTaskOverridden)
+		{
+			TaskDecisionBlueprintCalls[TaskIndex]++;
+			DecisionBlueprintCalls++;
 		}
 	}
+	else if(FUtilityTaskRuntimeState* State = GetTaskState(TaskIndex))
+	{
+		State->Exit();
+	}
 
-	UWorld* World = GetWorld();
-
-	FIntVector WorldOrig = World->OriginLocation;
-	FVector WorldOrigin = FVector(WorldOrig.X,WorldOrig.Y,WorldOrig.Z);
-
+	if(DoesTaskClaimCover(TaskIndex))
+	{
+		ReleaseCover();
+	}
+	OnAnyTaskExit.Broadcast(GetTaskName(TaskIndex));
+}
 
-	FVector ZAxis = ControlledPawn->GetActorUpVector();//FVector(0.0f,0.0f,1.0f); //We gonna rotate the forward vector N degrees around this
-	FVector PawnForwardVector = ControlledPawn->GetActorForwardVector();
-	FVector PawnLocation = ControlledPawn->GetActorLocation();
-	float CurrentAngle = 0.0f;
+void UUtilityAIManagerComponent::FinishTask(FName TaskName)
+{
+	for(int32 DefinitionIndex = 0; DefinitionIndex < TaskDefinitions.Num(); DefinitionIndex++)
+	{
+		if(TaskDefinitions[DefinitionIndex]->TaskName == TaskName)
+		{
+			TaskStates[DefinitionIndex].bIsTaskActive = false;
+			return;
+		}
+	}
 
-	float ShortestDistanceFromSelf = CoverPointSearchDistance; //Starting value. This is the longest the trace can be
-	float LongestCoverDistanceFromFocus = 0.0f;
+	if(bShowDebugWarnings)
+	{
+		UE_LOG(LogTemp,Warning,TEXT("%s has no task definition called %s"),*GetNameSafe(GetOwner()),*TaskName.ToString());
+	}
+}
 
-	float BestDistanceToCover = 0.0f;
+void UUtilityAIManagerComponent::RecordDecisionCost()
+{
+	const UWorld* World = GetWorld();
+	const double WorldTime = World ? World->GetTimeSeconds() : DecisionSnapshot.WorldTime;
 
-	FHitResult BestHit = FHitResult();
+	CostHistory.Add(WorldTime,static_cast<float>(DecisionCostSeconds),DecisionTraces,DecisionBlueprintCalls);
 
+	//Only sized when the console variable turns it on, and freed when it is turned off.
+	const bool bKeepTaskCostHistories = GUtilityAITaskCostHistory != 0;
+	if(bKeepTaskCostHistories && TaskCostHistories.Num() != TaskDecisionCosts.Num())
+	{
+		TaskCostHistories.SetNum(TaskDecisionCosts.Num());
+	}
+	else if(!bKeepTaskCostHistories && TaskCostHistories.Num() > 0)
+	{
+		TaskCostHistories.Empty();
+	}
 
-	//Finds the closest cover point
-	while (CurrentAngle < 360.0f)
+	for(int32 TaskIndex = 0; TaskIndex < TaskDecisionCosts.Num(); TaskIndex++)
 	{
-		FVector StartLocation = PawnForwardVector.RotateAngleAxis(CurrentAngle,ZAxis)*CoverPointSearchDistance + PawnLocation - WorldOrigin;
-		FHitResult CurrentHit; 
+		if(TaskDecisionCosts[TaskIndex] > 0.0 || TaskDecisionBlueprintCalls[TaskIndex] > 0)
+		{
+			if(bKeepTaskCostHistories)
+			{
+				TaskCostHistories[TaskIndex].Add(WorldTime,static_cast<float>(TaskDecisionCosts[TaskIndex]),0,TaskDecisionBlueprintCalls[TaskIndex]);
+			}
+			TaskDecisionCosts[TaskIndex] = 0.0;
+			TaskDecisionBlueprintCalls[TaskIndex] = 0;
+		}
+	}
 
-		World->LineTraceSingleByChannel(CurrentHit,StartLocation,PawnLocation,ECollisionChannel::ECC_Visibility);
-		//Uses out parameter
+	TracesIssued += DecisionTraces;
+	BlueprintCalls += DecisionBlueprintCalls;
+	ScoreCacheHits += DecisionScoreCacheHits;
+	ScoreCacheMisses += DecisionScoreCacheMisses;
+	ConsiderationsSkipped += DecisionConsiderationsSkipped;
+
+	INC_DWORD_STAT_BY(STAT_UtilityAI_TracesIssued, DecisionTraces);
+	INC_DWORD_STAT_BY(STAT_UtilityAI_BlueprintCalls, DecisionBlueprintCalls);
+	INC_DWORD_STAT_BY(STAT_UtilityAI_ScoreCacheHits, DecisionScoreCacheHits);
+	INC_DWORD_STAT_BY(STAT_UtilityAI_ScoreCacheMisses, DecisionScoreCacheMisses);
+	INC_DWORD_STAT_BY(STAT_UtilityAI_ConsiderationsSkipped, DecisionConsiderationsSkipped);
+	CSV_CUSTOM_STAT(UtilityAI, TracesIssued, DecisionTraces, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(UtilityAI, BlueprintCalls, DecisionBlueprintCalls, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(UtilityAI, ScoreCacheHits, DecisionScoreCacheHits, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(UtilityAI, ScoreCacheMisses, DecisionScoreCacheMisses, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(UtilityAI, ConsiderationsSkipped, DecisionConsiderationsSkipped, ECsvCustomStatOp::Accumulate);
+
+	DecisionCostSeconds = 0.0;
+	DecisionTraces = 0;
+	DecisionBlueprintCalls = 0;
+	DecisionScoreCacheHits = 0;
+	DecisionScoreCacheMisses = 0;
+	DecisionConsiderationsSkipped = 0;
+}
+
+SIZE_T UUtilityAIManagerComponent::GetDecisionMemorySize() const
+{
+	return TaskScores.GetAllocatedSize()
+		+ TaskScoredOnGameThread.GetAllocatedSize()
+		+ TaskLayerIndices.GetAllocatedSize()
+		+ TaskScoreTimes.GetAllocatedSize()
+		+ TaskWasReady.GetAllocatedSize()
+		+ TaskDirty.GetAllocatedSize()
+		+ DirtyBlocks.GetAllocatedSize()
+		+ CurrentTaskIndices.GetAllocatedSize()
+		+ BestTaskIndices.GetAllocatedSize()
+		+ BestLayerScores.GetAllocatedSize()
+		+ LayersToFill.GetAllocatedSize()
+		+ CurrentTasks.GetAllocatedSize()
+		+ DecisionSnapshot.StatNames.GetAllocatedSize()
+		+ DecisionSnapshot.StatValues.GetAllocatedSize()
+		+ ConsiderationTable.Inputs.GetAllocatedSize()
+		+ ConsiderationTable.Outputs.GetAllocatedSize()
+		+ ConsiderationTable.ScoredInputs.GetAllocatedSize();
+}
+
+void UUtilityAIManagerComponent::CountDecisionContainerResizes()
+{
+	//Any container that grew or shrank had to go to the heap. In steady state this should never happen.
+	const SIZE_T MemorySize = GetDecisionMemorySize();
+	if(LastDecisionMemorySize != 0 && MemorySize != LastDecisionMemorySize)
+	{
+		DecisionContainerResizes++;
+		INC_DWORD_STAT(STAT_UtilityAI_DecisionContainerResizes);
+		CSV_CUSTOM_STAT(UtilityAI, DecisionContainerResizes, 1, ECsvCustomStatOp::Accumulate);
+	}
+	LastDecisionMemorySize = MemorySize;
+}
+
+
+void UUtilityAIManagerComponent::DetermineBestTask()
+{
+	AnteScoreCalculations();
+	CaptureDecisionSnapshot();
+	ScoreTasksFromSnapshot();
+	ApplyBestTasks();
+}
+
+void UUtilityAIManagerComponent::RequestDecision()
+{
+	bDecisionRequested = true;
+}
+
+bool UUtilityAIManagerComponent::HasDecisionEvent(const double WorldTime) const
+{
+	if(WorldTime - DecisionSnapshot.WorldTime < MinEventDecisionInterval)
+	{
+		return false;
+	}
+
+	if(bDecisionRequested)
+	{
+		return true;
+	}
+
+	if(NextCooldownExpiry > 0.0 && WorldTime >= NextCooldownExpiry)
+	{
+		return true;
+	}
+
+	//ControllerFocus is the focus the last decision saw.
+	if(OwnerController && OwnerController->GetFocusActor() != ControllerFocus)
+	{
+		return true;
+	}
+
+	for(const int32 TaskIndex : CurrentTaskIndices)
+	{
+		if(TaskIndex != INDEX_NONE && HasTask(TaskIndex) && !IsTaskActive(TaskIndex))
+		{
+			return true; //Finished, the layer is free
+		}
+	}
+
+	return false;
+}
+
+float UUtilityAIManagerComponent::GetNextDecisionDelay() const
+{
+	return bUseEventDrivenDecisions ? EventHeartbeatInterval : GetEffectiveDecisionInterval();
+}
+
+void UUtilityAIManagerComponent::BindDecisionEvents()
+{
+	UnbindDecisionEvents();
+
+	//Bound even if bUseEventDrivenDecisions is false, so it can be switched on at runtime. The handlers check it.
+	if(!ControlledPawn)
+	{
+		return;
+	}
+
+	DecisionEventPawn = ControlledPawn;
+	ControlledPawn->OnTakeAnyDamage.AddDynamic(this, &UUtilityAIManagerComponent::OnPawnTakeAnyDamage);
+	if(UStatManager* StatManager = ControlledPawn->FindComponentByClass<UStatManager>())
+	{
+		StatManager->OnStatModified.AddDynamic(this, &UUtilityAIManagerComponent::OnPawnStatModified);
+	}
+}
+
+void UUtilityAIManagerComponent::UnbindDecisionEvents()
+{
+	if(APawn* Pawn = DecisionEventPawn.Get())
+	{
+		Pawn->OnTakeAnyDamage.RemoveDynamic(this, &UUtilityAIManagerComponent::OnPawnTakeAnyDamage);
+		if(UStatManager* StatManager = Pawn->FindComponentByClass<UStatManager>())
+		{
+			StatManager->OnStatModified.RemoveDynamic(this, &UUtilityAIManagerComponent::OnPawnStatModified);
+		}
+	}
+	DecisionEventPawn = nullptr;
+}
+
+void UUtilityAIManagerComponent::UpdateNextCooldownExpiry()
+{
+	const UWorld* World = GetWorld();
+	const double WorldTime = World ? World->GetTimeSeconds() : DecisionSnapshot.WorldTime;
+
+	NextCooldownExpiry = 0.0;
+	for(int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		if(!HasTask(TaskIndex))
+		{
+			continue;
+		}
+
+		const UUtilityCombatTaskComponent* Task = GetTaskComponent(TaskIndex);
+		const FUtilityTaskRuntimeState* State = GetTaskState(TaskIndex);
+		const float WorldTimeBegun = Task ? Task->WorldTimeBegun : State->WorldTimeBegun;
+		const float CurrentCooldown = Task ? Task->CurrentCooldown : State->CurrentCooldown;
+		if(CurrentCooldown <= 0.0f || WorldTimeBegun <= 0.0f)
+		{
+			continue;
+		}
+
+		const double Expiry = WorldTimeBegun + CurrentCooldown;
+		if(Expiry > WorldTime && (NextCooldownExpiry == 0.0 || Expiry < NextCooldownExpiry))
+		{
+			NextCooldownExpiry = Expiry;
+		}
+	}
+}
+
+void UUtilityAIManagerComponent::OnPawnStatModified(FName StatName, FStat Stat)
+{
+	//Stats none of our curves read can't change a score.
+	if(bUseEventDrivenDecisions && DecisionSnapshot.StatNames.Contains(StatName))
+	{
+		RequestDecision();
+	}
+}
+
+void UUtilityAIManagerComponent::OnPawnTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser)
+{
+	if(bUseEventDrivenDecisions)
+	{
+		RequestDecision();
+	}
+}
+
+void UUtilityAIManagerComponent::CaptureQueryInputs(FUtilityDecisionSnapshot& OutSnapshot) const
+{
+	OutSnapshot.bHasFocus = ControllerFocus != nullptr;
+	OutSnapshot.bFocusLastDetectedSet = bFocusLastDetectedSet;
+	OutSnapshot.bCurrentPointOfInterestSet = bCurrentPointOfInterestSet;
+	OutSnapshot.bIsCoverPointSafe = bIsCoverPointSafe;
+	OutSnapshot.bIsCoverHitResultValid = bIsCoverHitResultValid;
+	OutSnapshot.bIsCrouched = bIsCrouched;
+	OutSnapshot.bIsFocusAnyAttacking = bIsFocusAnyAttacking;
+	OutSnapshot.bIsFocusMeleeAttacking = bIsFocusMeleeAttacking;
+	OutSnapshot.bIsFocusRangeAttacking = bIsFocusRangeAttacking;
+	OutSnapshot.bIsInCover = bIsInCover;
+	OutSnapshot.bMeleeWeaponArmed = bMeleeWeaponArmed;
+
+	OutSnapshot.DistanceToFocus = DistanceToFocus;
+	OutSnapshot.DistanceToFocusLastDetectedPoint = DistanceToFocusLastDetectedPoint;
+	OutSnapshot.DistanceToCurrentPointOfInterest = DistanceToCurrentPointOfInterest;
+	OutSnapshot.DistanceToCover = DistanceToCover;
+
+	OutSnapshot.MeleeRange = MeleeRange;
+	OutSnapshot.MeleeRangeFallout = MeleeRangeFallout;
+	OutSnapshot.ComfortableDistance = ComfortableDistance;
+	OutSnapshot.MaxFocusSearchDistance = MaxFocusSearchDistance;
+	OutSnapshot.MaxDistanceToCurrentPointOfInterest = MaxDistanceToCurrentPointOfInterest;
+	OutSnapshot.CoverPointSearchDistance = CoverPointSearchDistance;
+}
+
+void UUtilityAIManagerComponent::CaptureDecisionSnapshot()
+{
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_CaptureDecisionSnapshot, CaptureDecisionSnapshot);
+	FUtilityScopedCostTimer CostTimer(DecisionCostSeconds);
+
+	CaptureQueryInputs(DecisionSnapshot);
+
+	//Each query is computed once, no matter how many curves use it.
+	DecisionSnapshot.ComputeQueryValues();
+
+	UWorld* World = GetWorld();
+	DecisionSnapshot.WorldTime = World ? World->GetTimeSeconds() : 0.0;
+
+	//Each stat is asked once, no matter how many curves use it.
+	GatherStatValues();
+
+	//Overridden scoring can touch anything, so it stays on the game thread.
+	bCapturingDecisionSnapshot = true;
+	for(int32 TaskIndex = 0; TaskIndex < TaskArray.Num(); TaskIndex++)
+	{
+		UUtilityCombatTaskComponent* Task = TaskArray[TaskIndex];
+		if(TaskScoredOnGameThread[TaskIndex] && Task)
+		{
+			FUtilityScopedCostTimer TaskCostTimer(TaskDecisionCosts[TaskIndex]);
+			TaskScores[TaskIndex] = Task->CallCalculateTaskScore(this);
+			if(Task->bCalculateTaskScoreOverriddenInBlueprint)
+			{
+				TaskDecisionBlueprintCalls[TaskIndex]++;
+				DecisionBlueprintCalls++;
+			}
+		}
+	}
+	bCapturingDecisionSnapshot = false;
+}
+
+void UUtilityAIManagerComponent::CaptureCurrentInputs(FUtilityDecisionSnapshot& OutSnapshot) const
+{
+	CaptureQueryInputs(OutSnapshot);
+	OutSnapshot.ComputeQueryValues();
+
+	UWorld* World = GetWorld();
+	OutSnapshot.WorldTime = World ? World->GetTimeSeconds() : 0.0;
+
+	OutSnapshot.StatNames = DecisionSnapshot.StatNames;
+	OutSnapshot.StatValues.SetNumZeroed(OutSnapshot.StatNames.Num());
+	for(int32 StatIndex = 0; StatIndex < OutSnapshot.StatNames.Num(); StatIndex++)
+	{
+		OutSnapshot.StatValues[StatIndex] = GetNormalizedStat(OutSnapshot.StatNames[StatIndex]);
+	}
+}
+
+void UUtilityAIManagerComponent::ScoreTasksFromSnapshot()
+{
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_ScoreTasks, ScoreTasks);
+	FUtilityScopedCostTimer CostTimer(DecisionCostSeconds);
+
+	for(int32 LayerIndex = 0; LayerIndex < BestTaskIndices.Num(); LayerIndex++)
+	{
+		BestTaskIndices[LayerIndex] = INDEX_NONE;
+		BestLayerScores[LayerIndex] = 0.0f;
+	}
+
+	ScoreNativeTasks();
+
+	for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		if(!HasTask(TaskIndex))
+		{
+			continue;
+		}
+
+		const int32 LayerIndex = TaskLayerIndices[TaskIndex];
+		const float TaskScore = TaskScores[TaskIndex];
+		if(TaskScore < TaskThreshold)
+		{
+			continue;
+		}
+
+		if(BestTaskIndices[LayerIndex] == INDEX_NONE || BestLayerScores[LayerIndex] < TaskScore) //NOTE: If two Tasks have the same score, I just don't care and do the first one of score X.
+		{
+			BestTaskIndices[LayerIndex] = TaskIndex;
+			BestLayerScores[LayerIndex] = TaskScore;
+		}
+
+	}
+}
+
+void UUtilityAIManagerComponent::FindClosestCoverPoint()
+{
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_FindClosestCoverPoint, FindClosestCoverPoint);
+
+	//1. Draw a series of line traces FROM some point away from the pawn TO the pawn
+	//This stores all the hit results.
+	//2. Determine the closest FHitResult.
+	//3. Set variables accordingly.
+
+	if(!CanSearchForCover())
+	{
+		bIsCoverHitResultValid = false;
+		ResetPendingCoverTraces();
+		ResetCoverSweepCursor();
+		return;
+	}
+
+	//Drop the state of the modes we aren't using, in case the mode was changed.
+	if(CoverSearchMode != ECoverSearchMode::ASYNC_SWEEP)
+	{
+		ResetPendingCoverTraces();
+	}
+	if(CoverSearchMode != ECoverSearchMode::AMORTIZED_SWEEP)
+	{
+		ResetCoverSweepCursor();
+	}
+
+	switch (CoverSearchMode)
+	{
+	case ECoverSearchMode::ASYNC_SWEEP:
+		AsyncSweepForCover();
+		break;
+	case ECoverSearchMode::ADAPTIVE_SWEEP:
+		AdaptiveSweepForCover();
+		break;
+	case ECoverSearchMode::SPATIAL_INDEX:
+		SpatialIndexSearchForCover();
+		break;
+	case ECoverSearchMode::AMORTIZED_SWEEP:
+		AmortizedSweepForCover();
+		break;
+	case ECoverSearchMode::SWEEP:
+	default:
+		SweepForCover();
+		break;
+	}
+}
+
+bool UUtilityAIManagerComponent::CanSearchForCover()
+{
+	if(!OwnerController)
+	{
+		return false;
+	}
+	
+	if(!ControlledPawn)
+	{
+		return false;
+	}
+	if(LineTraceDegrees <= 0.0f || LineTraceDegrees >= 360.0f )
+	{
+		LineTraceDegrees = 10.0f;
+	}
+	if(CoverPointSearchDistance <= 0.0f)
+	{
+		return false;
+	}
+
+	if(PawnMovementComp)
+	{
+		if(PawnMovementComp->IsFalling() || !PawnMovementComp->IsMovingOnGround())
+		{
+			return false; //Can't find cover if falling
+		}
+	}
+
+	return GetWorld() != nullptr;
+}
+
+FVector UUtilityAIManagerComponent::GetCoverTraceStart(float Angle) const
+{
+	const FIntVector WorldOrig = GetWorld()->OriginLocation;
+	const FVector WorldOrigin = FVector(WorldOrig.X,WorldOrig.Y,WorldOrig.Z);
+
+	const FVector ZAxis = ControlledPawn->GetActorUpVector(); //We gonna rotate the forward vector N degrees around this
+	const FVector PawnForwardVector = ControlledPawn->GetActorForwardVector();
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+
+	return PawnForwardVector.RotateAngleAxis(Angle,ZAxis)*CoverPointSearchDistance + PawnLocation - WorldOrigin;
+}
+
+void UUtilityAIManagerComponent::BeginCoverSelection(FUtilityCoverSelection& Selection) const
+{
+	Selection.ShortestDistanceFromSelf = CoverPointSearchDistance; //Starting value. This is the longest the trace can be
+	Selection.LongestCoverDistanceFromFocus = 0.0f;
+	Selection.BestDistanceToCover = 0.0f;
+	Selection.BestHit = FHitResult();
+}
+
+void UUtilityAIManagerComponent::ConsiderCoverHit(FUtilityCoverSelection& Selection, const FHitResult& Hit) const
+{
+	if(!Hit.GetActor())
+	{
+		return; //There isn't an actor to consider
+	}
+	else if(Hit.GetActor() == ControllerFocus || Hit.GetActor() == ControlledPawn)
+	{
+		return; //We don't want to consider hits that collide with the focus
+	}
+	else if(!Hit.GetActor()->ActorHasTag(ValidCoverPointTag))
+	{
+		return; //We don't wnat to consider actors that aren't cover points
+	}
+	else if(IsCoverClaimedByOther(Hit.Location))
+	{
+		return; //Another agent is already headed there
+	}
+
+	const float CurrentCoverDistanceFromSelf = FGenericPlatformMath::Abs(CoverPointSearchDistance-Hit.Distance);
+	
+	//Hit.Distance is the distance from the start of the
+	//line trace, to the hit location. Objects that are near where the line trace started
+	//have a small distance, but are far from the Pawn.
+
+	if(!ControllerFocus && !bFocusLastDetectedSet)
+	{
+		//No focus, or the focus is in our confortzone, find the closest cover point.
+		if(CurrentCoverDistanceFromSelf < Selection.ShortestDistanceFromSelf)
+		{
+			Selection.ShortestDistanceFromSelf = CurrentCoverDistanceFromSelf;
+			Selection.BestHit = Hit;
+			Selection.BestDistanceToCover = CurrentCoverDistanceFromSelf;
+		}
+	}
+	else if(ControllerFocus && DistanceToFocus > CoverInvalidationDistance) //Focus in our confort zone.
+	{
+		const FVector FocusLocation = FocusFacts.Location;
+		const float DistanceFromFocusToCover = (Hit.Location-FocusLocation).Size();
+
+		if(CurrentCoverDistanceFromSelf < Selection.ShortestDistanceFromSelf && DistanceFromFocusToCover > CurrentCoverDistanceFromSelf) //Want a point that is the closest but closer to us than to the focus
+		{
+			Selection.ShortestDistanceFromSelf = CurrentCoverDistanceFromSelf;
+			Selection.BestHit = Hit;
+			Selection.BestDistanceToCover = CurrentCoverDistanceFromSelf;
+		}
+	}
+	else if(ControllerFocus && DistanceToFocus <= CoverInvalidationDistance) //We have a focus, and they are close 
+	{
+		if(ClosestCoverHitResult.GetActor() && ClosestCoverHitResult.GetActor() == Hit.GetActor())
+		{
+			return; //We want a cover actor that is far away.
+		}
+		
+		const FVector FocusLocation = FocusFacts.Location;
+		const float DistanceFromFocusToCover = (Hit.Location-FocusLocation).Size();
+
+		//We want to find cover AWAY from the focus. They are too close.
+		if(DistanceFromFocusToCover > Selection.LongestCoverDistanceFromFocus && DistanceFromFocusToCover > CurrentCoverDistanceFromSelf + 20.0f) //Want points away from the focus. Give 20.0f leeway
+		{
+			Selection.LongestCoverDistanceFromFocus = DistanceFromFocusToCover;
+			Selection.BestHit = Hit;
+			Selection.BestDistanceToCover = Selection.LongestCoverDistanceFromFocus;
+		}
+	}
+}
+
+void UUtilityAIManagerComponent::ApplyCoverSelection(const FUtilityCoverSelection& Selection)
+{
+	DistanceToCover = Selection.BestDistanceToCover;
+	ClosestCoverHitResult = Selection.BestHit; 
+	bIsCoverHitResultValid = IsCoverHitResultValid(); //Only set this to true if we found a valid hit
+}
+
+void UUtilityAIManagerComponent::TraceCoverAngle(float Angle, FHitResult& OutHit)
+{
+	UWorld* World = GetWorld();
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+	const FVector StartLocation = GetCoverTraceStart(Angle);
+
+	World->LineTraceSingleByChannel(OutHit,StartLocation,PawnLocation,ECollisionChannel::ECC_Visibility);
+	DecisionTraces++;
+	//Uses out parameter
+
+	if(bDrawLineTraces)
+	{
+		DrawDebugLine(
+        World,
+        StartLocation,
+        PawnLocation,
+        FColor(255,0,0, 1),
+        true,
+        1.0f,
+        1,
+        3.0f
+		);
+	}
+}
+
+void UUtilityAIManagerComponent::SweepForCover()
+{
+	const float TraceDegrees = GetEffectiveLineTraceDegrees();
+
+	FUtilityCoverSelection Selection;
+	BeginCoverSelection(Selection);
+
+	//Finds the closest cover point
+	for(float CurrentAngle = 0.0f; CurrentAngle < 360.0f; CurrentAngle += TraceDegrees)
+	{
+		FHitResult CurrentHit; 
+		TraceCoverAngle(CurrentAngle, CurrentHit);
+		ConsiderCoverHit(Selection, CurrentHit);
+	}
+
+	ApplyCoverSelection(Selection);
+}
+
+void UUtilityAIManagerComponent::AmortizedSweepForCover()
+{
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+	const float TraceDegrees = GetEffectiveLineTraceDegrees();
+
+	//The best so far is only good for where we started the sweep.
+	if(!bCoverSweepStarted || FVector::DistSquared(PawnLocation,CoverSweepOrigin) > FMath::Square(CoverSweepInvalidationDistance))
+	{
+		ResetCoverSweepCursor();
+		bCoverSweepStarted = true;
+		CoverSweepOrigin = PawnLocation;
+		CoverSweepForward = ControlledPawn->GetActorForwardVector();
+		BeginCoverSelection(CoverSweepSelection);
+		BeginCoverSelection(CoverSweepBestSelection);
+	}
+
+	//Angles are kept relative to the forward vector at the start of the sweep, so turning doesn't skip or repeat any.
+	const float ForwardOffset = GetCoverAngle(PawnLocation + CoverSweepForward);
+
+	for(int32 TraceIndex = 0; TraceIndex < FMath::Max(CoverTracesPerDecision,1); TraceIndex++)
+	{
+		FHitResult CurrentHit;
+		TraceCoverAngle(CoverSweepCursor + ForwardOffset, CurrentHit);
+		ConsiderCoverHit(CoverSweepSelection, CurrentHit);
+		ConsiderCoverHit(CoverSweepBestSelection, CurrentHit);
+
+		CoverSweepCursor += TraceDegrees;
+		if(CoverSweepCursor >= 360.0f)
+		{
+			//Full circle. This ring replaces the last one, so cover that is gone doesn't stick around. Start the next ring from here.
+			CoverSweepBestSelection = CoverSweepSelection;
+			CoverSweepCursor = 0.0f;
+			CoverSweepOrigin = PawnLocation;
+			BeginCoverSelection(CoverSweepSelection);
+		}
+	}
+
+	//The last full ring's best, unless this ring has already beaten it.
+	if(CoverSweepBestSelection.BestHit.GetActor())
+	{
+		ApplyCoverSelection(CoverSweepBestSelection);
+	}
+	else
+	{
+		bIsCoverHitResultValid = IsCoverHitResultValid(); //Nothing yet this sweep, keep the last one.
+	}
+}
+
+void UUtilityAIManagerComponent::ResetCoverSweepCursor()
+{
+	bCoverSweepStarted = false;
+	CoverSweepCursor = 0.0f;
+}
+
+FUtilityCoverSearchResult UUtilityAIManagerComponent::RunCoverSearchForComparison(ECoverSearchMode Mode)
+{
+	FUtilityCoverSearchResult Result;
+	if(!CanSearchForCover())
+	{
+		return Result;
+	}
+
+	const FHitResult SavedHit = ClosestCoverHitResult;
+	const float SavedDistanceToCover = DistanceToCover;
+	const bool bSavedIsCoverHitResultValid = bIsCoverHitResultValid;
+	const int32 SavedDecisionTraces = DecisionTraces;
+	DecisionTraces = 0;
+
+	const double StartSeconds = FPlatformTime::Seconds();
+	switch (Mode)
+	{
+	case ECoverSearchMode::ADAPTIVE_SWEEP:
+		AdaptiveSweepForCover();
+		break;
+	case ECoverSearchMode::SPATIAL_INDEX:
+		SpatialIndexSearchForCover();
+		break;
+	case ECoverSearchMode::SWEEP:
+	default:
+		SweepForCover();
+		break;
+	}
+	Result.Seconds = FPlatformTime::Seconds() - StartSeconds;
+
+	Result.Hit = ClosestCoverHitResult;
+	Result.bFoundCover = bIsCoverHitResultValid;
+	Result.DistanceToCover = DistanceToCover;
+	Result.Traces = DecisionTraces;
+
+	ClosestCoverHitResult = SavedHit;
+	DistanceToCover = SavedDistanceToCover;
+	bIsCoverHitResultValid = bSavedIsCoverHitResultValid;
+	DecisionTraces = SavedDecisionTraces;
+	return Result;
+}
+
+float UUtilityAIManagerComponent::GetCoverAngle(const FVector& Location) const
+{
+	const FVector ZAxis = ControlledPawn->GetActorUpVector();
+	const FVector PawnForwardVector = ControlledPawn->GetActorForwardVector();
+	const FVector ToLocation = FVector::VectorPlaneProject(Location - ControlledPawn->GetActorLocation(),ZAxis);
+
+	//Same direction GetCoverTraceStart() rotates in.
+	const float Angle = FMath::RadiansToDegrees(FMath::Atan2(FVector::DotProduct(FVector::CrossProduct(PawnForwardVector,ToLocation),ZAxis),FVector::DotProduct(PawnForwardVector,ToLocation)));
+	return FRotator::ClampAxis(Angle);
+}
+
+void UUtilityAIManagerComponent::AdaptiveSweepForCover()
+{
+	const float FineDegrees = GetEffectiveLineTraceDegrees();
+	const float CoarseDegrees = FMath::Clamp(CoarseCoverTraceDegrees,FineDegrees,180.0f);
+	if(CoarseDegrees <= FineDegrees)
+	{
+		SweepForCover();
+		return;
+	}
+
+	const float HalfSector = CoarseDegrees*0.5f;
+
+	FUtilityCoverSelection Selection;
+	BeginCoverSelection(Selection);
+
+	//Sectors to refine, by their center angle. The one our last cover is in goes first, even if the coarse sweep misses it.
+	TArray<float, TInlineAllocator<16>> Sectors;
+	if(IsCoverHitResultValid())
+	{
+		Sectors.Add(GetCoverAngle(ClosestCoverHitResult.Location));
+
+		FHitResult CurrentHit;
+		TraceCoverAngle(Sectors[0], CurrentHit);
+		ConsiderCoverHit(Selection, CurrentHit);
+	}
+
+	//1. Coarse sweep. Remember the sectors that have cover in them.
+	for(float CurrentAngle = 0.0f; CurrentAngle < 360.0f; CurrentAngle += CoarseDegrees)
+	{
+		FHitResult CurrentHit;
+		TraceCoverAngle(CurrentAngle, CurrentHit);
+		ConsiderCoverHit(Selection, CurrentHit);
+
+		if(CurrentHit.GetActor() && CurrentHit.GetActor()->ActorHasTag(ValidCoverPointTag))
+		{
+			//Skip it if a sector already kept covers it, so no angle is refined twice.
+			bool bAlreadyKept = false;
+			for(const float KeptAngle : Sectors)
+			{
+				if(FMath::Abs(FRotator::NormalizeAxis(KeptAngle - CurrentAngle)) <= HalfSector)
+				{
+					bAlreadyKept = true;
+					break;
+				}
+			}
+
+			if(!bAlreadyKept)
+			{
+				Sectors.Add(CurrentAngle);
+			}
+		}
+	}
+
+	//2. Fine sweep, only inside those sectors. Their centers were already traced.
+	for(const float SectorAngle : Sectors)
+	{
+		for(float Offset = FineDegrees; Offset < HalfSector; Offset += FineDegrees)
+		{
+			FHitResult CurrentHit;
+			TraceCoverAngle(SectorAngle - Offset, CurrentHit);
+			ConsiderCoverHit(Selection, CurrentHit);
+
+			TraceCoverAngle(SectorAngle + Offset, CurrentHit);
+			ConsiderCoverHit(Selection, CurrentHit);
+		}
+	}
+
+	ApplyCoverSelection(Selection);
+}
+
+void UUtilityAIManagerComponent::AsyncSweepForCover()
+{
+	if(PendingCoverTraceHandles.Num() > 0)
+	{
+		if(PendingCoverTracesOutstanding > 0)
+		{
+			//Still in flight. Keep the last result, as long as its actor is still around.
+			bIsCoverHitResultValid = IsCoverHitResultValid();
+			return;
+		}
+
+		//The hits are from where the pawn was last decision. Close enough, and far cheaper than waiting on them.
+		FUtilityCoverSelection Selection;
+		BeginCoverSelection(Selection);
+		for(const FHitResult& CurrentHit : PendingCoverTraceHits)
+		{
+			ConsiderCoverHit(Selection, CurrentHit);
+		}
+		ApplyCoverSelection(Selection);
+		ResetPendingCoverTraces();
+	}
+	else
+	{
+		bIsCoverHitResultValid = IsCoverHitResultValid();
+	}
+
+	UWorld* World = GetWorld();
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+	const float TraceDegrees = GetEffectiveLineTraceDegrees();
+
+	if(!CoverTraceDelegate.IsBound())
+	{
+		CoverTraceDelegate.BindUObject(this, &UUtilityAIManagerComponent::OnCoverTraceDone);
+	}
+
+	for(float CurrentAngle = 0.0f; CurrentAngle < 360.0f; CurrentAngle += TraceDegrees)
+	{
+		const FVector StartLocation = GetCoverTraceStart(CurrentAngle);
+		const uint32 TraceIndex = PendingCoverTraceHandles.Num();
+
+		PendingCoverTraceHandles.Add(World->AsyncLineTraceByChannel(EAsyncTraceType::Single, StartLocation, PawnLocation, ECollisionChannel::ECC_Visibility,
+			FCollisionQueryParams::DefaultQueryParam, FCollisionResponseParams::DefaultResponseParam, &CoverTraceDelegate, TraceIndex));
+		DecisionTraces++;
 
 		if(bDrawLineTraces)
 		{
@@ -390,286 +1531,708 @@ void UUtilityAIManagerComponent::FindClosestCoverPoint()
             3.0f
 			);
 		}
+	}
+
+	PendingCoverTraceHits.SetNum(PendingCoverTraceHandles.Num());
+	PendingCoverTracesOutstanding = PendingCoverTraceHandles.Num();
+}
+
+void UUtilityAIManagerComponent::SpatialIndexSearchForCover()
+{
+	if(!CoverSubsystem)
+	{
+		SweepForCover();
+		return;
+	}
+
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+
+	CoverSlotCandidates.Reset();
+	CoverSubsystem->QueryCoverSlots(ValidCoverPointTag,PawnLocation,CoverPointSearchDistance,CoverSlotCandidates);
+
+	//Turn each slot into the hit the sweep would have made. The sweep traces in towards the pawn, 
+	//so it only ever hits the sides of cover that face away from us.
+	CoverSlotHits.Reset();
+	for(const int32 SlotIndex : CoverSlotCandidates)
+	{
+		const FUtilityCoverSlot& Slot = CoverSubsystem->GetCoverSlot(ValidCoverPointTag,SlotIndex);
+		if(FVector::DotProduct(Slot.Normal,Slot.Location - PawnLocation) <= 0.0f)
+		{
+			continue;
+		}
 
-		if(!CurrentHit.GetActor())
+		FHitResult& SlotHit = CoverSlotHits.Emplace_GetRef(Slot.CoverActor.Get(),nullptr,Slot.Location,Slot.Normal);
+		SlotHit.TraceStart = Slot.Location;
+		SlotHit.TraceEnd = PawnLocation;
+		SlotHit.Distance = FMath::Max(CoverPointSearchDistance - FVector::Dist(Slot.Location,PawnLocation),0.0f);
+	}
+
+	FUtilityCoverSelection Selection;
+	for(int32 Attempt = 0; Attempt < FMath::Max(MaxCoverValidationTraces,1); Attempt++)
+	{
+		BeginCoverSelection(Selection);
+		for(const FHitResult& SlotHit : CoverSlotHits)
 		{
-			CurrentAngle = CurrentAngle + LineTraceDegrees;
-			continue; //Force next iteration of the loop, there isn't an actor to consider
+			ConsiderCoverHit(Selection,SlotHit);
 		}
-		else if(CurrentHit.GetActor() == ControllerFocus || CurrentHit.GetActor() == ControlledPawn ) //ClosestCoverHitResult.GetActor() && ClosestCoverHitResult.GetActor() == CurrentHit.GetActor() 
+
+		if(!Selection.BestHit.GetActor())
 		{
-			CurrentAngle = CurrentAngle + LineTraceDegrees;
-			continue; //Force next iteration of the loop, we don't want to consider hits that collide with the focus
+			break;
 		}
-		else if(!CurrentHit.GetActor()->ActorHasTag(ValidCoverPointTag))
+
+		if(ValidateCoverHit(Selection.BestHit))
 		{
-			CurrentAngle = CurrentAngle + LineTraceDegrees;
-			continue; //Force next iteration of the loop, we don't wnat to consider actors that aren't cover points
+			ApplyCoverSelection(Selection);
+			return;
 		}
 
-		float CurrentCoverDistanceFromSelf = FGenericPlatformMath::Abs(CoverPointSearchDistance-CurrentHit.Distance);
-		
-		//CurrentHit.Distance is the distance from the start of the
-		//line trace, to the hit location. Objects that are near where the line trace started
-		//have a small distance, but are far from the Pawn.
-		
+		//Something is in the way. Try the next best slot.
+		const FVector RejectedLocation = Selection.BestHit.Location;
+		CoverSlotHits.RemoveAllSwap([&RejectedLocation](const FHitResult& SlotHit) { return SlotHit.Location == RejectedLocation; });
+	}
+
+	BeginCoverSelection(Selection);
+	ApplyCoverSelection(Selection);
+}
+
+bool UUtilityAIManagerComponent::ClaimCover()
+{
+	if(!CoverSubsystem || !IsCoverHitResultValid())
+	{
+		ReleaseCover();
+		return false;
+	}
+
+	bHasCoverClaim = CoverSubsystem->ClaimCover(this,ClosestCoverHitResult.Location);
+	return bHasCoverClaim;
+}
+
+void UUtilityAIManagerComponent::ReleaseCover()
+{
+	if(CoverSubsystem && bHasCoverClaim)
+	{
+		CoverSubsystem->ReleaseCover(this);
+	}
+	bHasCoverClaim = false;
+}
+
+bool UUtilityAIManagerComponent::IsCoverClaimedByOther(const FVector& Location) const
+{
+	return CoverSubsystem && CoverSubsystem->IsCoverClaimedByOther(Location,this);
+}
+
+bool UUtilityAIManagerComponent::ValidateCoverHit(FHitResult& Hit)
+{
+	UWorld* World = GetWorld();
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+	const FVector StartLocation = Hit.Location + Hit.Normal*50.0f;
+
+	FHitResult ValidationHit;
+	World->LineTraceSingleByChannel(ValidationHit,StartLocation,PawnLocation,ECollisionChannel::ECC_Visibility);
+	DecisionTraces++;
+
+	if(bDrawLineTraces)
+	{
+		DrawDebugLine(
+        World,
+        StartLocation,
+        PawnLocation,
+        FColor(255,0,0, 1),
+        true,
+        1.0f,
+        1,
+        3.0f
+		);
+	}
+
+	if(!ValidationHit.GetActor() || ValidationHit.GetActor() != Hit.GetActor())
+	{
+		return false;
+	}
+
+	Hit.Component = ValidationHit.Component;
+	return true;
+}
+
+void UUtilityAIManagerComponent::OnCoverTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	const int32 TraceIndex = static_cast<int32>(TraceDatum.UserData);
+	if(!PendingCoverTraceHandles.IsValidIndex(TraceIndex) || !(PendingCoverTraceHandles[TraceIndex] == TraceHandle))
+	{
+		return; //From a ring we already dropped
+	}
+
+	if(TraceDatum.OutHits.Num() > 0)
+	{
+		PendingCoverTraceHits[TraceIndex] = TraceDatum.OutHits[0];
+	}
+	PendingCoverTracesOutstanding = FMath::Max(PendingCoverTracesOutstanding - 1, 0);
+}
+
+void UUtilityAIManagerComponent::ResetPendingCoverTraces()
+{
+	//Reset, not Empty, so the next ring doesn't allocate.
+	PendingCoverTraceHandles.Reset();
+	PendingCoverTraceHits.Reset();
+	PendingCoverTracesOutstanding = 0;
+}
+
+
+float UUtilityAIManagerComponent::GetNormalizedStat(const ECurveInputQuery CurveInputQuery) const
+{
+	FUtilityDecisionSnapshot CurrentInputs;
+	CaptureQueryInputs(CurrentInputs);
+	return CurrentInputs.GetNormalizedInput(CurveInputQuery);
+}
+
+float UUtilityAIManagerComponent::GetNormalizedStat(const FName& InputStat) const
+{
+	if(!ControlledPawn)
+	{
+		return 0.0f;
+	}
+
+	if(StatProviderPawn.Get() == ControlledPawn)
+	{
+		//Resolved for this pawn already
+		float Value = 0.0f;
+		if(NativeStatFunction)
+		{
+			NativeStatFunction(MakeArrayView(&InputStat,1),MakeArrayView(&Value,1));
+			return Value;
+		}
+		if(NativeStatProvider && NativeStatProviderObject.IsValid())
+		{
+			NativeStatProvider->GetNormalizedStats(MakeArrayView(&InputStat,1),MakeArrayView(&Value,1));
+			return Value;
+		}
+		if(bStatProviderPawnImplementsInterface)
+		{
+			return IUtilityAIManagerToPawnInterface::Execute_GetNormalizedStat(ControlledPawn,InputStat);
+		}
+	}
+
+	if(!(ControlledPawn->GetClass()->ImplementsInterface(UUtilityAIManagerToPawnInterface::StaticClass()) ))
+	{
+		if(bShowDebugWarnings)
+		{
+			UE_LOG(LogTemp,Warning,TEXT("%s doesn't implement IUtilityAIManagerToPawnInterface interface "),*(ControlledPawn->GetFName().ToString() ) )
+		}
+		
+		return 0.0f;
+	}
+
+	return 	IUtilityAIManagerToPawnInterface::Execute_GetNormalizedStat(ControlledPawn,InputStat);
+}
+
+
+void UUtilityAIManagerComponent::UpdateDecisionLOD()
+{
+	if(!bUseDecisionLOD || DecisionLODTiers.Num() == 0 || !ControlledPawn)
+	{
+		CurrentDecisionLOD = INDEX_NONE;
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	UUtilityAIDecisionSubsystem* DecisionSubsystem = World ? World->GetSubsystem<UUtilityAIDecisionSubsystem>() : nullptr;
+	if(!DecisionSubsystem)
+	{
+		CurrentDecisionLOD = INDEX_NONE;
+		return;
+	}
+
+	//No players means nobody to look at us, so the farthest tier.
+	const FVector PawnLocation = ControlledPawn->GetActorLocation();
+	float NearestPlayerDistanceSquared = TNumericLimits<float>::Max();
+	for(const FVector& PlayerLocation : DecisionSubsystem->GetPlayerPawnLocations())
+	{
+		NearestPlayerDistanceSquared = FMath::Min(NearestPlayerDistanceSquared,FVector::DistSquared(PawnLocation,PlayerLocation));
+	}
+	const float NearestPlayerDistance = FMath::Sqrt(NearestPlayerDistanceSquared);
+
+	//Hysteresis. Boundaries of nearer tiers shrink, boundaries of our tier and farther grow, so we stay put near a boundary.
+	const int32 CurrentTier = CurrentDecisionLOD == INDEX_NONE ? 0 : CurrentDecisionLOD;
+	const float Hysteresis = FMath::Clamp(DecisionLODHysteresis,0.0f,0.9f);
+
+	int32 NewTier = DecisionLODTiers.Num() - 1;
+	for(int32 Tier = 0; Tier < DecisionLODTiers.Num() - 1; Tier++)
+	{
+		const float Scale = Tier < CurrentTier ? 1.0f - Hysteresis : 1.0f + Hysteresis;
+		if(NearestPlayerDistance <= DecisionLODTiers[Tier].MaxPlayerDistance*Scale)
+		{
+			NewTier = Tier;
+			break;
+		}
+	}
+
+	if(RecentlyRenderedMaxLODTier >= 0 && ControlledPawn->WasRecentlyRendered(RecentlyRenderedSeconds))
+	{
+		NewTier = FMath::Min(NewTier,RecentlyRenderedMaxLODTier);
+	}
+
+	CurrentDecisionLOD = NewTier;
+}
 
-		if(!ControllerFocus && !bFocusLastDetectedSet)
-		{
-			//No focus, or the focus is in our confortzone, find the closest cover point.
-			if(CurrentCoverDistanceFromSelf < ShortestDistanceFromSelf )
-			{
-				
-				ShortestDistanceFromSelf = CurrentCoverDistanceFromSelf;
-				BestHit = CurrentHit;
-				BestDistanceToCover = CurrentCoverDistanceFromSelf;
-			}
-		}
-		else if(ControllerFocus && DistanceToFocus > CoverInvalidationDistance) //Focus in our confort zone.
-		{
-			float DistanceFromFocusToCover = 0.0f;
-			if(CurrentHit.GetActor())
-			{
-				FVector FocusLocation = ControllerFocus->GetActorLocation();
-				FVector HitActorLocation = CurrentHit.Location;
-				DistanceFromFocusToCover = (HitActorLocation-FocusLocation).Size();
-			}
+float UUtilityAIManagerComponent::GetEffectiveDecisionInterval() const
+{
+	if(DecisionLODTiers.IsValidIndex(CurrentDecisionLOD))
+	{
+		return DecisionLODTiers[CurrentDecisionLOD].DecisionInterval;
+	}
+	return DecisionInterval;
+}
 
+bool UUtilityAIManagerComponent::CanFindCoverNow() const
+{
+	if(DecisionLODTiers.IsValidIndex(CurrentDecisionLOD))
+	{
+		return bCanFindCover && DecisionLODTiers[CurrentDecisionLOD].bCanFindCover;
+	}
+	return bCanFindCover;
+}
 
-			if(CurrentCoverDistanceFromSelf < ShortestDistanceFromSelf && DistanceFromFocusToCover > CurrentCoverDistanceFromSelf) //Want a point that is the closest but closer to us than to the focus
-			{
-				
-				
-				ShortestDistanceFromSelf = CurrentCoverDistanceFromSelf;
-				BestHit = CurrentHit;
-				BestDistanceToCover = CurrentCoverDistanceFromSelf;
-			}
+float UUtilityAIManagerComponent::GetEffectiveLineTraceDegrees() const
+{
+	if(DecisionLODTiers.IsValidIndex(CurrentDecisionLOD))
+	{
+		return FMath::Max(LineTraceDegrees,DecisionLODTiers[CurrentDecisionLOD].LineTraceDegrees);
+	}
+	return LineTraceDegrees;
+}
 
-		}
-		else if(ControllerFocus && DistanceToFocus <= CoverInvalidationDistance) //We have a focus, and they are close 
-		{
-			if(ClosestCoverHitResult.GetActor() && ClosestCoverHitResult.GetActor() == CurrentHit.GetActor())
-			{
-				CurrentAngle = CurrentAngle + LineTraceDegrees;
-				continue; //Force next iteration of the loop, we want a cover actor that is far away.
-			}
-			
-			float DistanceFromFocusToCover = 0.0f;
-			if(ControllerFocus && CurrentHit.GetActor() )
-			{
-				FVector FocusLocation = ControllerFocus->GetActorLocation();
-				FVector HitActorLocation = CurrentHit.Location;
-				DistanceFromFocusToCover = (HitActorLocation-FocusLocation).Size();
+void UUtilityAIManagerComponent::SetNativeStatFunction(FUtilityNativeStatFunction InNativeStatFunction)
+{
+	NativeStatFunction = MoveTemp(InNativeStatFunction);
+}
 
+void UUtilityAIManagerComponent::ResolveStatProvider()
+{
+	StatProviderPawn = ControlledPawn;
+	NativeStatProviderObject = nullptr;
+	NativeStatProvider = nullptr;
+	bStatProviderPawnImplementsInterface = false;
 
-			}
+	if(!ControlledPawn)
+	{
+		return;
+	}
 
-			//We want to find cover AWAY from the focus. They are too close.
-			if(DistanceFromFocusToCover > LongestCoverDistanceFromFocus && DistanceFromFocusToCover >  CurrentCoverDistanceFromSelf + 20.0f) //Want points away from the focus. Give 20.0f leeway
+	//1. The pawn itself
+	//2. One of its components
+	//3. Its UStatManager, if we were told its normalization is the one we want
+	//4. IUtilityAIManagerToPawnInterface, one Blueprint call per stat
+	UObject* ProviderObject = nullptr;
+	if(Cast<IUtilityAINativeStatProvider>(ControlledPawn))
+	{
+		ProviderObject = ControlledPawn;
+	}
+	else
+	{
+		for(UActorComponent* Component : ControlledPawn->GetComponents())
+		{
+			if(Component && !Component->IsA<UStatManager>() && Cast<IUtilityAINativeStatProvider>(Component))
 			{
-				LongestCoverDistanceFromFocus = DistanceFromFocusToCover;
-				BestHit = CurrentHit;
-				BestDistanceToCover = LongestCoverDistanceFromFocus;
+				ProviderObject = Component;
+				break;
 			}
-		
-			
 		}
-		
-		CurrentAngle = CurrentAngle + LineTraceDegrees;
 	}
 
-	DistanceToCover = BestDistanceToCover;
-	ClosestCoverHitResult = BestHit; 
-	bIsCoverHitResultValid = IsCoverHitResultValid(); //Only set this to true if we found a valid hit
+	if(!ProviderObject && bReadStatsFromStatManager)
+	{
+		ProviderObject = ControlledPawn->FindComponentByClass<UStatManager>();
+	}
 
+	if(ProviderObject)
+	{
+		NativeStatProviderObject = ProviderObject;
+		NativeStatProvider = Cast<IUtilityAINativeStatProvider>(ProviderObject);
+	}
 
-	
+	bStatProviderPawnImplementsInterface = ControlledPawn->GetClass()->ImplementsInterface(UUtilityAIManagerToPawnInterface::StaticClass());
 
-	
+	if(!NativeStatFunction && !NativeStatProvider && !bStatProviderPawnImplementsInterface && bShowDebugWarnings)
+	{
+		UE_LOG(LogTemp,Warning,TEXT("%s doesn't implement IUtilityAIManagerToPawnInterface or IUtilityAINativeStatProvider "),*(ControlledPawn->GetFName().ToString() ) )
+	}
 }
 
-
-float UUtilityAIManagerComponent::GetNormalizedStat(const ECurveInputQuery CurveInputQuery) const
+void UUtilityAIManagerComponent::GatherStatValues()
 {
-	float Output = 0.0f;
-	
-	switch(CurveInputQuery)
+	TArray<float>& StatValues = DecisionSnapshot.StatValues;
+	const TArray<FName>& StatNames = DecisionSnapshot.StatNames;
+
+	if(StatNames.Num() == 0)
 	{
-		case(ECurveInputQuery::IsCoverSafe):
-		{
-			Output = bIsCoverPointSafe?1.0f:0.0f;
-			break;
-		}
-		case(ECurveInputQuery::IsCoverHitResultValid):
-		{
-			Output = bIsCoverHitResultValid?1.0f:0.0f;
-			break;
-		}
-		case(ECurveInputQuery::IsCrouch):
-		{
-			Output = bIsCrouched?1.0f:0.0f;
-			break;
-		}
-		case(ECurveInputQuery::IsFocusAnyAttack):
-		{
-			Output = bIsFocusAnyAttacking?1.0f:0.0f;
-			break;
-		}
-		case(ECurveInputQuery::IsFocusInMeleeRange):
+		return;
+	}
+
+	if(!ControlledPawn)
+	{
+		FMemory::Memzero(StatValues.GetData(),StatValues.Num()*sizeof(float));
+		return;
+	}
+
+	if(StatProviderPawn.Get() != ControlledPawn)
+	{
+		ResolveStatProvider(); //Possessed a new pawn without Initialize() being called
+	}
+
+	if(NativeStatFunction)
+	{
+		NativeStatFunction(StatNames,StatValues);
+	}
+	else if(NativeStatProvider && NativeStatProviderObject.IsValid())
+	{
+		NativeStatProvider->GetNormalizedStats(StatNames,StatValues);
+	}
+	else if(bStatProviderPawnImplementsInterface)
+	{
+		for(int32 StatIndex = 0; StatIndex < StatNames.Num(); StatIndex++)
 		{
-			Output = (DistanceToFocus < MeleeRange)?1.0f:0.0f;
-			break;
+			StatValues[StatIndex] = IUtilityAIManagerToPawnInterface::Execute_GetNormalizedStat(ControlledPawn,StatNames[StatIndex]);
 		}
-		case(ECurveInputQuery::IsFocusInMeleeRangeFallout):
+		DecisionBlueprintCalls += StatNames.Num();
+	}
+	else
+	{
+		FMemory::Memzero(StatValues.GetData(),StatValues.Num()*sizeof(float));
+	}
+}
+
+bool UUtilityAIManagerComponent::IsCoverHitResultValid() const
+{
+
+	if (!ClosestCoverHitResult.GetActor())
+	{
+		return false;
+	}
+	return true;
+
+}
+
+bool UUtilityAIManagerComponent::IsCoverHitResultSafe() const
+{
+	if (!ClosestCoverHitResult.GetActor())
+	{
+		return false;
+	}
+	else if( (DistanceToFocus < CoverInvalidationDistance && ControllerFocus) || (bFocusLastDetectedSet && !ControllerFocus && DistanceToFocusLastDetectedPoint <  CoverInvalidationDistance))
+	{
+		return false;
+	}
+	else if(bUseCoverVisibility && CoverSubsystem && (ControllerFocus || bFocusLastDetectedSet))
+	{
+		const FVector FocusLocation = ControllerFocus ? FocusFacts.Location : FocusLastDetectedPoint;
+		if(CoverSubsystem->QueryCoverVisibility(ClosestCoverHitResult.Location,FocusLocation) == EUtilityCoverVisibility::VISIBLE)
 		{
-			Output = (DistanceToFocus < MeleeRangeFallout)?1.0f:0.0f;
-			break;
+			return false; //They can see us there
 		}
-		case(ECurveInputQuery::IsFocusOutOfMeleeRange):
+	}
+
+
+	return true;
+}
+
+void UUtilityAIManagerComponent::ScoreNativeTasks()
+{
+	const int32 NumPadded = ConsiderationTable.GetNumPadded();
+	const double WorldTime = DecisionSnapshot.WorldTime;
+
+	ConsiderationTable.GatherInputs(DecisionSnapshot,0,NumPadded);
+
+	//1. Find the tasks whose inputs, readiness or age changed enough to need a new score.
+	//2. Evaluate the curves of those tasks only, in blocks of 4.
+	//3. Fold the dirty tasks. Everyone else keeps the score from last time.
+	//4. With early exit, tasks that only multiply are scored last, one curve at a time, 
+	//   and stop as soon as they can't beat the threshold or the best task on their layer.
+
+	const bool bEarlyExit = bUseEarlyExitScoring;
+
+	TaskDirty.SetNumZeroed(GetNumTasks()); //Only allocates the first time, sizes don't change between Initialize() calls
+	DirtyBlocks.SetNumZeroed(NumPadded/4);
+	FMemory::Memzero(DirtyBlocks.GetData(),DirtyBlocks.Num());
+
+	int32 CacheHits = 0;
+	int32 CacheMisses = 0;
+
+	for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		TaskDirty[TaskIndex] = false;
+
+		if(!HasTask(TaskIndex) || TaskScoredOnGameThread[TaskIndex])
 		{
-			Output = (DistanceToFocus >= MeleeRange)?1.0f:0.0f;
-			break;
+			continue;
 		}
-		case(ECurveInputQuery::IsFocusOutOfMeleeRangeFallout):
+
+		const bool bReady = IsTaskReadyAt(TaskIndex,WorldTime);
+		const bool bNeverScored = TaskScoreTimes[TaskIndex] < 0.0;
+
+		bool bDirty = !bUseIncrementalScoring || bNeverScored || bReady != TaskWasReady[TaskIndex] || NativeScoreTasks[TaskIndex];
+		if(!bDirty && bReady)
 		{
-			Output = (DistanceToFocus >= MeleeRangeFallout)?1.0f:0.0f;
-			break;
+			const bool bTooOld = ScoreCacheMaxAge > 0.0f && WorldTime - TaskScoreTimes[TaskIndex] >= ScoreCacheMaxAge;
+			bDirty = bTooOld || ConsiderationTable.HasTaskInputChanged(TaskIndex,ScoreCacheInputEpsilon);
 		}
-		case(ECurveInputQuery::IsFocusMeleeAttack):
+
+		TaskWasReady[TaskIndex] = bReady;
+
+		if(!bDirty)
 		{
-			Output = bIsFocusMeleeAttacking?1.0f:0.0f;
-			break;
+			CacheHits++;
+			continue;
 		}
-		case(ECurveInputQuery::IsFocusRangeAttack):
+
+		CacheMisses++;
+		TaskDirty[TaskIndex] = true;
+		TaskScoreTimes[TaskIndex] = WorldTime;
+
+		if(!bReady)
 		{
-			Output = bIsFocusRangeAttacking?1.0f:0.0f;
-			break;
+			TaskScores[TaskIndex] = 0.0f; //Score of 0.0f if we aren't ready
+			continue;
 		}
-		case(ECurveInputQuery::IsInCover):
+
+		if(bEarlyExit && ConsiderationTable.TaskExitEarlyFlags[TaskIndex])
 		{
-			Output = bIsInCover?1.0f:0.0f;
-			break;
+			continue; //Step 4
 		}
-		case(ECurveInputQuery::IsMeleeEquip):
+
+		const int32 First = ConsiderationTable.TaskFirstConsideration[TaskIndex];
+		const int32 Last = First + ConsiderationTable.TaskConsiderationCount[TaskIndex];
+		for(int32 Block = First/4; Block < (Last + 3)/4; Block++)
 		{
-			Output = bMeleeWeaponArmed?1.0f:0.0f;
-			break;
+			DirtyBlocks[Block] = 1;
 		}
-		case(ECurveInputQuery::HasFocus):
+	}
+
+	//The native counterpart of CalculateTaskScore(), for every task scored here.
+	int32 Skipped = 0;
+	{
+		UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_EvaluateNativeTasks, EvaluateNativeTasks);
+
+		//Runs of dirty blocks are evaluated together.
+		const bool bUseSIMD = GUtilityAISIMDScoring != 0;
+		int32 Block = 0;
+		while(Block < DirtyBlocks.Num())
 		{
-			Output = (ControllerFocus != nullptr)?1.0f:0.0f;
-			break;
+			if(!DirtyBlocks[Block])
+			{
+				Block++;
+				continue;
+			}
+
+			const int32 RunStart = Block;
+			while(Block < DirtyBlocks.Num() && DirtyBlocks[Block])
+			{
+				Block++;
+			}
+			ConsiderationTable.Evaluate(RunStart*4,Block*4,bUseSIMD);
 		}
-		case(ECurveInputQuery::HasFocusLastSetPoint):
+
+		for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
 		{
-			Output = (bFocusLastDetectedSet)?1.0f:0.0f;
-			break;
+			if(!TaskDirty[TaskIndex] || !TaskWasReady[TaskIndex])
+			{
+				continue;
+			}
+
+			if(bEarlyExit && ConsiderationTable.TaskExitEarlyFlags[TaskIndex])
+			{
+				continue;
+			}
+
+			float Score = ConsiderationTable.FoldTask(TaskIndex);
+			if(const UUtilityNativeTaskComponent* NativeTask = NativeScoreTasks[TaskIndex])
+			{
+				Score = NativeTask->ScoreNativeTask(DecisionSnapshot,Score);
+			}
+			ConsiderationTable.MarkTaskScored(TaskIndex);
+			TaskScores[TaskIndex] = Score;
 		}
-		case(ECurveInputQuery::HasPointOfInterest):
+
+		if(bEarlyExit)
 		{
-			Output = (bCurrentPointOfInterestSet)?1.0f:0.0f;
-			break;
+			Skipped = ScoreTasksWithEarlyExit();
+
+			for(float& LayerBest : BestLayerScores)
+			{
+				LayerBest = 0.0f;
+			}
 		}
-		case(ECurveInputQuery::NormalizedDistanceToCover):
+	}
+
+	//May be on a worker thread, so the stats are published later by RecordDecisionCost().
+	DecisionScoreCacheHits = CacheHits;
+	DecisionScoreCacheMisses = CacheMisses;
+	DecisionConsiderationsSkipped = Skipped;
+}
+
+int32 UUtilityAIManagerComponent::ScoreTasksWithEarlyExit()
+{
+	//Best known score on each layer. Every other task already has its final score for this decision.
+	//BestLayerScores is free to use until ScoreTasksFromSnapshot() picks the best tasks.
+	for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		if(!HasTask(TaskIndex) || (TaskDirty[TaskIndex] && ConsiderationTable.TaskExitEarlyFlags[TaskIndex] && TaskWasReady[TaskIndex]))
 		{
-			Output = DistanceToCover/CoverPointSearchDistance;
-			break;
+			continue;
 		}
-		case(ECurveInputQuery::NormalizedDistanceToCurrentPointOfInterest):
+
+		float& LayerBest = BestLayerScores[TaskLayerIndices[TaskIndex]];
+		LayerBest = FMath::Max(LayerBest,TaskScores[TaskIndex]);
+	}
+
+	int32 Skipped = 0;
+	for (int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
+	{
+		if(!HasTask(TaskIndex) || !TaskDirty[TaskIndex] || !TaskWasReady[TaskIndex] || !ConsiderationTable.TaskExitEarlyFlags[TaskIndex])
 		{
-			Output = DistanceToCurrentPointOfInterest/MaxDistanceToCurrentPointOfInterest;
-			break;
+			continue;
 		}
-		case(ECurveInputQuery::NormalizedDistanceToFocus):
+
+		const int32 LayerIndex = TaskLayerIndices[TaskIndex];
+		float& LayerBest = BestLayerScores[LayerIndex];
+
+		//A task has to reach the threshold, and beat the best on its layer since ties go to the first task.
+		//The current task is only held to the threshold. ApplyBestTasks() needs its real score to decide if it ends.
+		const bool bIsCurrentTask = CurrentTaskIndices[LayerIndex] == TaskIndex;
+		const float Bound = bIsCurrentTask ? TaskThreshold : FMath::Max(TaskThreshold,LayerBest);
+
+		float Score = 0.0f;
+		if(ConsiderationTable.FoldTaskBounded(TaskIndex,Bound,Score,Skipped))
 		{
-			Output = DistanceToFocus/ComfortableDistance;
-			break;
+			ConsiderationTable.MarkTaskScored(TaskIndex);
+			TaskScores[TaskIndex] = Score;
+			LayerBest = FMath::Max(LayerBest,Score);
 		}
-		case(ECurveInputQuery::NormalizedDistanceToFocusLastDetected):
+		else
 		{
-			Output = DistanceToFocusLastDetectedPoint/MaxFocusSearchDistance;
-			break;
+			//Can't win. Its real score is unknown, so it isn't cached and gets scored again next decision.
+			TaskScores[TaskIndex] = 0.0f;
+			TaskScoreTimes[TaskIndex] = -1.0;
 		}
-
 	}
-	
-	return Output; //TODO
+
+	return Skipped;
 }
 
-float UUtilityAIManagerComponent::GetNormalizedStat(const FName& InputStat) const
+void UUtilityAIManagerComponent::InvalidateScoreCache()
 {
-	if(!ControlledPawn)
-	{
-		return 0.0f;
-	}
+	TaskScoreTimes.Init(-1.0,GetNumTasks());
+	TaskWasReady.Init(false,GetNumTasks());
+}
 
-	if(!(ControlledPawn->GetClass()->ImplementsInterface(UUtilityAIManagerToPawnInterface::StaticClass()) ))
+void UUtilityAIManagerComponent::WriteDebugValues()
+{
+	for(int32 TaskIndex = 0; TaskIndex < TaskArray.Num(); TaskIndex++)
 	{
-		if(bShowDebugWarnings)
+		UUtilityCombatTaskComponent* Task = TaskArray[TaskIndex];
+		if(!Task)
 		{
-			UE_LOG(LogTemp,Warning,TEXT("%s doesn't implement IUtilityAIManagerToPawnInterface interface "),*(ControlledPawn->GetFName().ToString() ) )
+			continue;
+		}
+
+		Task->FinalNormalizedUtilityValue = TaskScores[TaskIndex];
+
+		const int32 First = ConsiderationTable.TaskFirstConsideration[TaskIndex];
+		const int32 Count = ConsiderationTable.TaskConsiderationCount[TaskIndex];
+		for(int32 Index = First; Index < First + Count; Index++)
+		{
+			//The array can be edited at runtime without recompiling the table.
+			const int32 CurveIndex = ConsiderationTable.SourceCurveIndices[Index];
+			if(!Task->CurveCollectionArray.IsValidIndex(CurveIndex))
+			{
+				continue;
+			}
+
+			FUtilityCurveCollection& CurveCollection = Task->CurveCollectionArray[CurveIndex];
+			if(CurveCollection.CurveFloat)
+			{
+				CurveCollection.CurveOutput = ConsiderationTable.Outputs[Index];
+			}
 		}
-		
-		return 0.0f;
 	}
+}
 
-	return 	IUtilityAIManagerToPawnInterface::Execute_GetNormalizedStat(ControlledPawn,InputStat);
+void UUtilityAIManagerComponent::StartDecisionTrace(int32 Capacity)
+{
+	bRecordDecisionTrace = DecisionTrace.Start(MakeDecisionTraceLayout(), Capacity > 0 ? Capacity : DecisionTraceCapacity);
+	if(!bRecordDecisionTrace)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s has %d tasks, decision traces only hold up to %d."), *GetNameSafe(GetOwner()), GetNumTasks(), MAX_int16);
+	}
 }
 
+void UUtilityAIManagerComponent::StopDecisionTrace()
+{
+	bRecordDecisionTrace = false;
+	DecisionTrace.Stop();
+}
 
-bool UUtilityAIManagerComponent::IsCoverHitResultValid() const
+bool UUtilityAIManagerComponent::DumpDecisionTrace(const FString& Filename) const
 {
+	if(!DecisionTrace.IsRecording())
+	{
+		return false;
+	}
 
-	if (!ClosestCoverHitResult.GetActor())
+	if(!DecisionTrace.SaveToFile(Filename))
 	{
+		UE_LOG(LogTemp, Warning, TEXT("%s couldn't write its decision trace to %s"), *GetNameSafe(GetOwner()), *Filename);
 		return false;
 	}
 	return true;
-
 }
 
-bool UUtilityAIManagerComponent::IsCoverHitResultSafe() const
+FUtilityDecisionTraceLayout UUtilityAIManagerComponent::MakeDecisionTraceLayout() const
 {
-	if (!ClosestCoverHitResult.GetActor())
+	FUtilityDecisionTraceLayout Layout;
+	Layout.AgentName = GetNameSafe(GetOwner());
+
+	for(int32 TaskIndex = 0; TaskIndex < GetNumTasks(); TaskIndex++)
 	{
-		return false;
+		Layout.TaskNames.Add(GetTaskName(TaskIndex));
 	}
-	else if( (DistanceToFocus < CoverInvalidationDistance && ControllerFocus) || (bFocusLastDetectedSet && !ControllerFocus && DistanceToFocusLastDetectedPoint <  CoverInvalidationDistance))
+	Layout.TaskLayerIndices = TaskLayerIndices;
+	Layout.TaskFirstConsideration = ConsiderationTable.TaskFirstConsideration;
+	Layout.TaskConsiderationCount = ConsiderationTable.TaskConsiderationCount;
+
+	Layout.NumConsiderations = ConsiderationTable.NumConsiderations;
+	for(int32 Index = 0; Index < ConsiderationTable.NumConsiderations; Index++)
 	{
-		return false;
+		Layout.InputQueries.Add(static_cast<uint8>(ConsiderationTable.InputQueries[Index]));
+		Layout.StatIndices.Add(ConsiderationTable.StatIndices[Index]);
 	}
+	Layout.StatNames = ConsiderationTable.StatNames;
 
+	Layout.Layers = PossibleLayers;
+	return Layout;
+}
 
-	return true;
+void UUtilityAIManagerComponent::RecordDecisionTrace()
+{
+	//Started by Initialize(), StartDecisionTrace() or the details panel, so a decision never allocates the buffer.
+	DecisionTrace.Record(DecisionSnapshot.WorldTime, GFrameCounter,
+		ConsiderationTable.Inputs.GetData(), ConsiderationTable.Outputs.GetData(), TaskScores.GetData(),
+		BestTaskIndices.GetData(), CurrentTaskIndices.GetData());
 }
 
 TMap<int32,UUtilityCombatTaskComponent*> UUtilityAIManagerComponent::ScoreTasks()
 {
-	TMap<int32,UUtilityCombatTaskComponent*> BestTasks = {};
-
-	TMap<int32,float> RunningScores = {};
+	CaptureDecisionSnapshot();
+	ScoreTasksFromSnapshot();
 
-	for (UUtilityCombatTaskComponent* Task : TaskArray)
+	TMap<int32,UUtilityCombatTaskComponent*> BestTasks = {};
+	for(int32 LayerIndex = 0; LayerIndex < BestTaskIndices.Num(); LayerIndex++)
 	{
-		if(!Task)
+		if(UUtilityCombatTaskComponent* BestTask = BestTaskIndices[LayerIndex] != INDEX_NONE ? GetTaskComponent(BestTaskIndices[LayerIndex]) : nullptr)
 		{
-			continue;
-		}
-		int32 CurrentLayer = Task->TaskLayer;
-		float TaskScore = Task->CalculateTaskScore(this); //This isn't const for debug purposes, so this method and loop can't be const.
-		if(!BestTasks.Contains(CurrentLayer) && TaskScore >= TaskThreshold)
-		{
-			BestTasks.Add(CurrentLayer,Task);
-			RunningScores.Add(CurrentLayer,TaskScore);
-		}
-		else if(RunningScores.Contains(CurrentLayer) && RunningScores[CurrentLayer] < TaskScore && TaskScore >= TaskThreshold) //NOTE: If two Tasks have the same score, I just don't care and do the first one of score X.
-		{
-			RunningScores.Add(CurrentLayer,TaskScore);
-			BestTasks.Add(CurrentLayer,Task);
+			BestTasks.Add(PossibleLayers[LayerIndex],BestTask);
 		}
-
 	}
-
 	return BestTasks;
 }
 
@@ -687,6 +2250,8 @@ void UUtilityAIManagerComponent::SetMovementComponentPointers()
 	PawnMovementComp = ControlledPawn->GetMovementComponent();
 	
 	CharMC = Cast<UCharacterMovementComponent>(PawnMovementComp);
+
+	ResolveStatProvider();
 	
 	}
 }
@@ -0,0 +1,417 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityCombatDataStructures.h"
+
+/*
+Error is measured at this many points between each pair of samples.
+*/
+static const int32 LUTErrorChecksPerInterval = 8;
+
+void FUtilityCurveLUT::Bake(const UCurveFloat* Curve, int32 Resolution)
+{
+	Samples.Reset();
+	SourceCurve = Curve;
+	MaxError = 0.0f;
+
+	if(!Curve)
+	{
+		return;
+	}
+
+	Resolution = FMath::Max(Resolution,1);
+
+	const FRichCurve& RichCurve = Curve->FloatCurve;
+
+	float FirstKeyTime = 0.0f;
+	float LastKeyTime = 1.0f;
+	RichCurve.GetTimeRange(FirstKeyTime,LastKeyTime);
+
+	DomainMin = FMath::Min(0.0f,FirstKeyTime);
+	DomainMax = FMath::Max(1.0f,LastKeyTime);
+
+	//Past the keys, constant extrapolation means clamping to the first/last sample gives the exact answer.
+	bClampOutsideDomain = RichCurve.PreInfinityExtrap == ERichCurveExtrapolation::RCCE_Constant && RichCurve.PostInfinityExtrap == ERichCurveExtrapolation::RCCE_Constant;
+
+	const float SampleSpacing = (DomainMax - DomainMin)/static_cast<float>(Resolution);
+	InvSampleSpacing = 1.0f/SampleSpacing;
+
+	Samples.SetNumUninitialized(Resolution + 1);
+	for(int32 Index = 0; Index <= Resolution; Index++)
+	{
+		Samples[Index] = Curve->GetFloatValue(DomainMin + SampleSpacing*Index);
+	}
+
+	for(int32 Index = 0; Index < Resolution; Index++)
+	{
+		for(int32 Check = 1; Check < LUTErrorChecksPerInterval; Check++)
+		{
+			const float Input = DomainMin + SampleSpacing*(Index + static_cast<float>(Check)/LUTErrorChecksPerInterval);
+			const float Error = FMath::Abs(Evaluate(Input) - Curve->GetFloatValue(Input));
+			MaxError = FMath::Max(MaxError,Error);
+		}
+	}
+}
+
+
+void FUtilityConsiderationTable::Reset()
+{
+	InputQueries.Reset();
+	StatIndices.Reset();
+	LUTOffsets.Reset();
+	LUTLastIndices.Reset();
+	LUTDomainMins.Reset();
+	LUTInvSampleSpacings.Reset();
+	Dampens.Reset();
+	MultiplyFlags.Reset();
+	UnitRangeFlags.Reset();
+	SourceCurveIndices.Reset();
+	ExactOutsideDomain.Reset();
+	ExactCurves.Reset();
+	LUTSamples.Reset();
+	TaskFirstConsideration.Reset();
+	TaskConsiderationCount.Reset();
+	TaskExitEarlyFlags.Reset();
+	StatNames.Reset();
+	Inputs.Reset();
+	Outputs.Reset();
+	ScoredInputs.Reset();
+	NumConsiderations = 0;
+}
+
+/*
+Two zero samples. Used for curves without a CurveFloat and for padding.
+*/
+static void AddZeroLUT(FUtilityConsiderationTable& Table)
+{
+	Table.LUTOffsets.Add(Table.LUTSamples.Num());
+	Table.LUTSamples.Add(0.0f);
+	Table.LUTSamples.Add(0.0f);
+	Table.LUTLastIndices.Add(1.0f);
+	Table.LUTDomainMins.Add(0.0f);
+	Table.LUTInvSampleSpacings.Add(1.0f);
+	Table.Dampens.Add(0.0f);
+}
+
+int32 FUtilityConsiderationTable::AddConsideration(const FUtilityCurveCollection& CurveCollection, int32 SourceCurveIndex)
+{
+	FUtilityCurveLUT LocalLUT;
+	const FUtilityCurveLUT* LUT = &CurveCollection.BakedCurve;
+	if(!LUT->IsBaked() || LUT->SourceCurve != CurveCollection.CurveFloat)
+	{
+		//The task hasn't begun play yet, or its curve was swapped.
+		LocalLUT.Bake(CurveCollection.CurveFloat,CurveCollection.BakedCurveResolution);
+		LUT = &LocalLUT;
+	}
+
+	const int32 Index = InputQueries.Add(CurveCollection.CurveInputQuery);
+
+	int32 StatIndex = INDEX_NONE;
+	if(CurveCollection.CurveInputQuery == ECurveInputQuery::STAT_BY_FNAME)
+	{
+		StatIndex = StatNames.AddUnique(CurveCollection.StatName);
+	}
+	StatIndices.Add(StatIndex);
+	MultiplyFlags.Add(CurveCollection.bMultiplyThisCurveOutputToRunningTotal ? 1 : 0);
+	SourceCurveIndices.Add(SourceCurveIndex);
+
+	if(LUT->IsBaked())
+	{
+		//Lerping between samples never leaves their range, so the samples bound every output inside the domain.
+		const float SampleMin = FMath::Min(LUT->Samples)*CurveCollection.CurveDampen;
+		const float SampleMax = FMath::Max(LUT->Samples)*CurveCollection.CurveDampen;
+		const bool bUnitRange = LUT->bClampOutsideDomain && FMath::Min(SampleMin,SampleMax) >= 0.0f && FMath::Max(SampleMin,SampleMax) <= 1.0f;
+		UnitRangeFlags.Add(bUnitRange ? 1 : 0);
+
+		LUTOffsets.Add(LUTSamples.Num());
+		LUTSamples.Append(LUT->Samples);
+		LUTLastIndices.Add(static_cast<float>(LUT->Samples.Num() - 1));
+		LUTDomainMins.Add(LUT->DomainMin);
+		LUTInvSampleSpacings.Add(LUT->InvSampleSpacing);
+		Dampens.Add(CurveCollection.CurveDampen);
+
+		if(!LUT->bClampOutsideDomain)
+		{
+			ExactOutsideDomain.Add(Index);
+			ExactCurves.Add(CurveCollection.CurveFloat);
+		}
+	}
+	else
+	{
+		AddZeroLUT(*this);
+		UnitRangeFlags.Add(1);
+	}
+
+	NumConsiderations++;
+	return Index;
+}
+
+void FUtilityConsiderationTable::Finalize()
+{
+	while(InputQueries.Num() % 4 != 0)
+	{
+		InputQueries.Add(ECurveInputQuery::STAT_BY_FNAME);
+		StatIndices.Add(INDEX_NONE);
+		MultiplyFlags.Add(1);
+		UnitRangeFlags.Add(1);
+		SourceCurveIndices.Add(INDEX_NONE);
+		AddZeroLUT(*this);
+	}
+
+	TaskExitEarlyFlags.SetNumZeroed(TaskFirstConsideration.Num());
+	for(int32 TaskIndex = 0; TaskIndex < TaskFirstConsideration.Num(); TaskIndex++)
+	{
+		const int32 First = TaskFirstConsideration[TaskIndex];
+		const int32 Last = First + TaskConsiderationCount[TaskIndex];
+
+		bool bCanExitEarly = Last > First;
+		for(int32 Index = First; Index < Last && bCanExitEarly; Index++)
+		{
+			bCanExitEarly = MultiplyFlags[Index] && UnitRangeFlags[Index];
+		}
+		TaskExitEarlyFlags[TaskIndex] = bCanExitEarly ? 1 : 0;
+	}
+
+	Inputs.SetNumZeroed(InputQueries.Num());
+	Outputs.SetNumZeroed(InputQueries.Num());
+	ScoredInputs.SetNumZeroed(InputQueries.Num());
+}
+
+void FUtilityConsiderationTable::GatherInputs(const FUtilityDecisionSnapshot& Snapshot, int32 Begin, int32 End)
+{
+	End = FMath::Min(End,InputQueries.Num());
+
+	for(int32 Index = Begin; Index < End; Index++)
+	{
+		const int32 StatIndex = StatIndices[Index];
+		if(StatIndex != INDEX_NONE)
+		{
+			Inputs[Index] = Snapshot.StatValues.IsValidIndex(StatIndex) ? Snapshot.StatValues[StatIndex] : 0.0f;
+		}
+		else
+		{
+			//Padding is STAT_BY_FNAME without a stat, which reads 0.0f.
+			Inputs[Index] = Snapshot.GetQueryValue(InputQueries[Index]);
+		}
+	}
+}
+
+void FUtilityConsiderationTable::Evaluate(int32 Begin, int32 End, bool bUseSIMD)
+{
+	End = FMath::Min(End,InputQueries.Num());
+
+	if(bUseSIMD)
+	{
+		//Position in the table and the final lerp are done 4 at a time. 
+		//Fetching the two samples around each position is a gather, so that part stays scalar.
+		End = FMath::Min(Align(End,4),InputQueries.Num());
+
+		float Positions[4];
+		float Lows[4];
+		float Highs[4];
+		float Alphas[4];
+
+		for(int32 Index = Begin; Index < End; Index += 4)
+		{
+			VectorRegister4Float Position = VectorMultiply(VectorSubtract(VectorLoad(&Inputs[Index]),VectorLoad(&LUTDomainMins[Index])),VectorLoad(&LUTInvSampleSpacings[Index]));
+			Position = VectorMin(VectorMax(Position,VectorZeroFloat()),VectorLoad(&LUTLastIndices[Index])); //Max first, so NaN becomes 0
+			VectorStore(Position,Positions);
+
+			for(int32 Lane = 0; Lane < 4; Lane++)
+			{
+				const int32 Consideration = Index + Lane;
+				const int32 Sample = FMath::Min(static_cast<int32>(Positions[Lane]),static_cast<int32>(LUTLastIndices[Consideration]) - 1);
+				Lows[Lane] = LUTSamples[LUTOffsets[Consideration] + Sample];
+				Highs[Lane] = LUTSamples[LUTOffsets[Consideration] + Sample + 1];
+				Alphas[Lane] = Positions[Lane] - static_cast<float>(Sample);
+			}
+
+			const VectorRegister4Float Low = VectorLoad(Lows);
+			const VectorRegister4Float Lerped = VectorMultiplyAdd(VectorSubtract(VectorLoad(Highs),Low),VectorLoad(Alphas),Low);
+			VectorStore(VectorMultiply(Lerped,VectorLoad(&Dampens[Index])),&Outputs[Index]);
+		}
+	}
+	else
+	{
+		for(int32 Index = Begin; Index < End; Index++)
+		{
+			const float Position = FMath::Min(FMath::Max((Inputs[Index] - LUTDomainMins[Index])*LUTInvSampleSpacings[Index],0.0f),LUTLastIndices[Index]);
+			const int32 Sample = FMath::Min(static_cast<int32>(Position),static_cast<int32>(LUTLastIndices[Index]) - 1);
+			const float Low = LUTSamples[LUTOffsets[Index] + Sample];
+			const float High = LUTSamples[LUTOffsets[Index] + Sample + 1];
+			Outputs[Index] = FMath::Lerp(Low,High,Position - static_cast<float>(Sample))*Dampens[Index];
+		}
+	}
+
+	//Curves that don't extrapolate constantly use the real curve outside of their table.
+	for(int32 ExactIndex = 0; ExactIndex < ExactOutsideDomain.Num(); ExactIndex++)
+	{
+		const int32 Index = ExactOutsideDomain[ExactIndex];
+		if(Index < Begin || Index >= End)
+		{
+			continue;
+		}
+
+		const float DomainMax = LUTDomainMins[Index] + LUTLastIndices[Index]/LUTInvSampleSpacings[Index];
+		if(Inputs[Index] < LUTDomainMins[Index] || Inputs[Index] > DomainMax)
+		{
+			Outputs[Index] = ExactCurves[ExactIndex]->GetFloatValue(Inputs[Index])*Dampens[Index];
+		}
+	}
+}
+
+float FUtilityConsiderationTable::FoldTask(int32 TaskIndex) const
+{
+	float RunningNormalizedUtilityValue = 1.0f;
+
+	const int32 First = TaskFirstConsideration[TaskIndex];
+	const int32 Last = First + TaskConsiderationCount[TaskIndex];
+
+	for(int32 Index = First; Index < Last; Index++)
+	{
+		if(MultiplyFlags[Index])
+		{
+			RunningNormalizedUtilityValue = RunningNormalizedUtilityValue*Outputs[Index];
+		}
+		else
+		{
+			RunningNormalizedUtilityValue = RunningNormalizedUtilityValue+Outputs[Index];
+		}
+	}
+
+	return RunningNormalizedUtilityValue;
+}
+
+bool FUtilityConsiderationTable::HasTaskInputChanged(int32 TaskIndex, float Epsilon) const
+{
+	const int32 First = TaskFirstConsideration[TaskIndex];
+	const int32 Last = First + TaskConsiderationCount[TaskIndex];
+
+	for(int32 Index = First; Index < Last; Index++)
+	{
+		if(!(FMath::Abs(Inputs[Index] - ScoredInputs[Index]) <= Epsilon)) //Written this way so NaN counts as changed
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FUtilityConsiderationTable::MarkTaskScored(int32 TaskIndex)
+{
+	const int32 First = TaskFirstConsideration[TaskIndex];
+	const int32 Count = TaskConsiderationCount[TaskIndex];
+
+	if(Count > 0)
+	{
+		FMemory::Memcpy(&ScoredInputs[First],&Inputs[First],Count*sizeof(float));
+	}
+}
+
+float FUtilityConsiderationTable::GetEvaluationOrderKey(const FUtilityCurveCollection& CurveCollection)
+{
+	float Cost = 2.0f;
+	switch(CurveCollection.CurveInputQuery)
+	{
+		case ECurveInputQuery::STAT_BY_FNAME:
+			Cost = 2.0f;
+			break;
+		case ECurveInputQuery::NormalizedDistanceToCover:
+		case ECurveInputQuery::NormalizedDistanceToCurrentPointOfInterest:
+		case ECurveInputQuery::NormalizedDistanceToFocus:
+		case ECurveInputQuery::NormalizedDistanceToFocusLastDetected:
+			Cost = 1.0f;
+			break;
+		default:
+			Cost = 0.0f; //IsX and HasX
+			break;
+	}
+
+	if(!CurveCollection.CurveFloat)
+	{
+		return Cost; //Always 0.0f, as selective as it gets
+	}
+
+	FUtilityCurveLUT LocalLUT;
+	const FUtilityCurveLUT* LUT = &CurveCollection.BakedCurve;
+	if(!LUT->IsBaked() || LUT->SourceCurve != CurveCollection.CurveFloat)
+	{
+		LocalLUT.Bake(CurveCollection.CurveFloat,CurveCollection.BakedCurveResolution);
+		LUT = &LocalLUT;
+	}
+
+	//How big the output usually is. Booleans only ever see 0.0f and 1.0f.
+	float ExpectedOutput = 1.0f;
+	if(Cost == 0.0f)
+	{
+		ExpectedOutput = 0.5f*(CurveCollection.EvaluateCurve(0.0f) + CurveCollection.EvaluateCurve(1.0f));
+	}
+	else if(LUT->IsBaked())
+	{
+		float Sum = 0.0f;
+		for(const float Sample : LUT->Samples)
+		{
+			Sum += Sample;
+		}
+		ExpectedOutput = Sum/LUT->Samples.Num();
+	}
+
+	ExpectedOutput = FMath::Clamp(ExpectedOutput*CurveCollection.CurveDampen,0.0f,0.999f);
+	if(!LUT->bClampOutsideDomain)
+	{
+		Cost += 0.5f; //Can fall back to the real curve
+	}
+
+	return Cost + ExpectedOutput*0.5f;
+}
+
+float FUtilityConsiderationTable::EvaluateConsideration(int32 Index) const
+{
+	return EvaluateConsiderationAt(Index,Inputs[Index]);
+}
+
+float FUtilityConsiderationTable::EvaluateConsiderationAt(int32 Index, const float Input) const
+{
+	const float Position = FMath::Min(FMath::Max((Input - LUTDomainMins[Index])*LUTInvSampleSpacings[Index],0.0f),LUTLastIndices[Index]);
+
+	const float DomainMax = LUTDomainMins[Index] + LUTLastIndices[Index]/LUTInvSampleSpacings[Index];
+	if(Input < LUTDomainMins[Index] || Input > DomainMax)
+	{
+		const int32 ExactIndex = ExactOutsideDomain.IndexOfByKey(Index);
+		if(ExactIndex != INDEX_NONE)
+		{
+			return ExactCurves[ExactIndex]->GetFloatValue(Input)*Dampens[Index];
+		}
+	}
+
+	const int32 Sample = FMath::Min(static_cast<int32>(Position),static_cast<int32>(LUTLastIndices[Index]) - 1);
+	const float Low = LUTSamples[LUTOffsets[Index] + Sample];
+	const float High = LUTSamples[LUTOffsets[Index] + Sample + 1];
+	return FMath::Lerp(Low,High,Position - static_cast<float>(Sample))*Dampens[Index];
+}
+
+bool FUtilityConsiderationTable::FoldTaskBounded(int32 TaskIndex, float Bound, float& OutScore, int32& OutSkipped)
+{
+	float RunningNormalizedUtilityValue = 1.0f;
+
+	const int32 First = TaskFirstConsideration[TaskIndex];
+	const int32 Last = First + TaskConsiderationCount[TaskIndex];
+
+	for(int32 Index = First; Index < Last; Index++)
+	{
+		Outputs[Index] = EvaluateConsideration(Index);
+		RunningNormalizedUtilityValue = RunningNormalizedUtilityValue*Outputs[Index];
+
+		//Everything left is in [0,1], so the total can't climb back up.
+		if(RunningNormalizedUtilityValue < Bound && Index + 1 < Last)
+		{
+			OutSkipped += Last - (Index + 1);
+			OutScore = RunningNormalizedUtilityValue;
+			return false;
+		}
+	}
+
+	OutScore = RunningNormalizedUtilityValue;
+	return true;
+}
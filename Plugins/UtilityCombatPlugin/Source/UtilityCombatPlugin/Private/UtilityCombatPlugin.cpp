@@ -1,9 +1,38 @@
 // Copyright Zachary Kolansky, 2020
 
 #include "UtilityCombatPlugin.h"
+#include "UtilityAIStats.h"
 
 #define LOCTEXT_NAMESPACE "FUtilityCombatPluginModule"
 
+DEFINE_STAT(STAT_UtilityAI_SchedulerTick);
+DEFINE_STAT(STAT_UtilityAI_AnteScoreCalculations);
+DEFINE_STAT(STAT_UtilityAI_FindClosestCoverPoint);
+DEFINE_STAT(STAT_UtilityAI_CaptureDecisionSnapshot);
+DEFINE_STAT(STAT_UtilityAI_ScoreTasks);
+DEFINE_STAT(STAT_UtilityAI_CalculateTaskScore);
+DEFINE_STAT(STAT_UtilityAI_EvaluateNativeTasks);
+DEFINE_STAT(STAT_UtilityAI_ChangeToBestTasks);
+DEFINE_STAT(STAT_UtilityAI_CrowdTick);
+DEFINE_STAT(STAT_UtilityAI_DecisionBudgetMs);
+DEFINE_STAT(STAT_UtilityAI_DecisionTimeUsedMs);
+DEFINE_STAT(STAT_UtilityAI_RegisteredManagers);
+DEFINE_STAT(STAT_UtilityAI_QueueDepth);
+DEFINE_STAT(STAT_UtilityAI_DecisionsRun);
+DEFINE_STAT(STAT_UtilityAI_DecisionsDeferred);
+DEFINE_STAT(STAT_UtilityAI_EventDecisions);
+DEFINE_STAT(STAT_UtilityAI_ScoreCacheHits);
+DEFINE_STAT(STAT_UtilityAI_ScoreCacheMisses);
+DEFINE_STAT(STAT_UtilityAI_ConsiderationsSkipped);
+DEFINE_STAT(STAT_UtilityAI_DecisionContainerResizes);
+DEFINE_STAT(STAT_UtilityAI_TracesIssued);
+DEFINE_STAT(STAT_UtilityAI_BlueprintCalls);
+DEFINE_STAT(STAT_UtilityAI_CrowdAgents);
+DEFINE_STAT(STAT_UtilityAI_CrowdDecisions);
+DEFINE_STAT(STAT_UtilityAI_CrowdPromotions);
+
+CSV_DEFINE_CATEGORY_MODULE(UTILITYCOMBATPLUGIN_API, UtilityAI, true);
+
 void FUtilityCombatPluginModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -3,8 +3,18 @@
 
 #include "UtilityCombatTaskComponent.h"
 #include "UtilityAIManagerComponent.h"
+#include "UtilityNativeTaskComponent.h"
 #include "Math/UnrealMathUtility.h"
 #include "AIController.h"
+#include "HAL/IConsoleManager.h"
+#include "UtilityAIStats.h"
+
+static float GUtilityAICurveLUTWarnError = 0.01f;
+static FAutoConsoleVariableRef CVarUtilityAICurveLUTWarnError(
+	TEXT("UtilityAI.CurveLUT.WarnError"),
+	GUtilityAICurveLUTWarnError,
+	TEXT("Baked curves with a larger max error than this are logged, so the curve's BakedCurveResolution can be raised."),
+	ECVF_Default);
 
 
 // Sets default values for this component's properties
@@ -33,9 +43,35 @@ void UUtilityCombatTaskComponent::BeginPlay()
 	{
 		MaxCooldown = 0.0f;
 	}
+
+	BakeCurves();
 	
 }
 
+#if WITH_EDITOR
+void UUtilityCombatTaskComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BakeCurves();
+}
+#endif
+
+void UUtilityCombatTaskComponent::BakeCurves()
+{
+	for (int32 CurveIndex = 0; CurveIndex < CurveCollectionArray.Num(); CurveIndex++)
+	{
+		FUtilityCurveCollection& CurveCollection = CurveCollectionArray[CurveIndex];
+		CurveCollection.BakeCurve();
+
+		if(CurveCollection.CurveFloat && CurveCollection.BakedCurveMaxError > GUtilityAICurveLUTWarnError)
+		{
+			UE_LOG(LogTemp,Warning,TEXT("%s: curve %d (%s) baked with max error %f at resolution %d. Raise BakedCurveResolution if this matters."),
+				*(TaskName.ToString()),CurveIndex,*(CurveCollection.CurveFloat->GetName()),CurveCollection.BakedCurveMaxError,CurveCollection.BakedCurveResolution)
+		}
+	}
+}
+
 
 // Called every frame
 void UUtilityCombatTaskComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -48,50 +84,139 @@ void UUtilityCombatTaskComponent::TickComponent(float DeltaTime, ELevelTick Tick
 
 float UUtilityCombatTaskComponent::CalculateTaskScore_Implementation(UUtilityAIManagerComponent* ManagerComponent)
 {
+	UTILITY_AI_SCOPE_CYCLE_COUNTER(STAT_UtilityAI_CalculateTaskScore, CalculateTaskScore);
+
 	CurrentManagerComponent = ManagerComponent;
 	if(!ManagerComponent || !IsTaskReady())
 	{
 		return 0.0f; //Score of 0.0f if we aren't ready OR we were never given a manager component.
 	}
 
-	TArray<FName> CollectionKeys = {};
+	if(ManagerComponent->bCapturingDecisionSnapshot)
+	{
+		return EvaluateCurves(ManagerComponent->GetDecisionSnapshot());
+	}
+
+	//Called outside of a decision, so DecisionSnapshot may be old.
+	FUtilityDecisionSnapshot CurrentInputs;
+	ManagerComponent->CaptureCurrentInputs(CurrentInputs);
+	return EvaluateCurves(CurrentInputs);
+}
+
+bool UUtilityCombatTaskComponent::IsCalculateTaskScoreOverridden() const
+{
+	return IsOverriddenInBlueprint(GET_FUNCTION_NAME_CHECKED(UUtilityCombatTaskComponent,CalculateTaskScore)) || IsCalculateTaskScoreOverriddenNatively();
+}
 
+bool UUtilityCombatTaskComponent::IsCalculateTaskScoreOverriddenNatively() const
+{
+	//C++ overrides of CalculateTaskScore_Implementation() can't be seen through reflection, so any C++ subclass is assumed to have one.
+	const UClass* NativeClass = GetClass();
+	while(NativeClass && !NativeClass->HasAnyClassFlags(CLASS_Native))
+	{
+		NativeClass = NativeClass->GetSuperClass();
+	}
+
+	if(!NativeClass || NativeClass == UUtilityCombatTaskComponent::StaticClass())
+	{
+		return false;
+	}
+
+	//UUtilityNativeTaskComponent's override is final, its subclasses change their score in ScoreNativeTask() instead.
+	return !NativeClass->IsChildOf(UUtilityNativeTaskComponent::StaticClass());
+}
+
+bool UUtilityCombatTaskComponent::IsOverriddenInBlueprint(FName FunctionName) const
+{
+	//A Blueprint override makes a new UFunction owned by the Blueprint class. C++ overrides of the _Implementation don't.
+	const UFunction* Function = GetClass()->FindFunctionByName(FunctionName);
+	return Function && Function->GetOuter() != UUtilityCombatTaskComponent::StaticClass();
+}
+
+void UUtilityCombatTaskComponent::CacheBlueprintOverrides()
+{
+	bCalculateTaskScoreOverriddenInBlueprint = IsOverriddenInBlueprint(GET_FUNCTION_NAME_CHECKED(UUtilityCombatTaskComponent,CalculateTaskScore));
+	bCalculateTaskScoreOverridden = bCalculateTaskScoreOverriddenInBlueprint || IsCalculateTaskScoreOverriddenNatively();
+	bEnterTaskOverridden = IsOverriddenInBlueprint(GET_FUNCTION_NAME_CHECKED(UUtilityCombatTaskComponent,EnterTask));
+	bExitTaskOverridden = IsOverriddenInBlueprint(GET_FUNCTION_NAME_CHECKED(UUtilityCombatTaskComponent,ExitTask));
+	bBlueprintOverridesCached = true;
+}
+
+void UUtilityCombatTaskComponent::CallEnterTask()
+{
+	if(!bBlueprintOverridesCached)
+	{
+		CacheBlueprintOverrides();
+	}
+
+	if(bEnterTaskOverridden)
+	{
+		EnterTask();
+	}
+	else
+	{
+		EnterTask_Implementation(); //Virtual, so C++ subclasses still get their override
+	}
+}
+
+void UUtilityCombatTaskComponent::CallExitTask()
+{
+	if(!bBlueprintOverridesCached)
+	{
+		CacheBlueprintOverrides();
+	}
+
+	if(bExitTaskOverridden)
+	{
+		ExitTask();
+	}
+	else
+	{
+		ExitTask_Implementation();
+	}
+}
+
+float UUtilityCombatTaskComponent::CallCalculateTaskScore(UUtilityAIManagerComponent* ManagerComponent)
+{
+	if(!bBlueprintOverridesCached)
+	{
+		CacheBlueprintOverrides();
+	}
+
+	if(bCalculateTaskScoreOverriddenInBlueprint)
+	{
+		return CalculateTaskScore(ManagerComponent);
+	}
+	return CalculateTaskScore_Implementation(ManagerComponent);
+}
+
+float UUtilityCombatTaskComponent::EvaluateCurves(const FUtilityDecisionSnapshot& Snapshot) const
+{
 	float RunningNormalizedUtilityValue = 1.0f; //Multiple the output of each graph
 
-	for (FUtilityCurveCollection& CurveCollection : CurveCollectionArray)
+	for (const FUtilityCurveCollection& CurveCollection : CurveCollectionArray)
 	{
 		float NormalizedCurveOutput = 1.0f;
 		float Dampen = 1.0f;
 
+		float CurveTime = 0.0f;
 		if(CurveCollection.CurveInputQuery == ECurveInputQuery::STAT_BY_FNAME)
 		{
-			float CurveTime = ManagerComponent->GetNormalizedStat(CurveCollection.StatName);
-			if(CurveCollection.CurveFloat)
-			{
-				NormalizedCurveOutput = CurveCollection.CurveFloat->GetFloatValue(CurveTime);
-				CurveCollection.CurveOutput = NormalizedCurveOutput*CurveCollection.CurveDampen;
-				Dampen = CurveCollection.CurveDampen;
+			CurveTime = Snapshot.GetNormalizedInput(CurveCollection.StatName);
+		}
+		else
+		{
+			CurveTime = Snapshot.GetQueryValue(CurveCollection.CurveInputQuery);
+		}
 
-			}
-			else
-			{
-				NormalizedCurveOutput = 0.0f;
-			}
-			
+		if(CurveCollection.CurveFloat)
+		{
+			NormalizedCurveOutput = CurveCollection.EvaluateCurve(CurveTime);
+			Dampen = CurveCollection.CurveDampen;
 		}
 		else
 		{
-			float CurveTime = ManagerComponent->GetNormalizedStat(CurveCollection.CurveInputQuery);
-			if(CurveCollection.CurveFloat)
-			{
-				NormalizedCurveOutput = CurveCollection.CurveFloat->GetFloatValue(CurveTime);
-				CurveCollection.CurveOutput = NormalizedCurveOutput*CurveCollection.CurveDampen;
-				Dampen = CurveCollection.CurveDampen;	
-			}
-			else
-			{
-				NormalizedCurveOutput = 0.0f;
-			}
+			NormalizedCurveOutput = 0.0f;
 		}
 
 		if(CurveCollection.bMultiplyThisCurveOutputToRunningTotal)
@@ -107,7 +232,6 @@ float UUtilityCombatTaskComponent::CalculateTaskScore_Implementation(UUtilityAIM
 	
 	}
 
-	FinalNormalizedUtilityValue = RunningNormalizedUtilityValue;
 	return RunningNormalizedUtilityValue;
 }
 
@@ -156,6 +280,11 @@ void UUtilityCombatTaskComponent::ExitTask_Implementation()
 }
 
 bool UUtilityCombatTaskComponent::IsTaskReady()
+{	
+	return IsTaskReadyAt(GetWorld()->GetTimeSeconds());
+}
+
+bool UUtilityCombatTaskComponent::IsTaskReadyAt(const double WorldTime) const
 {	
 	if( (bPeformedTask && bOnlyDoTaskOnce) || bTaskLocked)
 	{
@@ -167,10 +296,7 @@ bool UUtilityCombatTaskComponent::IsTaskReady()
 		return true; //Either Cooldown is none, or we haven't done the task yet.
 	}
 	
-	float CurrentTime = GetWorld()->GetTimeSeconds();
-	
-	
-	if(CurrentTime - WorldTimeBegun >= CurrentCooldown)
+	if(WorldTime - WorldTimeBegun >= CurrentCooldown)
 	{
 		return true;
 	}
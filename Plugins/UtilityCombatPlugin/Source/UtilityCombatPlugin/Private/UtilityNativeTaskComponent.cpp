@@ -0,0 +1,25 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityNativeTaskComponent.h"
+#include "UtilityAIManagerComponent.h"
+
+float UUtilityNativeTaskComponent::CalculateTaskScore_Implementation(UUtilityAIManagerComponent* ManagerComponent)
+{
+	CurrentManagerComponent = ManagerComponent;
+	if(!ManagerComponent || !IsTaskReady())
+	{
+		return 0.0f;
+	}
+
+	if(ManagerComponent->bCapturingDecisionSnapshot)
+	{
+		const FUtilityDecisionSnapshot& Snapshot = ManagerComponent->GetDecisionSnapshot();
+		return ScoreNativeTask(Snapshot,EvaluateCurves(Snapshot));
+	}
+
+	//Called outside of a decision, so DecisionSnapshot may be old.
+	FUtilityDecisionSnapshot CurrentInputs;
+	ManagerComponent->CaptureCurrentInputs(CurrentInputs);
+	return ScoreNativeTask(CurrentInputs,EvaluateCurves(CurrentInputs));
+}
@@ -0,0 +1,46 @@
+// Copyright Zachary Kolansky, 2020
+
+
+#include "UtilityTaskDefinition.h"
+
+bool UUtilityTaskDefinition::CanBeInterruptedBy(const UUtilityTaskDefinition* InterruptingTask) const
+{
+	switch(InterruptType)
+	{
+		case EUtilityInterruptionType::NEVER:
+			return false;
+		case EUtilityInterruptionType::ALWAYS:
+			return true;
+		case EUtilityInterruptionType::PRIORITY:
+			return InterruptingTask && InterruptingTask->InterruptionPriorityNumber > InterruptionPriorityNumber;
+	}
+	return false;
+}
+
+void UUtilityTaskDefinition::BakeCurves()
+{
+	for(FUtilityCurveCollection& CurveCollection : CurveCollectionArray)
+	{
+		CurveCollection.BakeCurve();
+	}
+}
+
+void UUtilityTaskDefinition::PostLoad()
+{
+	Super::PostLoad();
+
+	MinCooldown = FMath::Max(MinCooldown,0.0f);
+	MaxCooldown = FMath::Max(MaxCooldown,0.0f);
+
+	//Curves are loaded before their users, so they are ready to sample.
+	BakeCurves();
+}
+
+#if WITH_EDITOR
+void UUtilityTaskDefinition::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BakeCurves();
+}
+#endif
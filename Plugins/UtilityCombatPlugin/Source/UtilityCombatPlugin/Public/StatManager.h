@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "StatDataStructures.h"
+#include "UtilityAINativeStatProvider.h"
 #include "StatManager.generated.h"
 
 
@@ -92,7 +93,7 @@ Stat Bindings (have one stat influence the value of another stat )
 Influence of other UStatManagers for equipment (Player has a Damage Stat of 100, sword has a damage Stat of 100, we can add those together)
 */
 UCLASS(  Blueprintable, BlueprintType, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
-class UTILITYCOMBATPLUGIN_API UStatManager : public UActorComponent 
+class UTILITYCOMBATPLUGIN_API UStatManager : public UActorComponent, public IUtilityAINativeStatProvider
 {
 	GENERATED_BODY()
 
@@ -530,6 +531,12 @@ public:
 	UFUNCTION(BlueprintPure,Category = StatQuery)
 	float GetRawStatTotal(const FName StatName, bool bUseRawForSelf = true);
 
+	/*
+	IUtilityAINativeStatProvider. 
+	Each stat is GetStatTotalAsStat(), normalized from its Minimum to its Maximum. 0.0f if the stat has no range.
+	*/
+	virtual void GetNormalizedStats(TArrayView<const FName> StatNames, TArrayView<float> OutValues) override;
+
 
 
 
@@ -0,0 +1,108 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "UtilityAIBenchmarkCommandlet.generated.h"
+
+class UUtilityAIManagerComponent;
+class UCurveFloat;
+class UUtilityTaskArchetype;
+
+/*
+Results of one benchmark run.
+*/
+struct FUtilityAIBenchmarkResults
+{
+	int32 Agents = 0;
+
+	int32 Rounds = 0;
+
+	int32 Seed = 0;
+
+	FString CoverMode = FString();
+
+	int32 Decisions = 0;
+
+	double DecisionSeconds = 0.0;
+
+	double DecisionsPerSecond = 0.0;
+
+	double P50Ms = 0.0;
+
+	double P95Ms = 0.0;
+
+	double P99Ms = 0.0;
+
+	double MeanMs = 0.0;
+
+	double TracesPerDecision = 0.0;
+
+	double AllocationsPerDecision = 0.0;
+
+	double ContainerResizesPerDecision = 0.0;
+
+	int32 CrowdAgents = 0;
+
+	double CrowdTickP50Ms = 0.0;
+
+	double CrowdTickP95Ms = 0.0;
+
+	double CrowdTickP99Ms = 0.0;
+
+	double CrowdTickMeanMs = 0.0;
+};
+
+/*
+Headless benchmark of the utility AI decision pipeline. Needs no GPU.
+
+UnrealEditor-Cmd Project.uproject -run=UtilityAIBenchmark -nullrhi -unattended [options]
+
+-Agents=100       AI controllers, each with a UUtilityAIManagerComponent and a pawn
+-Rounds=100       Decision rounds. Every agent decides once per round, then the world ticks once.
+-Seed=1234        Seed for everything random: placement, curves, movement and focus
+-Cover=50         Cover blocks placed around the area, tagged Cover
+-Area=10000       Half size of the square the agents and cover are placed in
+-Tasks=A,B        Task component classes every agent gets, by path. Default is -GeneratedTasks UUtilityCombatTaskComponents
+                  with -CurvesPerTask generated curves each.
+-CoverMode=SWEEP  An ECoverSearchMode
+-CrowdAgents=0    Agents added to UUtilityAICrowdSubsystem, with an archetype of -GeneratedTasks definitions. Its tick is timed every round.
+-Out=Path         Where to write Path.csv and Path.json. Default is Saved/UtilityAIBenchmark/Benchmark_<time>
+
+Reports decisions per second, p50/p95/p99 and mean latency of DetermineBestTask(), and traces and allocations per decision.
+Allocations are every heap allocation DetermineBestTask() makes on the game thread, counted by wrapping GMalloc for the rounds.
+Container resizes are UUtilityAIManagerComponent::DecisionContainerResizes, the decisions that resized a decision container.
+With -CrowdAgents, also p50/p95/p99 and mean of one crowd tick, e.g. -Agents=1 -CrowdAgents=10000 for the cost of a 10k agent crowd per frame.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAIBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UUtilityAIBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+
+	/*
+	Cover blocks, scattered with RandomStream.
+	*/
+	void PlaceCover(UWorld* World, int32 CoverCount, float Area, FRandomStream& RandomStream) const;
+
+	/*
+	One AI controller with a pawn, a manager, and its tasks. Returns the manager.
+	*/
+	UUtilityAIManagerComponent* SpawnAgent(UWorld* World, const TArray<UClass*>& TaskClasses, int32 GeneratedTasks, int32 CurvesPerTask,
+		const TArray<UCurveFloat*>& Curves, float Area, FRandomStream& RandomStream) const;
+
+	/*
+	A transient archetype of GeneratedTasks task definitions, never promoted.
+	*/
+	UUtilityTaskArchetype* MakeCrowdArchetype(int32 GeneratedTasks, int32 CurvesPerTask, const TArray<UCurveFloat*>& Curves, FRandomStream& RandomStream) const;
+
+	bool WriteResults(const FString& OutPath, const FUtilityAIBenchmarkResults& Results) const;
+};
@@ -0,0 +1,27 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "UtilityAICoverBakeCommandlet.generated.h"
+
+/*
+Bakes the cover slots of a map into a UUtilityAICoverBakeData, so UUtilityAICoverSubsystem doesn't generate them at runtime.
+
+UnrealEditor-Cmd.exe Project.uproject -run=UtilityAICoverBake -Map=/Game/Maps/Arena [-Tag=Cover] [-Spacing=100]
+
+The persistent level and every streamed level are baked. World partition maps aren't supported.
+Rerun it after moving cover, the subsystem warns when a bake is stale, and ignores bakes from an older FUtilityAICoverBakeVersion.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAICoverBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UUtilityAICoverBakeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,116 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "UtilityAICoverBakeData.generated.h"
+
+/*
+One baked cover slot. Plain old data, so the whole array is read in one go.
+*/
+struct FUtilityBakedCoverSlot
+{
+	FVector3f Location = FVector3f::ZeroVector;
+
+	FVector3f Normal = FVector3f::ZeroVector;
+
+	/*
+	Index into UUtilityAICoverBakeData::CoverActors.
+	*/
+	int32 CoverActorIndex = INDEX_NONE;
+
+	/*
+	How tall the cover is. Low cover is crouch cover, tall cover is stand cover.
+	*/
+	float Height = 0.0f;
+
+	friend FArchive& operator<<(FArchive& Ar, FUtilityBakedCoverSlot& Slot)
+	{
+		Ar << Slot.Location << Slot.Normal << Slot.CoverActorIndex << Slot.Height;
+		return Ar;
+	}
+};
+
+template<> struct TCanBulkSerialize<FUtilityBakedCoverSlot> { enum { Value = true }; };
+
+/*
+Version of the UUtilityAICoverBakeData layout. Add a new entry before VersionPlusOne whenever FUtilityBakedCoverSlot 
+or how slots are generated changes, so bakes made before it are rejected instead of read wrong.
+*/
+struct UTILITYCOMBATPLUGIN_API FUtilityAICoverBakeVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+		AddedCustomVersion = 1,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+/*
+The cover slots of one map and cover tag, baked by the UtilityAICoverBake commandlet.
+
+UUtilityAICoverSubsystem loads this instead of generating slots, if it exists at GetBakePackageName().
+Add UtilityAI.Cover.BakePath to "Additional Asset Directories to Cook" so it is cooked.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAICoverBakeData : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	/*
+	Long package name of the map that was baked.
+	*/
+	UPROPERTY(VisibleAnywhere, Category = Cover)
+	FString MapPackageName = FString();
+
+	UPROPERTY(VisibleAnywhere, Category = Cover)
+	FName CoverTag = NAME_None;
+
+	UPROPERTY(VisibleAnywhere, Category = Cover)
+	float SlotSpacing = 100.0f;
+
+	/*
+	Every actor that has slots. One entry per actor, not per slot.
+	*/
+	UPROPERTY(VisibleAnywhere, Category = Cover)
+	TArray<TSoftObjectPtr<AActor>> CoverActors = {};
+
+	/*
+	Where each of CoverActors was when baked. Used to warn about stale bakes.
+	*/
+	UPROPERTY(VisibleAnywhere, Category = Cover)
+	TArray<FVector> CoverActorLocations = {};
+
+	/*
+	Not a UPROPERTY. Bulk serialized by Serialize().
+	*/
+	TArray<FUtilityBakedCoverSlot> Slots = {};
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	/*
+	True if this was baked before FUtilityAICoverBakeVersion::LatestVersion. Its slots are dropped on load, rerun the commandlet.
+	*/
+	bool IsOutdated() const { return LoadedVersion < FUtilityAICoverBakeVersion::LatestVersion; }
+
+	/*
+	Where the bake for MapPackageName and CoverTag lives, e.g. /Game/UtilityAI/CoverBakes/Arena_Cover
+	PIE prefixes are removed from MapPackageName.
+	*/
+	static FString GetBakePackageName(const FString& MapPackageName, FName CoverTag);
+
+private:
+
+	/*
+	FUtilityAICoverBakeVersion this was loaded with. Newly baked data is the latest.
+	*/
+	int32 LoadedVersion = FUtilityAICoverBakeVersion::LatestVersion;
+};
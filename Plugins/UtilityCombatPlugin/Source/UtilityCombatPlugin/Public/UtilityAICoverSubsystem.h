@@ -0,0 +1,339 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UtilityCombatDataStructures.h"
+#include "WorldCollision.h"
+#include "UtilityAICoverSubsystem.generated.h"
+
+class UUtilityAICoverBakeData;
+class ULevel;
+
+/*
+One place on the surface of a cover actor.
+*/
+struct FUtilityCoverSlot
+{
+	/*
+	On the surface of CoverActor.
+	*/
+	FVector Location = FVector::ZeroVector;
+
+	/*
+	Points out of the surface, away from CoverActor.
+	*/
+	FVector Normal = FVector::ZeroVector;
+
+	TWeakObjectPtr<AActor> CoverActor = nullptr;
+
+	/*
+	How tall CoverActor is. Low cover is crouch cover, tall cover is stand cover.
+	*/
+	float Height = 0.0f;
+};
+
+/*
+One agent's claim on a cover location.
+*/
+struct FUtilityCoverClaim
+{
+	FVector Location = FVector::ZeroVector;
+
+	/*
+	The CoverClaimCells cell it was added to. UtilityAI.Cover.ClaimRadius can change while it is claimed.
+	*/
+	FIntPoint Cell = FIntPoint::ZeroValue;
+
+	TWeakObjectPtr<const UObject> Claimant = nullptr;
+};
+
+/*
+Every cover slot for one cover tag, bucketed on a 2D grid so a radius query only looks at nearby cells.
+*/
+struct FUtilityCoverSpatialHash
+{
+	TArray<FUtilityCoverSlot> Slots = {};
+
+	/*
+	Grid cell -> indices into Slots.
+	*/
+	TMap<FIntPoint, TArray<int32>> Cells = {};
+
+	float CellSize = 1000.0f;
+
+	/*
+	Slots that were removed. Reused by AddSlot(), so the index of every other slot stays the same.
+	*/
+	TArray<int32> FreeSlots = {};
+
+	/*
+	Every actor with a slot in here.
+	*/
+	TSet<TWeakObjectPtr<AActor>> CoverActors = {};
+
+	void Reset(float InCellSize);
+
+	void AddSlot(const FUtilityCoverSlot& Slot);
+
+	/*
+	Removes every slot ShouldRemove returns true for. Returns how many were removed.
+	*/
+	int32 RemoveSlots(TFunctionRef<bool(const FUtilityCoverSlot&)> ShouldRemove);
+
+	int32 GetSlotCount() const { return Slots.Num() - FreeSlots.Num(); }
+
+	/*
+	Appends the index of every slot within Radius of Center to OutSlotIndices. Slots whose actor is gone are skipped.
+	*/
+	void QueryRadius(const FVector& Center, float Radius, TArray<int32>& OutSlotIndices) const;
+
+	FIntPoint GetCell(const FVector& Location) const;
+};
+
+/*
+Whether a cover location can be seen from a focus location. UNKNOWN until the trace comes back.
+*/
+enum class EUtilityCoverVisibility : uint8 {UNKNOWN, VISIBLE, HIDDEN};
+
+/*
+Cover cell and focus cell of one line of sight check.
+*/
+struct FUtilityCoverVisibilityKey
+{
+	FIntVector CoverCell = FIntVector::ZeroValue;
+
+	FIntVector FocusCell = FIntVector::ZeroValue;
+
+	bool operator==(const FUtilityCoverVisibilityKey& Other) const
+	{
+		return CoverCell == Other.CoverCell && FocusCell == Other.FocusCell;
+	}
+
+	friend uint32 GetTypeHash(const FUtilityCoverVisibilityKey& Key)
+	{
+		return HashCombine(GetTypeHash(Key.CoverCell),GetTypeHash(Key.FocusCell));
+	}
+};
+
+/*
+Cached result of one line of sight check.
+*/
+struct FUtilityCoverVisibilityEntry
+{
+	/*
+	World time the trace was submitted. The entry expires UtilityAI.Cover.VisibilityMaxAge after this.
+	*/
+	double TraceTime = -1.0;
+
+	EUtilityCoverVisibility Visibility = EUtilityCoverVisibility::UNKNOWN;
+
+	/*
+	True while the async trace hasn't come back.
+	*/
+	bool bPending = false;
+};
+
+/*
+Knows where all the cover is, so UUtilityAIManagerComponent doesn't have to rediscover it with line traces.
+
+Managers with CoverSearchMode = SPATIAL_INDEX ask for the slots near them with QueryCoverSlots().
+The UUtilityAICoverBakeData for the map and a tag, if there is one, is loaded in the background when a manager 
+with that ValidCoverPointTag begins play, see RequestCoverBake(). Queries find no slots until it is in.
+Otherwise the first query for a cover tag gathers every actor with that tag, and generates slots along their collision bounds.
+Actors spawned later with an indexed tag are added when they spawn, and those of streamed in levels when the level is added.
+Cover actors are removed when they are destroyed or their level is removed. Cover actors are assumed not to move.
+
+It is also the cover reservation table. An agent claims the cover it is heading to, and the cover searches 
+of every other agent skip anything within UtilityAI.Cover.ClaimRadius of it, so a squad spreads out instead of 
+piling onto the same spot. Claims work for every ECoverSearchMode, they are just locations.
+
+It also caches whether cover can be seen from where the focus is, see QueryCoverVisibility(). Cover and focus locations 
+are snapped to cells, so every agent hiding from the same focus shares the same async traces.
+
+Tune with:
+UtilityAI.Cover.SlotSpacing
+UtilityAI.Cover.CellSize
+UtilityAI.Cover.BakePath
+UtilityAI.Cover.StaleDistance
+UtilityAI.Cover.ClaimRadius
+UtilityAI.Cover.VisibilityCellSize
+UtilityAI.Cover.VisibilityMaxAge
+UtilityAI.Cover.VisibilityStandOff
+
+Compare search modes with "UtilityAI.Cover.Compare [ModeA] [ModeB]".
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAICoverSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	/*
+	Appends the index of every CoverTag slot within Radius of Center. Builds the index for CoverTag if this is the first query for it.
+	Appends nothing while the bake for CoverTag is loading.
+	*/
+	void QueryCoverSlots(FName CoverTag, const FVector& Center, float Radius, TArray<int32>& OutSlotIndices);
+
+	/*
+	Slot from an index QueryCoverSlots() gave back for the same CoverTag.
+	*/
+	const FUtilityCoverSlot& GetCoverSlot(FName CoverTag, int32 SlotIndex) const;
+
+	/*
+	Starts loading the bake of this map for CoverTag in the background, so no query has to wait on the disk.
+	True if it is loading. False if there is no bake, or CoverTag is already indexed or loading.
+	*/
+	bool RequestCoverBake(FName CoverTag);
+
+	/*
+	Adds the slots of CoverActor to every indexed tag it has, unless they are there already. 
+	Called for every spawned actor, and every actor of a level that is streamed in.
+	*/
+	void AddCoverActor(AActor* CoverActor);
+
+	/*
+	Removes the slots of CoverActor from every indexed tag. Called when a cover actor is destroyed.
+	*/
+	void RemoveCoverActor(const AActor* CoverActor);
+
+	/*
+	Regathers every indexed tag from the world, ignoring bakes. Call after moving cover actors around.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Cover)
+	void RebuildCoverIndex();
+
+	/*
+	Number of slots across every indexed tag.
+	*/
+	UFUNCTION(BlueprintPure, Category = Cover)
+	int32 GetCoverSlotCount() const;
+
+	/*
+	Slots along the collision bounds of CoverActor, SlotSpacing apart.
+	*/
+	static void GenerateCoverSlots(AActor* CoverActor, float SlotSpacing, TArray<FUtilityCoverSlot>& OutSlots);
+
+	/*
+	Claims Location for Claimant, releasing whatever Claimant had claimed before.
+	False if another claimant already has cover within UtilityAI.Cover.ClaimRadius.
+	*/
+	bool ClaimCover(const UObject* Claimant, const FVector& Location);
+
+	void ReleaseCover(const UObject* Claimant);
+
+	/*
+	True if someone other than Claimant has claimed cover within UtilityAI.Cover.ClaimRadius of Location.
+	*/
+	bool IsCoverClaimedByOther(const FVector& Location, const UObject* Claimant) const;
+
+	UFUNCTION(BlueprintPure, Category = Cover)
+	int32 GetCoverClaimCount() const { return ClaimLocations.Num(); }
+
+	/*
+	Can someone at FocusLocation see an agent hiding behind the cover at CoverLocation? A hash lookup.
+	If the cached answer is missing or older than UtilityAI.Cover.VisibilityMaxAge, an async trace is submitted 
+	and the old answer, or UNKNOWN, is returned until it comes back.
+	Only WorldStatic and WorldDynamic objects hide the spot, pawns in the way don't.
+	*/
+	EUtilityCoverVisibility QueryCoverVisibility(const FVector& CoverLocation, const FVector& FocusLocation);
+
+	UFUNCTION(BlueprintPure, Category = Cover)
+	int32 GetCoverVisibilityCacheSize() const { return VisibilityCache.Num(); }
+
+	/*
+	Runs a ModeA and a ModeB cover search for every registered manager, and logs traces per search, time, and how the cover found differs.
+	Also the "UtilityAI.Cover.Compare [ModeA=SWEEP] [ModeB=ADAPTIVE_SWEEP]" console command.
+	*/
+	void CompareCoverSearchModes(ECoverSearchMode ModeA, ECoverSearchMode ModeB) const;
+
+protected:
+
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	/*
+	Gathers every actor with CoverTag into CoverIndices.
+	*/
+	FUtilityCoverSpatialHash& BuildCoverIndex(FName CoverTag);
+
+	void OnCoverBakeLoaded(const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result, FName CoverTag);
+
+	/*
+	Fills CoverIndex from BakeData. Slots of actors that aren't loaded are left out, their level adds them when it streams in.
+	False if the bake is from an older version of the plugin.
+	*/
+	bool ApplyCoverBake(const UUtilityAICoverBakeData& BakeData, FUtilityCoverSpatialHash& CoverIndex);
+
+	/*
+	Warns if cover actors moved, went away, or were added since BakeData was baked.
+	*/
+	void WarnIfCoverBakeStale(const UUtilityAICoverBakeData& BakeData, const TArray<AActor*>& BakedActors) const;
+
+	void OnActorSpawned(AActor* SpawnedActor);
+
+	/*
+	Removes the slots of CoverActor when it is destroyed. Bound for every actor that gets slots.
+	*/
+	void WatchCoverActor(AActor* CoverActor);
+
+	UFUNCTION()
+	void OnCoverActorDestroyed(AActor* DestroyedActor);
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	/*
+	One index per cover tag a manager asked for.
+	*/
+	TMap<FName, FUtilityCoverSpatialHash> CoverIndices = {};
+
+	/*
+	Cover tags whose bake is loading.
+	*/
+	TSet<FName> PendingCoverBakes = {};
+
+	FDelegateHandle ActorSpawnedHandle;
+
+	FDelegateHandle LevelAddedHandle;
+
+	FDelegateHandle LevelRemovedHandle;
+
+	FIntPoint GetClaimCell(const FVector& Location) const;
+
+	/*
+	Claims bucketed on a grid of UtilityAI.Cover.ClaimRadius, so a check only looks at the 9 cells around it.
+	*/
+	TMap<FIntPoint, TArray<FUtilityCoverClaim, TInlineAllocator<2>>> CoverClaimCells = {};
+
+	/*
+	Claimant -> its one claim.
+	*/
+	TMap<TWeakObjectPtr<const UObject>, FUtilityCoverClaim> ClaimLocations = {};
+
+	void OnVisibilityTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+	/*
+	Drops entries that expired long ago, so the cache doesn't grow forever.
+	*/
+	void PruneVisibilityCache(double WorldTime);
+
+	FIntVector GetVisibilityCell(const FVector& Location) const;
+
+	TMap<FUtilityCoverVisibilityKey, FUtilityCoverVisibilityEntry> VisibilityCache = {};
+
+	/*
+	FTraceHandle::_Handle of each trace in flight -> the entry it fills.
+	*/
+	TMap<uint64, FUtilityCoverVisibilityKey> PendingVisibilityTraces = {};
+
+	FTraceDelegate VisibilityTraceDelegate;
+
+	double LastVisibilityPruneTime = 0.0;
+};
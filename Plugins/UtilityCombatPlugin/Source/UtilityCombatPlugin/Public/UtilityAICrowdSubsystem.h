@@ -0,0 +1,314 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UtilityCombatDataStructures.h"
+#include "UtilityTaskDefinition.h"
+#include "UtilityAICrowdSubsystem.generated.h"
+
+class AAIController;
+class APawn;
+
+/*
+A crowd agent. Only valid in the subsystem that made it.
+*/
+USTRUCT(BlueprintType)
+struct UTILITYCOMBATPLUGIN_API FUtilityCrowdAgentHandle
+{
+	GENERATED_BODY()
+
+	/*
+	Index of the agent's archetype in UUtilityAICrowdSubsystem.
+	*/
+	UPROPERTY()
+	int32 Group = INDEX_NONE;
+
+	/*
+	Never reused, so a handle to a removed agent stays invalid.
+	*/
+	UPROPERTY()
+	int32 Id = INDEX_NONE;
+
+	bool IsValid() const
+	{
+		return Group != INDEX_NONE && Id != INDEX_NONE;
+	}
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FUtilityCrowdTaskEvent, FUtilityCrowdAgentHandle, Agent, FName, TaskName);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FUtilityCrowdPromotedEvent, FUtilityCrowdAgentHandle, Agent, AAIController*, Controller);
+
+/*
+What a crowd agent knows about the world. Everything a worker thread reads of it is copied in on the game thread.
+*/
+struct FUtilityCrowdAgent
+{
+	FVector Location = FVector(0.0f,0.0f,0.0f);
+
+	/*
+	Optional. If set, Location follows it, and it is the pawn that gets possessed on promotion.
+	*/
+	TWeakObjectPtr<APawn> Pawn = nullptr;
+
+	TWeakObjectPtr<AActor> Focus = nullptr;
+
+	/*
+	Copied from UUtilityAIDecisionSubsystem::GetFocusFacts() before each decision.
+	*/
+	FUtilityFocusFacts FocusFacts;
+
+	bool bHasFocus = false;
+
+	bool bCurrentPointOfInterestSet = false;
+
+	FVector CurrentPointOfInterest = FVector(0.0f,0.0f,0.0f);
+};
+
+/*
+A task a crowd agent entered or exited. Broadcast once every group has decided.
+*/
+struct FUtilityCrowdPendingTaskEvent
+{
+	FUtilityCrowdAgentHandle Agent;
+
+	FName TaskName = NAME_None;
+
+	bool bEnter = false;
+};
+
+/*
+Every agent of one UUtilityTaskArchetype. The per agent arrays are indexed by slot, and are contiguous:
+removing an agent moves the last agent into its slot.
+*/
+struct FUtilityCrowdGroup
+{
+	UUtilityTaskArchetype* Archetype = nullptr;
+
+	/*
+	The archetype's tasks, without the empty entries. Same order as a manager's TaskDefinitions.
+	*/
+	TArray<const UUtilityTaskDefinition*> Tasks = {};
+
+	/*
+	Compiled once, shared by every agent. Only read while scoring, see FUtilityConsiderationTable::EvaluateConsiderationAt()
+	*/
+	FUtilityConsiderationTable ConsiderationTable;
+
+	/*
+	Same order as Tasks. Index of each task's TaskLayer in Layers.
+	*/
+	TArray<int32> TaskLayerIndices = {};
+
+	TArray<int32> Layers = {};
+
+	/*
+	PER AGENT
+	*/
+
+	TArray<FUtilityCrowdAgent> Agents = {};
+
+	/*
+	Normalized STAT_BY_FNAME values. ConsiderationTable.StatNames.Num() per agent.
+	*/
+	TArray<float> StatValues = {};
+
+	/*
+	Tasks.Num() per agent.
+	*/
+	TArray<FUtilityTaskRuntimeState> TaskStates = {};
+
+	TArray<float> TaskScores = {};
+
+	/*
+	Layers.Num() per agent. Index into Tasks, INDEX_NONE if the layer never started a task.
+	*/
+	TArray<int32> CurrentTaskIndices = {};
+
+	TArray<int32> BestTaskIndices = {};
+
+	TArray<int32> IdOfSlot = {};
+
+	TMap<int32, int32> SlotOfId = {};
+
+	/*
+	DECISIONS
+	Next slot to decide. Agents decide round-robin, DecisionInterval apart.
+	*/
+	int32 Cursor = 0;
+
+	/*
+	Fraction of an agent owed to the next tick.
+	*/
+	float DecisionCarry = 0.0f;
+
+	/*
+	Slots deciding this tick, and whether each is near enough a player to be promoted. Kept around so they don't reallocate.
+	*/
+	TArray<int32> DecidingSlots = {};
+
+	TArray<uint8> PromoteFlags = {};
+
+	int32 GetNumStats() const { return ConsiderationTable.StatNames.Num(); }
+};
+
+/*
+Utility AI for agents that don't need an AI controller of their own, like background combatants.
+
+A crowd agent is a FUtilityCrowdAgent and its task state, in the contiguous arrays of its archetype's FUtilityCrowdGroup.
+Tasks are the UUtilityTaskDefinitions of a UUtilityTaskArchetype, scored with the same curves and ECurveInputQuery
+inputs as a UUtilityAIManagerComponent would. There is no cover search, crouching or weapons, so those queries are 0.
+
+Each tick, every archetype decides for the agents that are due, spread evenly over its DecisionInterval:
+their focus is read on the game thread, they are scored on worker threads with ParallelFor,
+then tasks are entered and exited on the game thread, broadcasting OnCrowdTaskEnter and OnCrowdTaskExit.
+
+Agents that come within PromotionDistance of a player pawn, or that PromoteAgent() is called for,
+get an AI controller with a UUtilityAIManagerComponent running the same archetype, and keep their cooldowns and running tasks.
+
+Tune with:
+UtilityAI.Crowd.Enabled
+UtilityAI.Crowd.ParallelBatchSize
+
+Watch with "stat UtilityAI" or the UtilityAI CSV category.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAICrowdSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	/*
+	Called whenever a crowd agent begins a task
+	*/
+	UPROPERTY(BlueprintAssignable)
+	FUtilityCrowdTaskEvent OnCrowdTaskEnter;
+
+	/*
+	Called whenever a crowd agent ends a task
+	*/
+	UPROPERTY(BlueprintAssignable)
+	FUtilityCrowdTaskEvent OnCrowdTaskExit;
+
+	/*
+	Called when a crowd agent has been promoted, after it was removed from the crowd.
+	*/
+	UPROPERTY(BlueprintAssignable)
+	FUtilityCrowdPromotedEvent OnAgentPromoted;
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	FUtilityCrowdAgentHandle AddAgent(UUtilityTaskArchetype* Archetype, FVector Location, APawn* Pawn = nullptr);
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void RemoveAgent(FUtilityCrowdAgentHandle Agent);
+
+	UFUNCTION(BlueprintPure, Category = Crowd)
+	bool IsAgentValid(FUtilityCrowdAgentHandle Agent) const;
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void SetAgentLocation(FUtilityCrowdAgentHandle Agent, FVector Location);
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void SetAgentFocus(FUtilityCrowdAgentHandle Agent, AActor* Focus);
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void SetAgentPointOfInterest(FUtilityCrowdAgentHandle Agent, bool bIsSet, FVector PointOfInterest);
+
+	/*
+	Value is already normalized, like IUtilityAIManagerToPawnInterface::GetNormalizedStat() returns.
+	Stats none of the archetype's curves use are ignored.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void SetAgentStat(FUtilityCrowdAgentHandle Agent, FName StatName, float Value);
+
+	/*
+	Same as UUtilityAIManagerComponent::FinishTask()
+	*/
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	void FinishAgentTask(FUtilityCrowdAgentHandle Agent, FName TaskName);
+
+	/*
+	The task the agent runs on TaskLayer. NAME_None if none.
+	*/
+	UFUNCTION(BlueprintPure, Category = Crowd)
+	FName GetAgentTask(FUtilityCrowdAgentHandle Agent, int32 TaskLayer) const;
+
+	/*
+	Gives the agent an AI controller and a pawn, and removes it from the crowd. See FUtilityCrowdSettings.
+	If the controller has no UUtilityAIManagerComponent, one is added with bUseDecisionScheduler = true so the agent keeps deciding.
+	Returns nullptr if the agent has no pawn and its archetype no PawnClass.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	AAIController* PromoteAgent(FUtilityCrowdAgentHandle Agent);
+
+	UFUNCTION(BlueprintPure, Category = Crowd)
+	int32 GetAgentCount() const;
+
+protected:
+
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	/*
+	The group of Archetype, made and compiled the first time it is used.
+	*/
+	int32 FindOrAddGroup(UUtilityTaskArchetype* Archetype);
+
+	/*
+	The agent's group and slot. False if the handle is stale.
+	*/
+	bool FindAgent(const FUtilityCrowdAgentHandle& Agent, FUtilityCrowdGroup*& OutGroup, int32& OutSlot);
+
+	bool FindAgent(const FUtilityCrowdAgentHandle& Agent, const FUtilityCrowdGroup*& OutGroup, int32& OutSlot) const;
+
+	/*
+	Picks the group's due agents, and copies their pawn locations and focus facts. Game thread.
+	*/
+	void GatherDecidingAgents(FUtilityCrowdGroup& Group, float DeltaTime);
+
+	/*
+	Scores one agent into BestTaskIndices, and flags it for promotion. Only touches the agent's slot, safe on a worker thread.
+	*/
+	void ScoreAgent(FUtilityCrowdGroup& Group, int32 DecidingIndex, double WorldTime) const;
+
+	/*
+	Same rules as UUtilityAIManagerComponent::ChangeTasksOnLayers(), with its default settings. Game thread.
+	*/
+	void ApplyBestTasks(FUtilityCrowdGroup& Group, int32 GroupIndex, int32 Slot, double WorldTime);
+
+	/*
+	Fills the ECurveInputQuery inputs of OutSnapshot from Agent.
+	*/
+	static void CaptureAgentInputs(const FUtilityCrowdAgent& Agent, const FUtilityCrowdSettings& Settings, FUtilityDecisionSnapshot& OutSnapshot);
+
+	TArray<FUtilityCrowdGroup> Groups = {};
+
+	/*
+	Same order as Groups. Keeps the archetypes loaded.
+	*/
+	UPROPERTY(Transient)
+	TArray<UUtilityTaskArchetype*> GroupArchetypes = {};
+
+	int32 NextAgentId = 0;
+
+	/*
+	Copied from UUtilityAIDecisionSubsystem::GetPlayerPawnLocations() each tick, for the worker threads.
+	*/
+	TArray<FVector> PlayerPawnLocations = {};
+
+	/*
+	Task changes and promotions found this tick. Delegates and spawning can run Blueprint that adds or removes agents, 
+	so they wait until every group has decided.
+	*/
+	TArray<FUtilityCrowdPendingTaskEvent> PendingTaskEvents = {};
+
+	TArray<FUtilityCrowdAgentHandle> PendingPromotions = {};
+};
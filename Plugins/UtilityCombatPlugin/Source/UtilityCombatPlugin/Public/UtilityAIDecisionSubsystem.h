@@ -0,0 +1,189 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UtilityCombatDataStructures.h"
+#include "UtilityAIDecisionSubsystem.generated.h"
+
+class UUtilityAIManagerComponent;
+
+/*
+Book keeping for one registered manager.
+*/
+struct FUtilityScheduledManager
+{
+	TWeakObjectPtr<UUtilityAIManagerComponent> Manager = nullptr;
+
+	/*
+	World time in seconds when this manager wants its next decision.
+	*/
+	double NextDecisionTime = 0.0;
+
+	/*
+	How many frames in a row this manager was due but didn't fit in the budget.
+	*/
+	int32 FramesDeferred = 0;
+};
+
+/*
+A manager that is due for a decision this frame.
+*/
+struct FUtilityDueManager
+{
+	int32 RegisteredIndex = INDEX_NONE;
+
+	float Priority = 0.0f;
+};
+
+/*
+Every UUtilityAIManagerComponent registers itself here when Initialize() is called.
+
+Managers with bUseDecisionScheduler = true have DetermineBestTask() called for them by this subsystem,
+instead of each AI controller calling it on its own timer.
+Decisions are time sliced. Each frame, due managers are run round-robin until UtilityAI.Scheduler.BudgetMs is used up.
+Managers that didn't fit are deferred to the next frame, and get older, so they go first next time.
+Managers with a ControllerFocus get a priority boost, since they are likely in combat.
+Managers with bUseEventDrivenDecisions = true are only due when UUtilityAIManagerComponent::HasDecisionEvent() says so,
+or their EventHeartbeatInterval is up.
+
+Facts about each focus (location, velocity, and the IUtilityAIManagerToPawnInterface attack queries) are gathered 
+once per frame here and shared by every manager with that focus, see GetFocusFacts().
+
+Due managers are decided in batches: every manager in the batch is snapshot on the game thread, 
+then scored on worker threads with ParallelFor, then their task changes are applied on the game thread.
+
+Tune with:
+UtilityAI.Scheduler.BudgetMs
+UtilityAI.Scheduler.MinDecisionsPerFrame
+UtilityAI.Scheduler.FocusPriorityBoost
+UtilityAI.Scheduler.BatchSize
+UtilityAI.Scheduler.ParallelScoring
+
+Watch with "stat UtilityAI" or the UtilityAI CSV category.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAIDecisionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	/*
+	Called from UUtilityAIManagerComponent::Initialize(). Safe to call more than once.
+	*/
+	void RegisterManager(UUtilityAIManagerComponent* Manager);
+
+	/*
+	Called from UUtilityAIManagerComponent::EndPlay()
+	*/
+	void UnregisterManager(UUtilityAIManagerComponent* Manager);
+
+	/*
+	Every manager that is currently registered, scheduled or not.
+	*/
+	void GetRegisteredManagers(TArray<UUtilityAIManagerComponent*>& OutManagers) const;
+
+	/*
+	Number of registered managers that the scheduler drives.
+	*/
+	UFUNCTION(BlueprintPure, Category = Scheduler)
+	int32 GetScheduledManagerCount() const;
+
+	/*
+	How many due managers were waiting at the start of the last tick.
+	*/
+	UFUNCTION(BlueprintPure, Category = Scheduler)
+	int32 GetLastQueueDepth() const { return LastQueueDepth; }
+
+	/*
+	How many due managers didn't fit in the budget on the last tick.
+	*/
+	UFUNCTION(BlueprintPure, Category = Scheduler)
+	int32 GetLastDeferredCount() const { return LastDeferredCount; }
+
+	/*
+	Logs the Count most expensive agents and tasks over the last Seconds (at most FUtilityCostHistory::NumBuckets).
+	Tasks are only listed while UtilityAI.Profiling.TaskCostHistory is 1.
+	Also the "UtilityAI.DumpTopAgents [Count] [Seconds]" console command.
+	*/
+	void DumpTopAgents(int32 Count, float Seconds) const;
+
+	/*
+	Location of every player controlled pawn. Gathered at most once per frame, for decision LOD.
+	*/
+	const TArray<FVector>& GetPlayerPawnLocations();
+
+	/*
+	Facts about Focus, gathered at most once per frame no matter how many managers focus it.
+	bOutGathered is true if this call did the gathering, and so made the Blueprint calls.
+	*/
+	const FUtilityFocusFacts& GetFocusFacts(AActor* Focus, bool& bOutGathered);
+
+	/*
+	Makes the next GetFocusFacts() for Focus gather again, even in the same frame. 
+	Call it when the focus starts or stops attacking, if managers deciding later this frame need to know.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Focus)
+	void InvalidateFocusFacts(AActor* Focus);
+
+	/*
+	Gathers the facts about Focus. Makes 2 Blueprint calls if Focus implements IUtilityAIManagerToPawnInterface.
+	*/
+	static void GatherFocusFacts(AActor* Focus, FUtilityFocusFacts& OutFacts);
+
+protected:
+
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+	/*
+	Snapshot every manager in DecisionBatch on the game thread, score them in parallel, then apply on the game thread.
+	*/
+	void RunDecisionBatch();
+
+	/*
+	Priority of a due manager. Bigger goes first.
+	*/
+	float GetDecisionPriority(const FUtilityScheduledManager& Entry, const UUtilityAIManagerComponent* Manager, double WorldTime) const;
+
+	TArray<FUtilityScheduledManager> RegisteredManagers = {};
+
+	/*
+	Rebuilt every tick. Kept around so it doesn't reallocate.
+	*/
+	TArray<FUtilityDueManager> DueQueue = {};
+
+	/*
+	Managers being decided together. Only valid during Tick().
+	*/
+	TArray<UUtilityAIManagerComponent*> DecisionBatch = {};
+
+	/*
+	True while Tick() is running decisions. Unregistering only clears the entry while this is true,
+	so the indices in DueQueue stay valid.
+	*/
+	bool bIsRunningDecisions = false;
+
+	int32 LastQueueDepth = 0;
+
+	int32 LastDeferredCount = 0;
+
+	TArray<FVector> PlayerPawnLocations = {};
+
+	/*
+	GFrameCounter when PlayerPawnLocations was gathered.
+	*/
+	uint64 PlayerPawnLocationsFrame = 0;
+
+	/*
+	Cleaned of destroyed foci every tick.
+	*/
+	TMap<TWeakObjectPtr<AActor>, FUtilityFocusFacts> FocusFacts = {};
+};
@@ -0,0 +1,157 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UUtilityAIManagerComponent;
+
+/*
+What every record of one agent's trace is laid out from. Written once at the start of a trace file.
+Changes whenever the manager is initialized again, which starts a new trace.
+*/
+struct UTILITYCOMBATPLUGIN_API FUtilityDecisionTraceLayout
+{
+	FString AgentName = FString();
+
+	/*
+	PER TASK
+	*/
+
+	TArray<FName> TaskNames = {};
+
+	/*
+	Index into Layers. INDEX_NONE for a task that was never given to the manager.
+	*/
+	TArray<int32> TaskLayerIndices = {};
+
+	TArray<int32> TaskFirstConsideration = {};
+
+	TArray<int32> TaskConsiderationCount = {};
+
+	/*
+	PER CONSIDERATION
+	*/
+
+	/*
+	An ECurveInputQuery.
+	*/
+	TArray<uint8> InputQueries = {};
+
+	/*
+	Index into StatNames if the input query is STAT_BY_FNAME. Otherwise INDEX_NONE.
+	*/
+	TArray<int32> StatIndices = {};
+
+	TArray<FName> StatNames = {};
+
+	/*
+	TaskLayer of each layer.
+	*/
+	TArray<int32> Layers = {};
+
+	int32 NumConsiderations = 0;
+
+	/*
+	Bytes in one record: WorldTime, frame, each consideration's input and output, each task's score, and the best and current task of each layer.
+	*/
+	int32 GetRecordSize() const;
+
+	void Serialize(FArchive& Ar);
+};
+
+/*
+Fixed size ring buffer of one agent's last decisions. Nothing is allocated once Start() has sized it.
+*/
+struct UTILITYCOMBATPLUGIN_API FUtilityDecisionTraceRecorder
+{
+	FUtilityDecisionTraceLayout Layout;
+
+	/*
+	Capacity records of Layout.GetRecordSize() bytes each.
+	*/
+	TArray<uint8> Buffer = {};
+
+	int32 Capacity = 0;
+
+	/*
+	Record the next decision goes into.
+	*/
+	int32 Head = 0;
+
+	int32 NumRecords = 0;
+
+	/*
+	Drops every record and sizes the buffer for InCapacity records of InLayout.
+	False, and not recording, if InLayout has more tasks than a record's int16 task indices can hold.
+	*/
+	bool Start(const FUtilityDecisionTraceLayout& InLayout, int32 InCapacity);
+
+	/*
+	Frees the buffer.
+	*/
+	void Stop();
+
+	bool IsRecording() const { return Capacity > 0; }
+
+	/*
+	Overwrites the oldest record once the buffer is full. Every array must be the size Layout says.
+	*/
+	void Record(double WorldTime, uint64 Frame, const float* Inputs, const float* Outputs, const float* TaskScores, const int32* BestTaskIndices, const int32* CurrentTaskIndices);
+
+	/*
+	Writes Layout and every record, oldest first.
+	*/
+	bool SaveToFile(const FString& Filename) const;
+};
+
+/*
+A trace loaded back from a file, see FUtilityDecisionTraceRecorder::SaveToFile(). Used by the trace viewer.
+*/
+struct UTILITYCOMBATPLUGIN_API FUtilityDecisionTraceFile
+{
+	static constexpr uint32 Magic = 0x54444155; //"UADT"
+
+	static constexpr uint32 Version = 1;
+
+	FUtilityDecisionTraceLayout Layout;
+
+	/*
+	NumRecords records, oldest first.
+	*/
+	TArray<uint8> Records = {};
+
+	int32 NumRecords = 0;
+
+	bool LoadFromFile(const FString& Filename);
+
+	double GetWorldTime(int32 RecordIndex) const;
+
+	uint64 GetFrame(int32 RecordIndex) const;
+
+	float GetInput(int32 RecordIndex, int32 ConsiderationIndex) const;
+
+	float GetOutput(int32 RecordIndex, int32 ConsiderationIndex) const;
+
+	float GetTaskScore(int32 RecordIndex, int32 TaskIndex) const;
+
+	/*
+	Task that scored best on the layer, or INDEX_NONE if none reached the threshold.
+	*/
+	int32 GetBestTaskIndex(int32 RecordIndex, int32 LayerIndex) const;
+
+	/*
+	Task running on the layer once the decision was applied, or INDEX_NONE.
+	*/
+	int32 GetCurrentTaskIndex(int32 RecordIndex, int32 LayerIndex) const;
+
+protected:
+
+	template<typename T>
+	T ReadValue(int32 RecordIndex, int32 Offset) const
+	{
+		T Value;
+		FMemory::Memcpy(&Value, Records.GetData() + RecordIndex*Layout.GetRecordSize() + Offset, sizeof(T));
+		return Value;
+	}
+};
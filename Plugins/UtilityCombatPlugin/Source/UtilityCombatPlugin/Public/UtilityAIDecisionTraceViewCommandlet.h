@@ -0,0 +1,40 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "UtilityAIDecisionTraceViewCommandlet.generated.h"
+
+struct FUtilityDecisionTraceFile;
+
+/*
+Prints a decision trace written by "UtilityAI.Trace.Dump" or UUtilityAIManagerComponent::DumpDecisionTrace(). Needs no world.
+
+UnrealEditor-Cmd Project.uproject -run=UtilityAIDecisionTraceView -File=Saved/UtilityAITraces/<time>/<Controller>.uadt [-Last=20] [-Csv=Out.csv]
+
+Prints the last -Last decisions: the tasks picked on each layer, every task's score, and each consideration's input and output.
+-Csv writes every decision, one row per consideration, for a spreadsheet.
+Tasks that couldn't win with early exit scoring show a score of 0, and their skipped considerations show their last outputs.
+*/
+UCLASS()
+class UTILITYCOMBATPLUGIN_API UUtilityAIDecisionTraceViewCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UUtilityAIDecisionTraceViewCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+
+	void PrintRecord(const FUtilityDecisionTraceFile& Trace, int32 RecordIndex) const;
+
+	bool WriteCsv(const FUtilityDecisionTraceFile& Trace, const FString& CsvPath) const;
+
+	FString GetTaskName(const FUtilityDecisionTraceFile& Trace, int32 TaskIndex) const;
+
+	FString GetInputName(const FUtilityDecisionTraceFile& Trace, int32 ConsiderationIndex) const;
+};
@@ -5,15 +5,23 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "UtilityCombatDataStructures.h"
+#include "UtilityAINativeStatProvider.h"
+#include "StatDataStructures.h"
+#include "UtilityAIDecisionTrace.h"
+#include "UtilityTaskDefinition.h"
+#include "WorldCollision.h"
 #include "UtilityAIManagerComponent.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FUtilityTaskEvent, FName, TaskName);
 
 class UUtilityCombatTaskComponent;
+class UUtilityNativeTaskComponent;
 class APawn;
 class AAIController;
 class UCharacterMovementComponent;
 class UPawnMovementComponent;
+class UUtilityAICoverSubsystem;
+class UDamageType;
 
 /*
 Determines which tasks are the best to do. 
@@ -33,10 +41,16 @@ protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 	/*
 	DELEGATES
 	*/
@@ -79,6 +93,24 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
 	bool bShowDebugWarnings = false;
 
+	/*
+	If true, the last DecisionTraceCapacity decisions are kept in DecisionTrace: each consideration's input and output, 
+	each task's score, and the tasks picked. Set at runtime with StartDecisionTrace() or "UtilityAI.Trace.Start".
+	Costs nothing while false. The buffer is allocated when recording starts, never by a decision.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Debug)
+	bool bRecordDecisionTrace = false;
+
+	/*
+	If true, WriteDebugValues() runs after every decision, so FinalNormalizedUtilityValue and CurveOutput of the task components 
+	stay current in the details panel and Blueprint. Costs a pass over every consideration per decision.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug)
+	bool bWriteDebugValuesEveryDecision = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Debug, meta = (ClampMin = 1))
+	int32 DecisionTraceCapacity = 512;
+
 	/*
 	Refers to whether DistanceToFocusLastDetectedPoint has been set
 	*/
@@ -124,6 +156,8 @@ public:
 
 	/*
 	CurrentTasks in progress. 
+	Kept for Blueprint and the details panel. Scoring uses CurrentTaskIndices, this is only written when a layer starts a new task.
+	Layers running a task of TaskArchetype aren't in here.
 	*/
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly, Transient, Category = Manager)
 	TMap<int32,UUtilityCombatTaskComponent*> CurrentTasks = {};
@@ -136,17 +170,37 @@ public:
 	AAIController* OwnerController = nullptr;
 
 	/*
-	All possible layers that tasks can run
+	All possible layers that tasks can run. 
+	The index of a layer in this array is its dense layer index, used by every per layer array below.
 	*/
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly, Transient, Category = Manager)
 	TArray<int32> PossibleLayers = {};
 
 	/*
-	All the possible tasks.
+	The task components of the controller. Their task indices are the same as their index here.
 	*/
 	UPROPERTY(VisibleAnywhere, Transient, Category = Manager)
 	TArray<UUtilityCombatTaskComponent*> TaskArray = {};
 
+	/*
+	Tasks shared with every agent of the same kind, instead of a task component each. Copied to TaskDefinitions by Initialize().
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Manager)
+	UUtilityTaskArchetype* TaskArchetype = nullptr;
+
+	/*
+	The tasks of TaskArchetype. Their task indices come after TaskArray's, see GetTaskDefinition().
+	*/
+	UPROPERTY(VisibleAnywhere, Transient, Category = Manager)
+	TArray<UUtilityTaskDefinition*> TaskDefinitions = {};
+
+	/*
+	Same order as TaskDefinitions. Our cooldown and active flag for each of them.
+	Kept across Initialize() as long as the definitions don't change.
+	*/
+	UPROPERTY(VisibleAnywhere, Transient, Category = Manager)
+	TArray<FUtilityTaskRuntimeState> TaskStates = {};
+
 	/*
 	If true,  any task will be ended if its score is below the  TaskThreshold. 
 	If false, task will not be auto ended based on threshold.
@@ -170,6 +224,156 @@ public:
 	UPROPERTY(EditAnywhere,Category = Manager)
 	float TaskThreshold = 0.1f;
 
+	/*
+	If true, a task is only scored again when one of the inputs its curves use changed by more than ScoreCacheInputEpsilon,
+	when it comes off cooldown (or goes on), or when its score is older than ScoreCacheMaxAge. 
+	Otherwise the task's last score is reused.
+	Tasks with CalculateTaskScore() overridden in Blueprint or C++ are always scored.
+	Off by default: a reused score can be up to ScoreCacheMaxAge old, so turn it on where that is fine.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scoring)
+	bool bUseIncrementalScoring = false;
+
+	/*
+	How much a normalized input must change before the tasks that use it are scored again.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scoring, meta = (ClampMin = 0.0))
+	float ScoreCacheInputEpsilon = 0.005f;
+
+	/*
+	Seconds a cached score can be reused before the task is scored again anyway. 0 = no limit.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scoring, meta = (ClampMin = 0.0))
+	float ScoreCacheMaxAge = 1.0f;
+
+	/*
+	Number of task scores reused from the cache since Initialize()
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Scoring)
+	int32 ScoreCacheHits = 0;
+
+	/*
+	Number of tasks scored since Initialize()
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Scoring)
+	int32 ScoreCacheMisses = 0;
+
+	/*
+	If true, tasks that only multiply their curves stop scoring as soon as their running total falls below TaskThreshold,
+	or below the best score already found on their TaskLayer, since multiplying by 0-1 can only make it smaller.
+	Their curves are also reordered so the cheapest and most selective go first. Tasks that add a curve are always fully scored.
+	The winning tasks are the same either way, but a task that stopped early scores 0.0f instead of its real score.
+	That 0.0f is what TaskScores, decision traces and FinalNormalizedUtilityValue show, so this is off by default.
+	Changing this at runtime needs CompileConsiderationTable() to be called again.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scoring)
+	bool bUseEarlyExitScoring = false;
+
+	/*
+	Number of curve evaluations skipped by early exit since Initialize()
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Scoring)
+	int32 ConsiderationsSkipped = 0;
+
+	/*
+	STAT PROVIDER
+	If true, and the controlled pawn has no IUtilityAINativeStatProvider of its own, STAT_BY_FNAME queries are answered
+	by the pawn's UStatManager in C++, normalized from each stat's Minimum to Maximum.
+	Leave false if the pawn's GetNormalizedStat() normalizes its stats some other way.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Stats)
+	bool bReadStatsFromStatManager = false;
+
+	/*
+	If true, the UUtilityAIDecisionSubsystem calls DetermineBestTask() for us, inside its per frame budget.
+	Don't also call DetermineBestTask() from a timer or Blueprint event when this is on.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scheduler)
+	bool bUseDecisionScheduler = false;
+
+	/*
+	Only matters if bUseDecisionScheduler = true
+	Seconds between decisions. If the scheduler is over budget, the decision can come a few frames late.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scheduler)
+	float DecisionInterval = 0.5f;
+
+	/*
+	Only matters if bUseDecisionScheduler = true
+	If true, we decide when something happened that could change the best task, instead of every DecisionInterval:
+	the controller's focus changes, a current task sets bIsTaskActive = false, a task comes off cooldown, 
+	a stat our curves use changes on the pawn's UStatManager, the pawn takes damage, or RequestDecision() is called.
+	Everything that happens before the decision runs is one decision. Idle agents only decide every EventHeartbeatInterval.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scheduler)
+	bool bUseEventDrivenDecisions = false;
+
+	/*
+	Only matters if bUseEventDrivenDecisions = true
+	Seconds between decisions when nothing happens. A safety net for changes no event covers, like distances.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scheduler, meta = (ClampMin = 0.0))
+	float EventHeartbeatInterval = 3.0f;
+
+	/*
+	Only matters if bUseEventDrivenDecisions = true
+	Events that come sooner than this after the last decision wait for it, so a stat changing every frame doesn't decide every frame.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Scheduler, meta = (ClampMin = 0.0))
+	float MinEventDecisionInterval = 0.1f;
+
+	/*
+	Set by RequestDecision() and the stat and damage events. Cleared when the decision runs.
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Scheduler)
+	bool bDecisionRequested = false;
+
+	/*
+	Earliest world time a task that was on cooldown at the last decision comes off it. 0.0 if none.
+	*/
+	double NextCooldownExpiry = 0.0;
+
+	/*
+	The pawn whose OnStatModified and OnTakeAnyDamage we are bound to.
+	*/
+	TWeakObjectPtr<APawn> DecisionEventPawn = nullptr;
+
+	/*
+	DECISION LOD
+	If true, DecisionLODTiers picks how often and how carefully we decide, from the distance to the nearest player pawn.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+	bool bUseDecisionLOD = false;
+
+	/*
+	Nearest first, sorted by MaxPlayerDistance. See FUtilityDecisionLODTier.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+	TArray<FUtilityDecisionLODTier> DecisionLODTiers = {};
+
+	/*
+	Fraction of a tier's MaxPlayerDistance we have to go past before changing tier, so agents near a boundary don't flap.
+	0.1 = leave a 3000 tier at 3300, come back in at 2700.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD, meta = (ClampMin = 0.0, ClampMax = 0.9))
+	float DecisionLODHysteresis = 0.1f;
+
+	/*
+	An agent whose pawn was rendered in the last RecentlyRenderedSeconds never goes past this tier. -1 = ignore rendering.
+	Never true on a dedicated server.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+	int32 RecentlyRenderedMaxLODTier = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD, meta = (ClampMin = 0.0))
+	float RecentlyRenderedSeconds = 1.0f;
+
+	/*
+	Index into DecisionLODTiers we are in. INDEX_NONE if LOD is off.
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = LOD)
+	int32 CurrentDecisionLOD = INDEX_NONE;
+
 
 	/*
 	What Range do we begin to swap to melee
@@ -217,6 +421,14 @@ public:
 	UPROPERTY(VisibleAnywhere, Transient, BlueprintReadWrite, Category = Cover)
 	bool bIsCoverHitResultValid = false;
 
+	/*
+	If true, cover is only safe if the focus can't see behind it, as well as not being too close. 
+	Uses the shared visibility cache of UUtilityAICoverSubsystem, so it costs a hash lookup, not a trace.
+	Until the first trace for a spot comes back, only the distance is checked.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover)
+	bool bUseCoverVisibility = false;
+
 	UPROPERTY(VisibleAnywhere, Transient, BlueprintReadWrite, Category = Cover)
 	bool bIsCoverPointSafe = false;
 
@@ -256,6 +468,260 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover)
 	FName ValidCoverPointTag = FName("Cover");
 
+	/*
+	How FindClosestCoverPoint() looks for cover. See ECoverSearchMode.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover)
+	ECoverSearchMode CoverSearchMode = ECoverSearchMode::SWEEP;
+
+	/*
+	ADAPTIVE_SWEEP. Degrees between the traces of the coarse ring. Sectors this wide are refined at LineTraceDegrees.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover, meta = (ClampMin = 1.0, ClampMax = 180.0))
+	float CoarseCoverTraceDegrees = 45.0f;
+
+	/*
+	AMORTIZED_SWEEP. How many cover traces each decision may do.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover, meta = (ClampMin = 1))
+	int32 CoverTracesPerDecision = 4;
+
+	/*
+	AMORTIZED_SWEEP. If the pawn moves farther than this from where the sweep started, the sweep starts over.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover, meta = (ClampMin = 0.0))
+	float CoverSweepInvalidationDistance = 200.0f;
+
+	/*
+	AMORTIZED_SWEEP book keeping. Where the ring is up to, in degrees from CoverSweepForward, and the best cover of this ring so far.
+	*/
+	float CoverSweepCursor = 0.0f;
+
+	bool bCoverSweepStarted = false;
+
+	FVector CoverSweepOrigin = FVector(0.0f,0.0f,0.0f);
+
+	FVector CoverSweepForward = FVector(1.0f,0.0f,0.0f);
+
+	FUtilityCoverSelection CoverSweepSelection;
+
+	/*
+	The best of the last full ring and the current one so far. What AMORTIZED_SWEEP publishes, 
+	so starting a new ring doesn't fall back to whatever its first few traces found.
+	*/
+	FUtilityCoverSelection CoverSweepBestSelection;
+
+	/*
+	ASYNC_SWEEP book keeping. One handle per trace in the ring that was submitted, and its hit once it comes back.
+	*/
+	TArray<FTraceHandle> PendingCoverTraceHandles = {};
+
+	TArray<FHitResult> PendingCoverTraceHits = {};
+
+	/*
+	How many of PendingCoverTraceHandles haven't come back yet.
+	*/
+	int32 PendingCoverTracesOutstanding = 0;
+
+	FTraceDelegate CoverTraceDelegate;
+
+	/*
+	SPATIAL_INDEX. How many of the best cover slots may be line traced per search, before giving up.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Cover, meta = (ClampMin = 1))
+	int32 MaxCoverValidationTraces = 3;
+
+	/*
+	SPATIAL_INDEX scratch. Kept around so it doesn't reallocate.
+	*/
+	TArray<int32> CoverSlotCandidates = {};
+
+	TArray<FHitResult> CoverSlotHits = {};
+
+	/*
+	True while we hold a claim on cover in UUtilityAICoverSubsystem. See UUtilityCombatTaskComponent::bClaimsCover.
+	*/
+	UPROPERTY(VisibleAnywhere, Transient, BlueprintReadOnly, Category = Cover)
+	bool bHasCoverClaim = false;
+
+	/*
+	Cached in Initialize().
+	*/
+	UPROPERTY(Transient)
+	UUtilityAICoverSubsystem* CoverSubsystem = nullptr;
+
+	/*
+	Location, velocity and attack state of ControllerFocus, for this decision. Set by GatherFocusFacts().
+	*/
+	FUtilityFocusFacts FocusFacts;
+
+
+	/*
+	Inputs captured for the current decision by CaptureDecisionSnapshot(). Task scoring reads only this.
+	*/
+	FUtilityDecisionSnapshot DecisionSnapshot;
+
+	/*
+	Every curve of TaskArray, flattened. Built by CompileConsiderationTable() in Initialize()
+	*/
+	FUtilityConsiderationTable ConsiderationTable;
+
+	/*
+	One per task index. The score each task got in the last ScoreTasksFromSnapshot()
+	*/
+	TArray<float> TaskScores = {};
+
+	/*
+	True while CaptureDecisionSnapshot() calls CalculateTaskScore() on the game thread, so the task can read DecisionSnapshot.
+	Outside of that, UUtilityCombatTaskComponent::CalculateTaskScore_Implementation() captures its own inputs with CaptureCurrentInputs().
+	*/
+	bool bCapturingDecisionSnapshot = false;
+
+	/*
+	One per task index. True if CalculateTaskScore() is overridden, see UUtilityCombatTaskComponent::IsCalculateTaskScoreOverridden().
+	Those tasks can't be scored off the game thread, so they are scored in CaptureDecisionSnapshot() instead.
+	*/
+	TArray<bool> TaskScoredOnGameThread = {};
+
+	/*
+	One per task index. The task if it is a UUtilityNativeTaskComponent with bOverridesNativeScore, otherwise nullptr.
+	*/
+	TArray<const UUtilityNativeTaskComponent*> NativeScoreTasks = {};
+
+	/*
+	INCREMENTAL SCORING
+	One per task index. World time of each task's last real score, -1.0 if never scored.
+	*/
+	TArray<double> TaskScoreTimes = {};
+
+	/*
+	One per task index. Whether each task was ready (not on cooldown, not locked) at its last decision.
+	*/
+	TArray<bool> TaskWasReady = {};
+
+	/*
+	Scratch for ScoreNativeTasks()
+	*/
+	TArray<bool> TaskDirty = {};
+
+	/*
+	Scratch for ScoreNativeTasks(). One per 4 considerations.
+	*/
+	TArray<uint8> DirtyBlocks = {};
+
+	/*
+	LAYERS
+	One per task index. Index of each task's TaskLayer in PossibleLayers. 
+	Built by Initialize(), so changing a TaskLayer at runtime needs Initialize() to be called again.
+	*/
+	TArray<int32> TaskLayerIndices = {};
+
+	/*
+	Per layer. Task index of the task running on the layer, INDEX_NONE if it never started one.
+	*/
+	TUtilityLayerArray<int32> CurrentTaskIndices = {};
+
+	/*
+	Per layer. Task index of the best task, written by ScoreTasksFromSnapshot() and consumed by ApplyBestTasks().
+	*/
+	TUtilityLayerArray<int32> BestTaskIndices = {};
+
+	/*
+	Per layer. Score of the task in BestTaskIndices.
+	*/
+	TUtilityLayerArray<float> BestLayerScores = {};
+
+	/*
+	Per layer scratch for ApplyBestTasks(). 1 if the layer is free for its best task.
+	*/
+	TUtilityLayerArray<uint8> LayersToFill = {};
+
+	/*
+	Decisions that had to grow or shrink one of the manager's containers, since Initialize().
+	This counts decisions, not allocations: one decision resizing three containers counts once, and allocations outside
+	these containers aren't seen. It should stop going up once every task has been scored once.
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Scoring)
+	int32 DecisionContainerResizes = 0;
+
+	/*
+	GetDecisionMemorySize() after the last decision.
+	*/
+	SIZE_T LastDecisionMemorySize = 0;
+
+	/*
+	PROFILING
+	Line traces issued since Initialize()
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Profiling)
+	int32 TracesIssued = 0;
+
+	/*
+	Calls to Blueprint overridable events since Initialize(): 
+	IUtilityAIManagerToPawnInterface, and CalculateTaskScore(), EnterTask() and ExitTask() of tasks that override them in Blueprint.
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Profiling)
+	int32 BlueprintCalls = 0;
+
+	/*
+	Running totals for the decision in progress. Moved into the histories by RecordDecisionCost().
+	*/
+	double DecisionCostSeconds = 0.0;
+
+	int32 DecisionTraces = 0;
+
+	int32 DecisionBlueprintCalls = 0;
+
+	/*
+	Set by ScoreNativeTasks(), which may run on a worker thread. RecordDecisionCost() publishes them to the stats on the game thread.
+	*/
+	int32 DecisionScoreCacheHits = 0;
+
+	int32 DecisionScoreCacheMisses = 0;
+
+	int32 DecisionConsiderationsSkipped = 0;
+
+	/*
+	One per task index.
+	*/
+	TArray<double> TaskDecisionCosts = {};
+
+	TArray<int32> TaskDecisionBlueprintCalls = {};
+
+	FUtilityCostHistory CostHistory;
+
+	/*
+	One per task index while UtilityAI.Profiling.TaskCostHistory is 1, otherwise empty.
+	*/
+	TArray<FUtilityCostHistory> TaskCostHistories = {};
+
+	/*
+	Only allocated while bRecordDecisionTrace is true.
+	*/
+	FUtilityDecisionTraceRecorder DecisionTrace;
+
+	/*
+	Set with SetNativeStatFunction(). Wins over every other stat provider.
+	*/
+	FUtilityNativeStatFunction NativeStatFunction = nullptr;
+
+	/*
+	The pawn the cached stat provider below was resolved for. Resolved again when the controlled pawn changes.
+	*/
+	TWeakObjectPtr<APawn> StatProviderPawn = nullptr;
+
+	/*
+	The pawn, or one of its components, that implements IUtilityAINativeStatProvider.
+	*/
+	TWeakObjectPtr<UObject> NativeStatProviderObject = nullptr;
+
+	IUtilityAINativeStatProvider* NativeStatProvider = nullptr;
+
+	/*
+	Whether the pawn implements IUtilityAIManagerToPawnInterface. Only used without a native provider.
+	*/
+	bool bStatProviderPawnImplementsInterface = false;
+
 
 	
 
@@ -271,33 +737,390 @@ public:
 	UFUNCTION(BlueprintCallable, Category = Initialize)
 	void Initialize();
 
+	/*
+	Flattens the curves of every task into ConsiderationTable. Called by Initialize().
+	Call it again if you change a task's CurveCollectionArray at runtime.
+	*/
+	void CompileConsiderationTable();
+
+	/*
+	TASKS
+	These work the same on task components and tasks of TaskArchetype. 
+	A TaskIndex below TaskArray.Num() is a task component, the ones after it are TaskDefinitions in order.
+	*/
+	int32 GetNumTasks() const { return TaskArray.Num() + TaskDefinitions.Num(); }
+
+	bool HasTask(int32 TaskIndex) const { return GetTaskComponent(TaskIndex) || TaskIndex >= TaskArray.Num(); }
+
+	/*
+	nullptr for tasks of TaskArchetype.
+	*/
+	UUtilityCombatTaskComponent* GetTaskComponent(int32 TaskIndex) const { return TaskIndex < TaskArray.Num() ? TaskArray[TaskIndex] : nullptr; }
+
+	/*
+	nullptr for task components.
+	*/
+	const UUtilityTaskDefinition* GetTaskDefinition(int32 TaskIndex) const { return TaskIndex >= TaskArray.Num() ? TaskDefinitions[TaskIndex - TaskArray.Num()] : nullptr; }
+
+	/*
+	nullptr for task components.
+	*/
+	FUtilityTaskRuntimeState* GetTaskState(int32 TaskIndex) { return TaskIndex >= TaskArray.Num() ? &TaskStates[TaskIndex - TaskArray.Num()] : nullptr; }
+
+	const FUtilityTaskRuntimeState* GetTaskState(int32 TaskIndex) const { return TaskIndex >= TaskArray.Num() ? &TaskStates[TaskIndex - TaskArray.Num()] : nullptr; }
+
+	FName GetTaskName(int32 TaskIndex) const;
+
+	bool IsTaskActive(int32 TaskIndex) const;
+
+	bool IsTaskReadyAt(int32 TaskIndex, const double WorldTime) const;
+
+	/*
+	Same rules as UUtilityCombatTaskComponent::CanTaskBeInterrupted()
+	*/
+	bool CanTaskBeInterrupted(int32 TaskIndex, int32 InterruptingTaskIndex) const;
+
+	bool DoesTaskClaimCover(int32 TaskIndex) const;
+
+	/*
+	The task's curves. nullptr if there is no task at TaskIndex.
+	*/
+	const TArray<FUtilityCurveCollection>* GetTaskCurves(int32 TaskIndex) const;
+
+	/*
+	Enters the task, claims cover if it wants it, and broadcasts OnAnyTaskEnter. Called by ChangeTasksOnLayers().
+	*/
+	void EnterTaskAt(int32 TaskIndex);
+
+	/*
+	Exits the task, releases cover if it claimed it, and broadcasts OnAnyTaskExit. Called by ChangeTasksOnLayers().
+	*/
+	void ExitTaskAt(int32 TaskIndex);
+
+	/*
+	Ends the running task of TaskArchetype called TaskName. The same as a task component setting bIsTaskActive = false:
+	its layer gets a new task at the next decision.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Basic)
+	void FinishTask(FName TaskName);
+
 	/*
 	Calculations that need to be done before calling ScoreTasks()
 	*/
 	void AnteScoreCalculations();
 
+	/*
+	Game thread. Copies everything the task curves need into DecisionSnapshot, including STAT_BY_FNAME values 
+	from the controlled pawn. Call after AnteScoreCalculations().
+	*/
+	void CaptureDecisionSnapshot();
+
+	/*
+	Fills the ECurveInputQuery inputs of OutSnapshot from the current state of this component. Doesn't touch stats.
+	*/
+	void CaptureQueryInputs(FUtilityDecisionSnapshot& OutSnapshot) const;
+
+	/*
+	Fills OutSnapshot like CaptureDecisionSnapshot() would right now, without touching DecisionSnapshot or scoring anything.
+	*/
+	void CaptureCurrentInputs(FUtilityDecisionSnapshot& OutSnapshot) const;
+
+	/*
+	Pure math on DecisionSnapshot. Writes TaskScores and BestTaskIndices.
+	Doesn't touch any UObject but this component and its tasks, so different managers can be scored in parallel.
+	*/
+	void ScoreTasksFromSnapshot();
+
+	const FUtilityDecisionSnapshot& GetDecisionSnapshot() const { return DecisionSnapshot; }
+
+	/*
+	Scores every task whose CalculateTaskScore() isn't overridden from ConsiderationTable, skipping the ones whose cached score is still good.
+	*/
+	void ScoreNativeTasks();
+
+	/*
+	Step 4 of ScoreNativeTasks(). Returns the number of considerations skipped.
+	*/
+	int32 ScoreTasksWithEarlyExit();
+
+	/*
+	Forces every task to be scored on the next decision. 
+	*/
+	UFUNCTION(BlueprintCallable, Category = Scoring)
+	void InvalidateScoreCache();
+
+	/*
+	Copies every task's last score into its FinalNormalizedUtilityValue, and the curve outputs from ConsiderationTable 
+	into its CurveCollectionArray, so they can be seen in the details panel. Decisions don't do this, use a decision trace for history.
+	Only task components. Task definitions are shared, their scores are in TaskScores.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Debug)
+	void WriteDebugValues();
+
+	/*
+	Starts recording decisions into DecisionTrace, dropping what was recorded before. Capacity <= 0 uses DecisionTraceCapacity.
+	Refused for managers with more than MAX_int16 tasks, their indices don't fit a trace record.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Debug)
+	void StartDecisionTrace(int32 Capacity = 0);
+
+	UFUNCTION(BlueprintCallable, Category = Debug)
+	void StopDecisionTrace();
+
+	/*
+	Writes DecisionTrace to Filename. View it with -run=UtilityAIDecisionTraceView -File=Filename
+	*/
+	UFUNCTION(BlueprintCallable, Category = Debug)
+	bool DumpDecisionTrace(const FString& Filename) const;
+
+	/*
+	What ConsiderationTable, the tasks and PossibleLayers look like, for the records of DecisionTrace.
+	*/
+	FUtilityDecisionTraceLayout MakeDecisionTraceLayout() const;
+
+	/*
+	Called at the end of every decision while bRecordDecisionTrace is true. Does nothing if StartDecisionTrace() wasn't called.
+	*/
+	void RecordDecisionTrace();
+
 	/*
 	This does the work of evaluationing the tasks
 
 	Calls AnteScoreCalculations();
-	ScoreTasks();
-	ChangeToBestTasks();
+	CaptureDecisionSnapshot();
+	ScoreTasksFromSnapshot();
+	ApplyBestTasks();
 
 	*/
 	UFUNCTION(BlueprintCallable, Category = Basic)
 	void DetermineBestTask();
 
+	/*
+	Only matters if bUseEventDrivenDecisions = true
+	Asks the scheduler for a decision as soon as it has budget. Calling it more than once before then is still one decision.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Scheduler)
+	void RequestDecision();
+
+	/*
+	Only matters if bUseEventDrivenDecisions = true
+	True if an event since the last decision wants a new one, and MinEventDecisionInterval has passed. 
+	Checked by the scheduler every frame, so it is only pointer and time compares.
+	*/
+	bool HasDecisionEvent(const double WorldTime) const;
+
+	/*
+	Seconds the scheduler waits after a decision before the next one, if no event comes first.
+	*/
+	float GetNextDecisionDelay() const;
+
+	/*
+	Binds to the controlled pawn's UStatManager::OnStatModified and OnTakeAnyDamage, unbinding from the last pawn.
+	Called by Initialize(). Bound whatever bUseEventDrivenDecisions is, so it can be switched on at runtime.
+	*/
+	void BindDecisionEvents();
+
+	void UnbindDecisionEvents();
+
+	/*
+	Sets NextCooldownExpiry. Called at the end of every decision.
+	*/
+	void UpdateNextCooldownExpiry();
+
+	UFUNCTION()
+	void OnPawnStatModified(FName StatName, FStat Stat);
+
+	UFUNCTION()
+	void OnPawnTakeAnyDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType, AController* InstigatedBy, AActor* DamageCauser);
+
 	/*
 	Interrupt all tasks that we can. Clean up any ended tasks. Only do the BestTasks on layers that are freed for a new task.
+	Copies BestTasks into BestTaskIndices, then calls ApplyBestTasks(). Can only start task components.
 	*/
 	void ChangeToBestTasks(TMap<int32,UUtilityCombatTaskComponent*>& BestTasks );
 
+	/*
+	Same as ChangeToBestTasks(), for the best tasks ScoreTasksFromSnapshot() left in BestTaskIndices. Doesn't allocate.
+	Ends the decision, see RecordDecisionCost().
+	*/
+	void ApplyBestTasks();
+
+	/*
+	The part of ApplyBestTasks() that exits and enters tasks.
+	*/
+	void ChangeTasksOnLayers();
+
+	/*
+	Sizes every per layer array from PossibleLayers, and maps CurrentTasks and the active tasks of TaskStates onto CurrentTaskIndices. 
+	Called by Initialize().
+	*/
+	void InitializeLayerBookkeeping();
+
+	/*
+	Bytes held by the containers a decision reads and writes.
+	*/
+	SIZE_T GetDecisionMemorySize() const;
+
+	/*
+	Called at the end of every decision. Bumps DecisionContainerResizes if GetDecisionMemorySize() changed.
+	*/
+	void CountDecisionContainerResizes();
+
+	/*
+	Called at the end of every decision. Adds the decision's cost, traces and Blueprint calls to CostHistory and TaskCostHistories.
+	*/
+	void RecordDecisionCost();
+
+	/*
+	Sets ClosestCoverHitResult, DistanceToCover and bIsCoverHitResultValid, using CoverSearchMode.
+	*/
 	void FindClosestCoverPoint();
 
+	/*
+	False if we can't look for cover right now, e.g. no pawn, or falling.
+	*/
+	bool CanSearchForCover();
+
+	/*
+	Where the trace at Angle degrees around the pawn starts. Cover traces go from here to the pawn.
+	*/
+	FVector GetCoverTraceStart(float Angle) const;
+
+	void BeginCoverSelection(FUtilityCoverSelection& Selection) const;
+
+	/*
+	Keeps Hit in Selection if it is better cover than what Selection has. Hits that aren't cover are ignored.
+	*/
+	void ConsiderCoverHit(FUtilityCoverSelection& Selection, const FHitResult& Hit) const;
+
+	void ApplyCoverSelection(const FUtilityCoverSelection& Selection);
+
+	/*
+	One cover trace, from GetCoverTraceStart(Angle) to the pawn.
+	*/
+	void TraceCoverAngle(float Angle, FHitResult& OutHit);
+
+	/*
+	The angle GetCoverTraceStart() would need to point at Location.
+	*/
+	float GetCoverAngle(const FVector& Location) const;
+
+	/*
+	SWEEP. Traces the whole ring now.
+	*/
+	void SweepForCover();
+
+	/*
+	ADAPTIVE_SWEEP. Coarse ring, then a fine sweep of the sectors with cover in them.
+	*/
+	void AdaptiveSweepForCover();
+
+	/*
+	AMORTIZED_SWEEP. The next CoverTracesPerDecision traces of the ring.
+	*/
+	void AmortizedSweepForCover();
+
+	/*
+	Starts the AMORTIZED_SWEEP ring over on the next search.
+	*/
+	void ResetCoverSweepCursor();
+
+	/*
+	Runs one cover search with Mode and puts the cover state back the way it was. For comparing modes.
+	Only modes that finish in one call (SWEEP, ADAPTIVE_SWEEP, SPATIAL_INDEX).
+	*/
+	FUtilityCoverSearchResult RunCoverSearchForComparison(ECoverSearchMode Mode);
+
+	/*
+	ASYNC_SWEEP. Uses the ring submitted last time if it is back, then submits the next one.
+	*/
+	void AsyncSweepForCover();
+
+	/*
+	Claims ClosestCoverHitResult, so other agents' cover searches skip it. Releases any cover we claimed before.
+	False if there is no valid cover hit, or another agent got there first.
+	*/
+	UFUNCTION(BlueprintCallable, Category = Cover)
+	bool ClaimCover();
+
+	UFUNCTION(BlueprintCallable, Category = Cover)
+	void ReleaseCover();
+
+	/*
+	True if another agent has claimed cover near Location.
+	*/
+	bool IsCoverClaimedByOther(const FVector& Location) const;
+
+	/*
+	SPATIAL_INDEX. Scores the slots near us with ConsiderCoverHit(), then line traces the best ones until one checks out.
+	*/
+	void SpatialIndexSearchForCover();
+
+	/*
+	True if a line trace from just outside Hit to the pawn still hits Hit's actor first.
+	*/
+	bool ValidateCoverHit(FHitResult& Hit);
+
+	/*
+	Called by the world when one ASYNC_SWEEP trace is done.
+	*/
+	void OnCoverTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+	/*
+	Drops any ASYNC_SWEEP traces that haven't come back.
+	*/
+	void ResetPendingCoverTraces();
+
+	/*
+	Fills FocusFacts. Gathered once per frame per focus by UUtilityAIDecisionSubsystem, and shared by every manager with that focus.
+	Called by AnteScoreCalculations().
+	*/
+	void GatherFocusFacts();
+
+	/*
+	Picks CurrentDecisionLOD from the distance to the nearest player pawn. Called by AnteScoreCalculations().
+	*/
+	void UpdateDecisionLOD();
+
+	/*
+	DecisionInterval, or the current LOD tier's.
+	*/
+	UFUNCTION(BlueprintPure, Category = LOD)
+	float GetEffectiveDecisionInterval() const;
+
+	/*
+	bCanFindCover, and the current LOD tier allows it.
+	*/
+	UFUNCTION(BlueprintPure, Category = LOD)
+	bool CanFindCoverNow() const;
+
+	/*
+	LineTraceDegrees, or the current LOD tier's if it is coarser.
+	*/
+	UFUNCTION(BlueprintPure, Category = LOD)
+	float GetEffectiveLineTraceDegrees() const;
+
 	float GetNormalizedStat(const ECurveInputQuery CurveInputQuery) const;
 
 	float GetNormalizedStat(const FName& InputStat) const;
 
+	/*
+	Registers a C++ function that answers every STAT_BY_FNAME the tasks use in one call. 
+	Takes priority over the pawn's IUtilityAINativeStatProvider and IUtilityAIManagerToPawnInterface. Pass nullptr to remove it.
+	*/
+	void SetNativeStatFunction(FUtilityNativeStatFunction InNativeStatFunction);
+
+	/*
+	Works out once who answers STAT_BY_FNAME queries for the controlled pawn, instead of every query.
+	Called on possession, and whenever the controlled pawn changes.
+	*/
+	void ResolveStatProvider();
+
+	/*
+	Game thread. DecisionSnapshot.StatValues = every stat in DecisionSnapshot.StatNames, in one batch if there is a native provider.
+	*/
+	void GatherStatValues();
+
 	bool IsCoverHitResultValid() const;
 
 	bool IsCoverHitResultSafe() const;
@@ -305,6 +1128,10 @@ public:
 
 
 
+	/*
+	Captures a snapshot and scores it. Kept for callers that want the best tasks back. Allocates the map it returns.
+	Layers whose best task is from TaskArchetype are left out.
+	*/
 	TMap<int32,UUtilityCombatTaskComponent*> ScoreTasks();
 	
 	/*
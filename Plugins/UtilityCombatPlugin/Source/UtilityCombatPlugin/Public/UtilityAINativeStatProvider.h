@@ -0,0 +1,42 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "UtilityAINativeStatProvider.generated.h"
+
+/*
+A C++ function that answers a whole batch of STAT_BY_FNAME queries in one call.
+OutValues is the same length as StatNames, and each value should be from 0.0f to 1.0f.
+*/
+using FUtilityNativeStatFunction = TFunction<void(TArrayView<const FName> StatNames, TArrayView<float> OutValues)>;
+
+// This class does not need to be modified.
+UINTERFACE(MinimalAPI, meta = (CannotImplementInterfaceInBlueprint))
+class UUtilityAINativeStatProvider : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ *
+ * C++ only version of IUtilityAIManagerToPawnInterface::GetNormalizedStat().
+ *
+ * The UUtilityAIManagerComponent asks for every stat its tasks use in one call, once per decision,
+ * instead of one Blueprint call per stat. Implement it on the controlled pawn, or on one of its components.
+ * UStatManager implements it, see UUtilityAIManagerComponent::bReadStatsFromStatManager.
+ *
+ * Called on the game thread, from UUtilityAIManagerComponent::CaptureDecisionSnapshot().
+ */
+class UTILITYCOMBATPLUGIN_API IUtilityAINativeStatProvider
+{
+	GENERATED_BODY()
+
+public:
+
+	/*
+	OutValues[i] = the normalized value of StatNames[i]. Unknown stats should be 0.0f.
+	*/
+	virtual void GetNormalizedStats(TArrayView<const FName> StatNames, TArrayView<float> OutValues) = 0;
+};
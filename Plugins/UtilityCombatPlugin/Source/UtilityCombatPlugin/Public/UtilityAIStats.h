@@ -0,0 +1,75 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "HAL/PlatformTime.h"
+
+/*
+Stats for the utility AI pipeline.
+Use "stat UtilityAI" in game, or "-csvCategories=UtilityAI" with the CSV profiler on dedicated servers.
+The same scopes show up in Unreal Insights with "-trace=cpu", prefixed with UtilityAI_.
+"UtilityAI.DumpTopAgents" lists the most expensive agents and tasks.
+*/
+DECLARE_STATS_GROUP(TEXT("UtilityAI"), STATGROUP_UtilityAI, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Scheduler Tick"), STAT_UtilityAI_SchedulerTick, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AnteScoreCalculations"), STAT_UtilityAI_AnteScoreCalculations, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FindClosestCoverPoint"), STAT_UtilityAI_FindClosestCoverPoint, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CaptureDecisionSnapshot"), STAT_UtilityAI_CaptureDecisionSnapshot, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ScoreTasks"), STAT_UtilityAI_ScoreTasks, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CalculateTaskScore"), STAT_UtilityAI_CalculateTaskScore, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("EvaluateNativeTasks"), STAT_UtilityAI_EvaluateNativeTasks, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ChangeToBestTasks"), STAT_UtilityAI_ChangeToBestTasks, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crowd Tick"), STAT_UtilityAI_CrowdTick, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Decision Budget (ms)"), STAT_UtilityAI_DecisionBudgetMs, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Decision Time Used (ms)"), STAT_UtilityAI_DecisionTimeUsedMs, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Registered Managers"), STAT_UtilityAI_RegisteredManagers, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Decision Queue Depth"), STAT_UtilityAI_QueueDepth, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Decisions Run"), STAT_UtilityAI_DecisionsRun, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Decisions Deferred"), STAT_UtilityAI_DecisionsDeferred, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Event Driven Decisions Due"), STAT_UtilityAI_EventDecisions, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Score Cache Hits"), STAT_UtilityAI_ScoreCacheHits, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Score Cache Misses"), STAT_UtilityAI_ScoreCacheMisses, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Considerations Skipped"), STAT_UtilityAI_ConsiderationsSkipped, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Decision Container Resizes"), STAT_UtilityAI_DecisionContainerResizes, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces Issued"), STAT_UtilityAI_TracesIssued, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Blueprint Calls"), STAT_UtilityAI_BlueprintCalls, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Crowd Agents"), STAT_UtilityAI_CrowdAgents, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Crowd Decisions"), STAT_UtilityAI_CrowdDecisions, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Crowd Promotions"), STAT_UtilityAI_CrowdPromotions, STATGROUP_UtilityAI, UTILITYCOMBATPLUGIN_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(UTILITYCOMBATPLUGIN_API, UtilityAI);
+
+/*
+Stat, Insights and CSV timing for one scope. Name is used for the Insights event and the CSV stat.
+*/
+#define UTILITY_AI_SCOPE_CYCLE_COUNTER(Stat, Name) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(UtilityAI_##Name); \
+	CSV_SCOPED_TIMING_STAT(UtilityAI, Name)
+
+/*
+Adds the time until the end of the scope to Accumulator, in seconds. Used for the per agent costs.
+*/
+struct FUtilityScopedCostTimer
+{
+	explicit FUtilityScopedCostTimer(double& InAccumulator)
+		: Accumulator(InAccumulator)
+		, StartCycles(FPlatformTime::Cycles64())
+	{
+	}
+
+	~FUtilityScopedCostTimer()
+	{
+		Accumulator += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+	}
+
+	double& Accumulator;
+
+	uint64 StartCycles;
+};
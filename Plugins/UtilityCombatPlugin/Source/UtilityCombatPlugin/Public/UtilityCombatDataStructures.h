@@ -5,6 +5,7 @@
 #include "Runtime/Engine/Classes/Engine/DataTable.h"
 //#include "Math/IntPoint.h"
 #include "Curves/CurveFloat.h"
+#include "Engine/HitResult.h"
 #include "UtilityCombatDataStructures.generated.h"
 
 /*
@@ -44,6 +45,7 @@ NormalizedDistanceToCurrentPointOfInterest: DistanceToCurrentPointOfInterest/Max
 NormalizedDistanceToFocus: DistanceToFocus/ComfortableDistance
 NormalizedDistanceToFocusLastDetected: DistanceToFocusLastDetectedPoint/MaxFocusSearchDistance
 
+Count: Not a query. Add new queries before it.
 */
 UENUM(BlueprintType)
 enum class ECurveInputQuery : uint8 {STAT_BY_FNAME,
@@ -53,10 +55,103 @@ enum class ECurveInputQuery : uint8 {STAT_BY_FNAME,
                                     IsInCover, IsMeleeEquip,
 
                                     HasFocus,HasFocusLastSetPoint,HasPointOfInterest, 
-                                    NormalizedDistanceToCover,NormalizedDistanceToCurrentPointOfInterest,NormalizedDistanceToFocus,NormalizedDistanceToFocusLastDetected
-                                    
+                                    NormalizedDistanceToCover,NormalizedDistanceToCurrentPointOfInterest,NormalizedDistanceToFocus,NormalizedDistanceToFocusLastDetected,
+
+                                    Count UMETA(Hidden)
                                     };
 
+/*
+Number of ECurveInputQuery values, not counting Count.
+*/
+static constexpr int32 UtilityCurveInputQueryCount = static_cast<int32>(ECurveInputQuery::Count);
+
+/*
+How UUtilityAIManagerComponent::FindClosestCoverPoint() looks for cover.
+
+SWEEP = A ring of line traces around the pawn, every decision. The result is ready right away.
+ASYNC_SWEEP = The same ring, submitted through the world's async trace API. The hits are picked up by the next decision, 
+and ClosestCoverHitResult keeps the last result until then.
+SPATIAL_INDEX = Looks up the cover slots within CoverPointSearchDistance in UUtilityAICoverSubsystem. 
+Only the best slots are line traced, to check they are still there.
+ADAPTIVE_SWEEP = A coarse ring every CoarseCoverTraceDegrees, then LineTraceDegrees only in the sectors where cover was hit,
+and in the sector of the last cover. Not measured against SWEEP yet, see UtilityAI.Cover.Compare.
+AMORTIZED_SWEEP = The SWEEP ring, spread over several decisions, CoverTracesPerDecision at a time. 
+The best cover so far is used until the ring is done. Costs the same no matter how small LineTraceDegrees is.
+*/
+UENUM(BlueprintType)
+enum class ECoverSearchMode : uint8 {SWEEP, ASYNC_SWEEP, SPATIAL_INDEX, ADAPTIVE_SWEEP, AMORTIZED_SWEEP};
+
+/*
+Per task layer storage in UUtilityAIManagerComponent. Most agents use a handful of layers, so these never touch the heap.
+*/
+template<typename ElementType>
+using TUtilityLayerArray = TArray<ElementType, TInlineAllocator<8>>;
+
+/*
+A UCurveFloat sampled at evenly spaced inputs, so evaluating it is an index and a lerp instead of a key search.
+
+The samples cover 0.0f to 1.0f, widened to include every key of the curve. 
+Outside of that range the curve is clamped if both of its extrapolations are constant. 
+If not, EvaluateCurve() falls back to the real curve outside the range.
+*/
+struct FUtilityCurveLUT
+{
+    TArray<float> Samples;
+
+    /*
+    The curve the samples came from. If a different curve is assigned at runtime, the table is ignored until baked again.
+    */
+    const UCurveFloat* SourceCurve = nullptr;
+
+    float DomainMin = 0.0f;
+
+    float DomainMax = 1.0f;
+
+    /*
+    (Samples.Num()-1)/(DomainMax-DomainMin)
+    */
+    float InvSampleSpacing = 0.0f;
+
+    /*
+    True if inputs outside DomainMin-DomainMax can be clamped to the first/last sample.
+    */
+    bool bClampOutsideDomain = true;
+
+    /*
+    Largest difference between the table and the real curve, measured between the samples when baked.
+    */
+    float MaxError = 0.0f;
+
+    /*
+    Samples Curve with Resolution intervals (Resolution+1 samples). Empties the table if Curve is nullptr.
+    */
+    void Bake(const UCurveFloat* Curve, int32 Resolution);
+
+    bool IsBaked() const
+    {
+        return Samples.Num() >= 2;
+    }
+
+    /*
+    False if Input is outside the table and the curve doesn't have constant extrapolation.
+    */
+    bool CanEvaluate(const float Input) const
+    {
+        return bClampOutsideDomain || (Input >= DomainMin && Input <= DomainMax);
+    }
+
+    /*
+    Only call if IsBaked()
+    */
+    float Evaluate(const float Input) const
+    {
+        const int32 LastIndex = Samples.Num() - 1;
+        const float Position = FMath::Clamp((Input - DomainMin)*InvSampleSpacing, 0.0f, static_cast<float>(LastIndex));
+        const int32 Index = FMath::Min(FMath::FloorToInt(Position), LastIndex - 1);
+        return FMath::Lerp(Samples[Index], Samples[Index + 1], Position - static_cast<float>(Index));
+    }
+};
+
 /*
 While I could keep a running Multiple, this is way easier conceptually.
 And will allow for easier debuging
@@ -99,6 +194,10 @@ struct FUtilityCurveCollection
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Curve)
     float CurveDampen = 1.0f;
 
+    /*
+    Last output of this curve. Decisions don't write it. Filled by UUtilityAIManagerComponent::WriteDebugValues(),
+    or after every decision while the manager's bWriteDebugValuesEveryDecision is true.
+    */
     UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Curve)
     float CurveOutput = 0.0f;
 
@@ -114,10 +213,545 @@ struct FUtilityCurveCollection
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Curve)
     bool bMultiplyThisCurveOutputToRunningTotal = true;
 
+    /*
+    CurveFloat is baked into a lookup table with this many intervals when the task begins play.
+    Raise it if BakedCurveMaxError is too big. Curves with sharp steps need more samples to stay accurate between the step.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Curve, meta = (ClampMin = 1, UIMin = 1))
+    int32 BakedCurveResolution = 64;
+
+    /*
+    Largest difference between the lookup table and CurveFloat. Filled whenever the curve is baked.
+    */
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = Curve)
+    float BakedCurveMaxError = 0.0f;
+
+    /*
+    Lookup table for CurveFloat. Built by BakeCurve()
+    */
+    FUtilityCurveLUT BakedCurve;
+
+    void BakeCurve()
+    {
+        BakedCurve.Bake(CurveFloat, BakedCurveResolution);
+        BakedCurveMaxError = BakedCurve.MaxError;
+    }
+
+    /*
+    Uses the lookup table when it can, otherwise the real curve. 0.0f if there is no curve.
+    */
+    float EvaluateCurve(const float Input) const
+    {
+        if(BakedCurve.IsBaked() && BakedCurve.SourceCurve == CurveFloat && BakedCurve.CanEvaluate(Input))
+        {
+            return BakedCurve.Evaluate(Input);
+        }
+        return CurveFloat ? CurveFloat->GetFloatValue(Input) : 0.0f;
+    }
+
 
     
     FUtilityCurveCollection()
     {
 
     }
-};
\ No newline at end of file
+};
+
+/*
+One level of detail for UUtilityAIManagerComponent decisions. 
+Agents far from every player don't need to decide as often, or as carefully, as agents in a firefight.
+*/
+USTRUCT(BlueprintType)
+struct FUtilityDecisionLODTier
+{
+    GENERATED_BODY()
+
+    /*
+    The agent uses this tier if the nearest player pawn is closer than this. 
+    The last tier is used for anything farther than every tier.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD, meta = (ClampMin = 0.0))
+    float MaxPlayerDistance = 3000.0f;
+
+    /*
+    Replaces UUtilityAIManagerComponent::DecisionInterval while in this tier. Only matters if bUseDecisionScheduler = true
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD, meta = (ClampMin = 0.0))
+    float DecisionInterval = 0.5f;
+
+    /*
+    If false, no cover search is done in this tier, even if the manager's bCanFindCover is true.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD)
+    bool bCanFindCover = true;
+
+    /*
+    Replaces UUtilityAIManagerComponent::LineTraceDegrees while in this tier, if bigger. 0 = use the manager's.
+    Bigger is fewer traces.
+    */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = LOD, meta = (ClampMin = 0.0, ClampMax = 180.0))
+    float LineTraceDegrees = 0.0f;
+
+    FUtilityDecisionLODTier()
+    {
+
+    }
+
+    FUtilityDecisionLODTier(float InMaxPlayerDistance, float InDecisionInterval, bool bInCanFindCover, float InLineTraceDegrees)
+    {
+        MaxPlayerDistance = InMaxPlayerDistance;
+        DecisionInterval = InDecisionInterval;
+        bCanFindCover = bInCanFindCover;
+        LineTraceDegrees = InLineTraceDegrees;
+    }
+};
+
+/*
+What every manager wants to know about its ControllerFocus. Shared by all managers with the same focus.
+*/
+struct FUtilityFocusFacts
+{
+    /*
+    GFrameCounter when these were gathered. 0 = stale.
+    */
+    uint64 Frame = 0;
+
+    FVector Location = FVector(0.0f,0.0f,0.0f);
+
+    FVector Velocity = FVector(0.0f,0.0f,0.0f);
+
+    /*
+    If the focus implements IUtilityAIManagerToPawnInterface. If not, the attack facts are false.
+    */
+    bool bImplementsInterface = false;
+
+    bool bIsMeleeAttacking = false;
+
+    bool bIsRangeAttacking = false;
+};
+
+/*
+The best cover hit found so far by one cover search. Every ECoverSearchMode feeds its hits through 
+UUtilityAIManagerComponent::ConsiderCoverHit(), so they all pick cover with the same rules.
+*/
+struct FUtilityCoverSelection
+{
+    /*
+    Starts at CoverPointSearchDistance, the longest a trace can be.
+    */
+    float ShortestDistanceFromSelf = 0.0f;
+
+    float LongestCoverDistanceFromFocus = 0.0f;
+
+    /*
+    Becomes UUtilityAIManagerComponent::DistanceToCover
+    */
+    float BestDistanceToCover = 0.0f;
+
+    FHitResult BestHit = FHitResult();
+};
+
+/*
+What one cover search found, and what it cost. Used to compare ECoverSearchModes, see UtilityAI.Cover.Compare
+*/
+struct FUtilityCoverSearchResult
+{
+    FHitResult Hit = FHitResult();
+
+    bool bFoundCover = false;
+
+    float DistanceToCover = 0.0f;
+
+    int32 Traces = 0;
+
+    double Seconds = 0.0;
+};
+
+/*
+Cost of an agent, or one of its tasks, over the last NumBuckets seconds of world time. One bucket per second.
+Fixed size, so recording never allocates. Read by the UtilityAI.DumpTopAgents console command.
+*/
+struct FUtilityCostHistory
+{
+    static constexpr int32 NumBuckets = 32;
+
+    /*
+    Which whole second of world time each bucket holds. -1 if never written.
+    */
+    int32 BucketSeconds[NumBuckets];
+
+    float CostSeconds[NumBuckets];
+
+    int32 Traces[NumBuckets];
+
+    int32 BlueprintCalls[NumBuckets];
+
+    FUtilityCostHistory()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for(int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+        {
+            BucketSeconds[Bucket] = -1;
+            CostSeconds[Bucket] = 0.0f;
+            Traces[Bucket] = 0;
+            BlueprintCalls[Bucket] = 0;
+        }
+    }
+
+    void Add(const double WorldTime, const float InCostSeconds, const int32 InTraces, const int32 InBlueprintCalls)
+    {
+        const int32 Second = FMath::FloorToInt(WorldTime);
+        const int32 Bucket = Second % NumBuckets;
+        if(BucketSeconds[Bucket] != Second)
+        {
+            BucketSeconds[Bucket] = Second;
+            CostSeconds[Bucket] = 0.0f;
+            Traces[Bucket] = 0;
+            BlueprintCalls[Bucket] = 0;
+        }
+        CostSeconds[Bucket] += InCostSeconds;
+        Traces[Bucket] += InTraces;
+        BlueprintCalls[Bucket] += InBlueprintCalls;
+    }
+
+    /*
+    Totals of the buckets in the last WindowSeconds before WorldTime. WindowSeconds is clamped to NumBuckets.
+    */
+    void Sum(const double WorldTime, const float WindowSeconds, float& OutCostSeconds, int32& OutTraces, int32& OutBlueprintCalls) const
+    {
+        const int32 Now = FMath::FloorToInt(WorldTime);
+        const int32 Oldest = Now - FMath::Clamp(FMath::CeilToInt(WindowSeconds),1,NumBuckets) + 1;
+
+        OutCostSeconds = 0.0f;
+        OutTraces = 0;
+        OutBlueprintCalls = 0;
+        for(int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+        {
+            if(BucketSeconds[Bucket] >= Oldest && BucketSeconds[Bucket] <= Now)
+            {
+                OutCostSeconds += CostSeconds[Bucket];
+                OutTraces += Traces[Bucket];
+                OutBlueprintCalls += BlueprintCalls[Bucket];
+            }
+        }
+    }
+};
+
+/*
+Plain copy of everything the task curves read during a decision.
+
+Captured on the game thread by UUtilityAIManagerComponent::CaptureDecisionSnapshot(), after AnteScoreCalculations() has
+done its UObject reads. Task scoring only reads from this, so it can run on a worker thread.
+*/
+struct FUtilityDecisionSnapshot
+{
+    /*
+    GetWorld()->GetTimeSeconds() when the snapshot was taken. Used for task cooldowns.
+    */
+    double WorldTime = 0.0;
+
+    bool bHasFocus = false;
+    bool bFocusLastDetectedSet = false;
+    bool bCurrentPointOfInterestSet = false;
+    bool bIsCoverPointSafe = false;
+    bool bIsCoverHitResultValid = false;
+    bool bIsCrouched = false;
+    bool bIsFocusAnyAttacking = false;
+    bool bIsFocusMeleeAttacking = false;
+    bool bIsFocusRangeAttacking = false;
+    bool bIsInCover = false;
+    bool bMeleeWeaponArmed = false;
+
+    float DistanceToFocus = -1.0f;
+    float DistanceToFocusLastDetectedPoint = -1.0f;
+    float DistanceToCurrentPointOfInterest = -1.0f;
+    float DistanceToCover = -1.0f;
+
+    float MeleeRange = 0.0f;
+    float MeleeRangeFallout = 0.0f;
+    float ComfortableDistance = 1.0f;
+    float MaxFocusSearchDistance = 1.0f;
+    float MaxDistanceToCurrentPointOfInterest = 1.0f;
+    float CoverPointSearchDistance = 1.0f;
+
+    /*
+    Every unique STAT_BY_FNAME the manager's tasks use. Same order as FUtilityConsiderationTable::StatNames
+    */
+    TArray<FName> StatNames;
+
+    /*
+    Same order as StatNames. Already asked from the controlled pawn.
+    */
+    TArray<float> StatValues;
+
+    /*
+    The normalized input of every ECurveInputQuery, indexed by the query. Filled once per decision by ComputeQueryValues(),
+    so a query shared by many considerations costs one switch and division instead of one per consideration.
+    STAT_BY_FNAME is always 0.0f, its values are in StatValues.
+    */
+    float QueryValues[UtilityCurveInputQueryCount] = {};
+
+    /*
+    Call after the fields above are captured, before scoring reads GetQueryValue().
+    */
+    void ComputeQueryValues()
+    {
+        QueryValues[static_cast<int32>(ECurveInputQuery::STAT_BY_FNAME)] = 0.0f;
+        for(int32 Query = static_cast<int32>(ECurveInputQuery::STAT_BY_FNAME) + 1; Query < UtilityCurveInputQueryCount; Query++)
+        {
+            QueryValues[Query] = GetNormalizedInput(static_cast<ECurveInputQuery>(Query));
+        }
+    }
+
+    /*
+    Same as GetNormalizedInput(), read from QueryValues.
+    */
+    float GetQueryValue(const ECurveInputQuery CurveInputQuery) const
+    {
+        checkSlow(static_cast<int32>(CurveInputQuery) < UtilityCurveInputQueryCount);
+        return QueryValues[static_cast<uint8>(CurveInputQuery)];
+    }
+
+    /*
+    See ECurveInputQuery for what each query returns. Computes the query from the fields, prefer GetQueryValue() while scoring.
+    */
+    float GetNormalizedInput(const ECurveInputQuery CurveInputQuery) const
+    {
+        switch(CurveInputQuery)
+        {
+            case ECurveInputQuery::IsCoverSafe:
+                return bIsCoverPointSafe?1.0f:0.0f;
+            case ECurveInputQuery::IsCoverHitResultValid:
+                return bIsCoverHitResultValid?1.0f:0.0f;
+            case ECurveInputQuery::IsCrouch:
+                return bIsCrouched?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusAnyAttack:
+                return bIsFocusAnyAttacking?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusInMeleeRange:
+                return (DistanceToFocus < MeleeRange)?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusInMeleeRangeFallout:
+                return (DistanceToFocus < MeleeRangeFallout)?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusOutOfMeleeRange:
+                return (DistanceToFocus >= MeleeRange)?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusOutOfMeleeRangeFallout:
+                return (DistanceToFocus >= MeleeRangeFallout)?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusMeleeAttack:
+                return bIsFocusMeleeAttacking?1.0f:0.0f;
+            case ECurveInputQuery::IsFocusRangeAttack:
+                return bIsFocusRangeAttacking?1.0f:0.0f;
+            case ECurveInputQuery::IsInCover:
+                return bIsInCover?1.0f:0.0f;
+            case ECurveInputQuery::IsMeleeEquip:
+                return bMeleeWeaponArmed?1.0f:0.0f;
+            case ECurveInputQuery::HasFocus:
+                return bHasFocus?1.0f:0.0f;
+            case ECurveInputQuery::HasFocusLastSetPoint:
+                return bFocusLastDetectedSet?1.0f:0.0f;
+            case ECurveInputQuery::HasPointOfInterest:
+                return bCurrentPointOfInterestSet?1.0f:0.0f;
+            case ECurveInputQuery::NormalizedDistanceToCover:
+                return DistanceToCover/CoverPointSearchDistance;
+            case ECurveInputQuery::NormalizedDistanceToCurrentPointOfInterest:
+                return DistanceToCurrentPointOfInterest/MaxDistanceToCurrentPointOfInterest;
+            case ECurveInputQuery::NormalizedDistanceToFocus:
+                return DistanceToFocus/ComfortableDistance;
+            case ECurveInputQuery::NormalizedDistanceToFocusLastDetected:
+                return DistanceToFocusLastDetectedPoint/MaxFocusSearchDistance;
+            default:
+                break;
+        }
+        return 0.0f;
+    }
+
+    /*
+    Returns 0.0f if the stat wasn't captured. Searches StatNames, so compiled tables use the stat's index instead.
+    */
+    float GetNormalizedInput(const FName& StatName) const
+    {
+        const int32 StatIndex = StatNames.IndexOfByKey(StatName);
+        return StatValues.IsValidIndex(StatIndex) ? StatValues[StatIndex] : 0.0f;
+    }
+};
+
+
+/*
+Every curve of every task of a manager, flattened into arrays so scoring is a tight loop instead of walking 
+TaskArray -> CurveCollectionArray -> UCurveFloat.
+
+One entry per curve ("consideration"), in task order. Each task owns the range
+TaskFirstConsideration[Task] to TaskFirstConsideration[Task] + TaskConsiderationCount[Task].
+Every per consideration array is padded to a multiple of 4 so Evaluate() can work on 4 at once.
+
+Built by UUtilityAIManagerComponent::CompileConsiderationTable(). Changes to a task's curves at runtime
+need the table to be compiled again.
+*/
+struct FUtilityConsiderationTable
+{
+    /*
+    PER CONSIDERATION
+    */
+
+    TArray<ECurveInputQuery> InputQueries;
+
+    /*
+    Index into StatNames if the input query is STAT_BY_FNAME. Otherwise INDEX_NONE.
+    */
+    TArray<int32> StatIndices;
+
+    /*
+    Where this consideration's samples start in LUTSamples.
+    */
+    TArray<int32> LUTOffsets;
+
+    /*
+    Number of samples - 1, as a float for the clamp.
+    */
+    TArray<float> LUTLastIndices;
+
+    TArray<float> LUTDomainMins;
+
+    TArray<float> LUTInvSampleSpacings;
+
+    /*
+    CurveDampen. 0.0f if there is no CurveFloat, so the output is 0.0f like the unbaked path.
+    */
+    TArray<float> Dampens;
+
+    /*
+    1 if bMultiplyThisCurveOutputToRunningTotal, 0 to add.
+    */
+    TArray<uint8> MultiplyFlags;
+
+    /*
+    1 if every output of this consideration is between 0.0f and 1.0f, so multiplying by it can only shrink the running total.
+    */
+    TArray<uint8> UnitRangeFlags;
+
+    /*
+    Index into the task's CurveCollectionArray. Considerations can be reordered, see GetEvaluationOrderKey().
+    */
+    TArray<int32> SourceCurveIndices;
+
+    /*
+    Considerations whose curve doesn't extrapolate constantly. Outside of its table, these use the real curve.
+    */
+    TArray<int32> ExactOutsideDomain;
+
+    /*
+    Same order as ExactOutsideDomain.
+    */
+    TArray<const UCurveFloat*> ExactCurves;
+
+    /*
+    Every LUT, back to back.
+    */
+    TArray<float> LUTSamples;
+
+    /*
+    PER TASK
+    */
+
+    TArray<int32> TaskFirstConsideration;
+
+    TArray<int32> TaskConsiderationCount;
+
+    /*
+    1 if the task only multiplies unit range considerations, so FoldTaskBounded() can stop as soon as the running total is too low.
+    Tasks that add a curve output always need every consideration.
+    */
+    TArray<uint8> TaskExitEarlyFlags;
+
+    /*
+    Every unique STAT_BY_FNAME used by the tasks.
+    */
+    TArray<FName> StatNames;
+
+    /*
+    SCRATCH, written while scoring. Padded like the per consideration arrays.
+    */
+
+    TArray<float> Inputs;
+
+    TArray<float> Outputs;
+
+    /*
+    The input each consideration had when its task was last scored. Used to tell if the task needs scoring again.
+    */
+    TArray<float> ScoredInputs;
+
+    /*
+    Real considerations, not counting padding.
+    */
+    int32 NumConsiderations = 0;
+
+    void Reset();
+
+    /*
+    Appends a consideration for CurveCollection and returns its index. Uses the collection's baked curve if it is up to date.
+    */
+    int32 AddConsideration(const FUtilityCurveCollection& CurveCollection, int32 SourceCurveIndex);
+
+    /*
+    Smaller goes first. Boolean IsX/HasX queries are cheapest, then distances, then stats.
+    Within each, curves that usually output less go first, since they are the most likely to rule the task out.
+    Only used to order tasks that multiply every curve, since the order doesn't change their result.
+    */
+    static float GetEvaluationOrderKey(const FUtilityCurveCollection& CurveCollection);
+
+    /*
+    Call after the last AddConsideration(). Pads the per consideration arrays and sizes the scratch arrays.
+    */
+    void Finalize();
+
+    /*
+    Inputs[Begin, End) = the normalized input of each consideration, read from Snapshot's QueryValues and StatValues.
+    */
+    void GatherInputs(const FUtilityDecisionSnapshot& Snapshot, int32 Begin, int32 End);
+
+    /*
+    Outputs[Begin, End) = curve output * dampen for each consideration, from Inputs.
+    If bUseSIMD, Begin must be a multiple of 4. The range is rounded up to the padding.
+    */
+    void Evaluate(int32 Begin, int32 End, bool bUseSIMD);
+
+    /*
+    Running total of a task's outputs, multiplied or added in order. Starts at 1.0f
+    */
+    float FoldTask(int32 TaskIndex) const;
+
+    /*
+    Output of a single consideration from its input, without SIMD.
+    */
+    float EvaluateConsideration(int32 Index) const;
+
+    /*
+    Output of consideration Index for Input. Doesn't touch the scratch arrays, so one table can be shared by many threads.
+    */
+    float EvaluateConsiderationAt(int32 Index, const float Input) const;
+
+    /*
+    Evaluates and multiplies the task's considerations one at a time, stopping once the running total is below Bound.
+    Only for tasks with TaskExitEarlyFlags set. Returns false if it stopped early, in which case OutScore is only an upper bound
+    and OutSkipped is increased by the number of considerations that weren't evaluated.
+    */
+    bool FoldTaskBounded(int32 TaskIndex, float Bound, float& OutScore, int32& OutSkipped);
+
+    /*
+    True if any input of the task moved more than Epsilon since MarkTaskScored(). Call after GatherInputs().
+    */
+    bool HasTaskInputChanged(int32 TaskIndex, float Epsilon) const;
+
+    /*
+    Remembers the task's current inputs as the ones it was scored with.
+    */
+    void MarkTaskScored(int32 TaskIndex);
+
+    int32 GetNumPadded() const
+    {
+        return InputQueries.Num();
+    }
+};
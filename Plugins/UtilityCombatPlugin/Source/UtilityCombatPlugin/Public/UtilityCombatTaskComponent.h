@@ -30,6 +30,10 @@ public:
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 
 	/*
 	True if the Task is occuring
@@ -104,7 +108,8 @@ public:
 	
 		
 	/*
-	Stores last value from CalculateTaskScore()
+	Last score of this task. Decisions don't write it. Filled by UUtilityAIManagerComponent::WriteDebugValues(),
+	or after every decision while the manager's bWriteDebugValuesEveryDecision is true.
 	*/
 	UPROPERTY(VisibleAnywhere,BlueprintReadWrite,Transient, Category = Task)
 	float FinalNormalizedUtilityValue = 0.0f;
@@ -136,6 +141,15 @@ public:
 	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = Interruption)
 	int32 InterruptionPriorityNumber = 1;
 
+	/*
+	If true, the manager claims its ClosestCoverHitResult when this task is entered, and releases it when this task exits.
+	Other agents' cover searches skip claimed cover. Off by default, so existing tasks behave as before.
+	To turn it on for the sample's cover task, open Blueprints/ActorComponents/TaskComponents/FindCoverTask_BP in the plugin content,
+	and tick Cover > Claims Cover in its Class Defaults. Do the same for any other task that moves the agent to cover.
+	*/
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = Cover)
+	bool bClaimsCover = false;
+
 
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = Owner)
 	UUtilityAIManagerComponent* CurrentManagerComponent = nullptr;
@@ -144,9 +158,74 @@ public:
 	AAIController* OwnerController = nullptr;
 
 
+	/*
+	Scores the task with the inputs ManagerComponent captured for its current decision.
+	Called outside of a decision, it scores the task with the inputs ManagerComponent has right now.
+	*/
 	UFUNCTION(BlueprintCallable,BlueprintNativeEvent, Category = Basic)
 	float CalculateTaskScore(UUtilityAIManagerComponent* ManagerComponent);
 
+	/*
+	True if a Blueprint subclass overrides CalculateTaskScore(), or if this is a C++ subclass that may override CalculateTaskScore_Implementation().
+	If not, the manager scores this task natively from its FUtilityConsiderationTable, without calling CalculateTaskScore().
+	*/
+	bool IsCalculateTaskScoreOverridden() const;
+
+	/*
+	True unless the closest C++ class of this task is UUtilityCombatTaskComponent or a UUtilityNativeTaskComponent.
+	A C++ override of CalculateTaskScore_Implementation() can't be found like a Blueprint one, so every other C++ subclass is scored through CalculateTaskScore().
+	*/
+	bool IsCalculateTaskScoreOverriddenNatively() const;
+
+	/*
+	True if a Blueprint subclass overrides the BlueprintNativeEvent FunctionName.
+	*/
+	bool IsOverriddenInBlueprint(FName FunctionName) const;
+
+	/*
+	Finds out once which of CalculateTaskScore(), EnterTask() and ExitTask() are overridden. Called by UUtilityAIManagerComponent::Initialize().
+	*/
+	void CacheBlueprintOverrides();
+
+	/*
+	Set by CacheBlueprintOverrides().
+	*/
+	bool bBlueprintOverridesCached = false;
+
+	/*
+	Overridden in Blueprint or C++, see IsCalculateTaskScoreOverridden().
+	*/
+	bool bCalculateTaskScoreOverridden = false;
+
+	bool bCalculateTaskScoreOverriddenInBlueprint = false;
+
+	bool bEnterTaskOverridden = false;
+
+	bool bExitTaskOverridden = false;
+
+	/*
+	EnterTask() for the manager. Calls EnterTask_Implementation() directly, skipping ProcessEvent, unless a Blueprint overrides EnterTask().
+	*/
+	void CallEnterTask();
+
+	/*
+	Same as CallEnterTask(), for ExitTask().
+	*/
+	void CallExitTask();
+
+	/*
+	Same as CallEnterTask(), for CalculateTaskScore().
+	*/
+	float CallCalculateTaskScore(UUtilityAIManagerComponent* ManagerComponent);
+
+	/*
+	Bakes every CurveFloat in CurveCollectionArray into a lookup table. Called in BeginPlay() and when edited.
+	Call again if you change a CurveFloat at runtime.
+	Logs a warning for any curve whose BakedCurveMaxError is above UtilityAI.CurveLUT.WarnError
+	*/
+	UFUNCTION(BlueprintCallable, Category = Curve)
+	void BakeCurves();
+
 	/*
 	Returns true if this task can be interrupted by InterruptingTask
 	Returns false if this task cannot be interrupted by InterruptingTask
@@ -173,6 +252,18 @@ public:
 	UFUNCTION(BlueprintPure, Category = Query)
 	bool IsTaskReady();
 
+	/*
+	Same as IsTaskReady(), but at a given world time instead of now.
+	*/
+	bool IsTaskReadyAt(const double WorldTime) const;
+
+protected:
+
+	/*
+	Multiplies/adds the curves together. Doesn't check if the task is ready.
+	*/
+	float EvaluateCurves(const FUtilityDecisionSnapshot& Snapshot) const;
+
 	
 
 
@@ -0,0 +1,40 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UtilityCombatTaskComponent.h"
+#include "UtilityNativeTaskComponent.generated.h"
+
+/*
+Base for tasks written in C++. Blueprints can't subclass it, so the manager never has to look for Blueprint overrides,
+and every call into it is a plain virtual call instead of going through ProcessEvent.
+
+Override EnterTask_Implementation() and ExitTask_Implementation() for what the task does. Call Super first.
+Override ScoreNativeTask() to change the score the curves gave, and set bOverridesNativeScore in the constructor.
+*/
+UCLASS(Abstract, NotBlueprintable, ClassGroup=(UtilityCombat))
+class UTILITYCOMBATPLUGIN_API UUtilityNativeTaskComponent : public UUtilityCombatTaskComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/*
+	Final score of the task, from CurveScore, the score its CurveCollectionArray gave. Only called if the task is ready.
+	Runs on worker threads with the rest of scoring: only read Snapshot and this task's own members.
+	*/
+	virtual float ScoreNativeTask(const FUtilityDecisionSnapshot& Snapshot, float CurveScore) const { return CurveScore; }
+
+	/*
+	Set in the constructor if ScoreNativeTask() is overridden. 
+	The manager then scores this task every decision, and never exits its scoring early, since it can't know what ScoreNativeTask() reads.
+	*/
+	bool bOverridesNativeScore = false;
+
+	/*
+	The curves, then ScoreNativeTask(). Only called when something calls CalculateTaskScore() itself, the manager scores native tasks without it.
+	Final, so ScoreNativeTask() is the only scoring hook and the manager can't skip an override of this.
+	*/
+	virtual float CalculateTaskScore_Implementation(UUtilityAIManagerComponent* ManagerComponent) override final;
+};
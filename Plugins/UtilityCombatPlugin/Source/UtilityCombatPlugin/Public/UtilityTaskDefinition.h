@@ -0,0 +1,213 @@
+// Copyright Zachary Kolansky, 2020
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "UtilityCombatDataStructures.h"
+#include "UtilityTaskDefinition.generated.h"
+
+class AAIController;
+class APawn;
+
+/*
+One task, shared by every agent whose UUtilityTaskArchetype lists it. Nothing in here changes at runtime,
+so a thousand agents doing the same task cost one of these instead of a thousand task components.
+What an agent needs of its own for the task is a FUtilityTaskRuntimeState in its manager.
+
+Definitions have no EnterTask() or ExitTask() of their own. Bind to the manager's OnAnyTaskEnter and OnAnyTaskExit,
+and call UUtilityAIManagerComponent::FinishTask() when the task is done.
+Tasks that need their own Blueprint logic or state stay UUtilityCombatTaskComponents. A manager can have both.
+*/
+UCLASS(BlueprintType)
+class UTILITYCOMBATPLUGIN_API UUtilityTaskDefinition : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	/*
+	Same as UUtilityCombatTaskComponent::TaskName. Unique among the manager's tasks.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Task)
+	FName TaskName = FName("");
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Task)
+	int32 TaskLayer = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Control)
+	TArray<FUtilityCurveCollection> CurveCollectionArray;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interruption)
+	EUtilityInterruptionType InterruptType = EUtilityInterruptionType::ALWAYS;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interruption)
+	int32 InterruptionPriorityNumber = 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Flow)
+	bool bOnlyDoTaskOnce = false;
+
+	/*
+	If true, every agent picks its own cooldown between MinCooldown and MaxCooldown each time it enters the task.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cooldown)
+	bool bSetCurrentCooldownBetweenMinMax = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cooldown)
+	float Cooldown = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cooldown)
+	float MinCooldown = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cooldown)
+	float MaxCooldown = 0.0f;
+
+	/*
+	Same as UUtilityCombatTaskComponent::bClaimsCover.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cover)
+	bool bClaimsCover = false;
+
+	/*
+	Same rules as UUtilityCombatTaskComponent::CanTaskBeInterrupted()
+	*/
+	bool CanBeInterruptedBy(const UUtilityTaskDefinition* InterruptingTask) const;
+
+	/*
+	Bakes every CurveFloat once, for every agent. Called on load and when edited.
+	*/
+	void BakeCurves();
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+};
+
+/*
+How agents of a UUtilityTaskArchetype behave in UUtilityAICrowdSubsystem, where they have no manager to hold these.
+The distances are the same as the UUtilityAIManagerComponent properties of the same name.
+*/
+USTRUCT(BlueprintType)
+struct UTILITYCOMBATPLUGIN_API FUtilityCrowdSettings
+{
+	GENERATED_BODY()
+
+	/*
+	Spawned for the agent when it is promoted. AAIController if none.
+	Give it a UUtilityAIManagerComponent if it needs other settings than the defaults, otherwise one is added.
+	An added manager uses the decision scheduler. A manager of ControllerClass is left as it is, so it has to make its own decisions
+	(bUseDecisionScheduler, or a timer calling DetermineBestTask()).
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	TSubclassOf<AAIController> ControllerClass = nullptr;
+
+	/*
+	Spawned for the agent when it is promoted, if it has no pawn of its own.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	TSubclassOf<APawn> PawnClass = nullptr;
+
+	/*
+	Agents closer than this to a player pawn are promoted to a full AI controller. 0 = only when PromoteAgent() is called.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd, meta = (ClampMin = 0.0))
+	float PromotionDistance = 3000.0f;
+
+	/*
+	Seconds between an agent's decisions.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd, meta = (ClampMin = 0.0))
+	float DecisionInterval = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	float TaskThreshold = 0.1f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	float ComfortableDistance = 1000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	float MaxDistanceToCurrentPointOfInterest = 1000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	float MeleeRange = 400.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	float MeleeRangeFallout = 600.0f;
+};
+
+/*
+The task definitions of one kind of agent. Give it to UUtilityAIManagerComponent::TaskArchetype, 
+or add agents of it to UUtilityAICrowdSubsystem.
+*/
+UCLASS(BlueprintType)
+class UTILITYCOMBATPLUGIN_API UUtilityTaskArchetype : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Tasks)
+	TArray<UUtilityTaskDefinition*> Tasks = {};
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Crowd)
+	FUtilityCrowdSettings Crowd;
+};
+
+/*
+One agent's state for one UUtilityTaskDefinition. Everything else about the task is shared.
+Its last score is in the manager's TaskScores.
+*/
+USTRUCT(BlueprintType)
+struct UTILITYCOMBATPLUGIN_API FUtilityTaskRuntimeState
+{
+	GENERATED_BODY()
+
+	/*
+	World time the task was last entered, -1 if never.
+	*/
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Task)
+	float WorldTimeBegun = -1.0f;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Task)
+	float CurrentCooldown = 0.0f;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Task)
+	bool bIsTaskActive = false;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Task)
+	bool bPerformedTask = false;
+
+	/*
+	Same rules as UUtilityCombatTaskComponent::IsTaskReadyAt()
+	*/
+	bool IsReadyAt(const UUtilityTaskDefinition& Definition, const double WorldTime) const
+	{
+		if(bPerformedTask && Definition.bOnlyDoTaskOnce)
+		{
+			return false;
+		}
+
+		return CurrentCooldown <= 0.0f || WorldTimeBegun <= 0.0f || WorldTime - WorldTimeBegun >= CurrentCooldown;
+	}
+
+	/*
+	Same as UUtilityCombatTaskComponent::EnterTask_Implementation()
+	*/
+	void Enter(const UUtilityTaskDefinition& Definition, const double WorldTime)
+	{
+		if(Definition.bSetCurrentCooldownBetweenMinMax)
+		{
+			CurrentCooldown = FMath::FRandRange(Definition.MinCooldown,Definition.MaxCooldown);
+		}
+		WorldTimeBegun = WorldTime;
+		bIsTaskActive = true;
+	}
+
+	void Exit()
+	{
+		bPerformedTask = true;
+		bIsTaskActive = false;
+	}
+};